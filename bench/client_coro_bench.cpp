@@ -0,0 +1,286 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+// C++ client benchmark: blocking clients (one thread and one job in flight for each
+// connection) vs. coroutines multiplexing all the connections on one thread. The server
+// is emulated in process: a fixed number of slots, each job runs for a fixed time (given
+// in us as argument, 0 measures the protocol alone). The client CPU time is reported too.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <time.h>
+
+#include "../client/fred_client.hpp"
+
+//---------------------------------------------------------------------------------------------
+
+#define BENCH_SOCK_PATH     "/tmp/fred_bench_sock"
+#define BENCH_SLOTS         4
+#define BENCH_DEF_EXEC_US   100
+#define BENCH_CONNS         8
+#define BENCH_JOBS          4000        // For each connection
+#define BENCH_DEPTH         4           // Coroutines for each connection
+
+//---------------------------------------------------------------------------------------------
+
+static int exec_us = BENCH_DEF_EXEC_US;
+
+static
+uint64_t clock_ns_(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline
+uint64_t now_ns_(void)
+{
+    return clock_ns_(CLOCK_MONOTONIC);
+}
+
+// Emulated server: jobs are served in arrival order by the first free slot
+struct fake_job {
+    int sock;
+    uint32_t req_id;
+    uint64_t done_ns;
+};
+
+static
+void fake_server_(int list_sock, int *stop_fd)
+{
+    int epfd;
+    int count;
+    int timeout_ms;
+    uint64_t now;
+    uint64_t slots_free_ns[BENCH_SLOTS] = {};
+    std::vector<fake_job> jobs;
+    epoll_event ev;
+    epoll_event events[64];
+    fred_msg msg;
+
+    epfd = epoll_create1(0);
+    ev.events = EPOLLIN;
+    ev.data.fd = list_sock;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, list_sock, &ev);
+    ev.data.fd = stop_fd[0];
+    epoll_ctl(epfd, EPOLL_CTL_ADD, stop_fd[0], &ev);
+
+    for (;;) {
+        timeout_ms = -1;
+        if (!jobs.empty()) {
+            now = now_ns_();
+            timeout_ms = jobs.front().done_ns > now ?
+                            (int)((jobs.front().done_ns - now) / 1000000) : 0;
+        }
+
+        count = epoll_wait(epfd, events, 64, timeout_ms);
+
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+
+            if (fd == stop_fd[0]) {
+                close(epfd);
+                return;
+
+            } else if (fd == list_sock) {
+                ev.data.fd = accept(list_sock, nullptr, nullptr);
+                epoll_ctl(epfd, EPOLL_CTL_ADD, ev.data.fd, &ev);
+
+            } else if (read(fd, &msg, sizeof(msg)) != sizeof(msg)) {
+                epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+                close(fd);
+
+            } else if (fred_msg_get_head(&msg) == FRED_MSG_RUN) {
+                int slot = 0;
+
+                for (int s = 1; s < BENCH_SLOTS; ++s) {
+                    if (slots_free_ns[s] < slots_free_ns[slot])
+                        slot = s;
+                }
+
+                now = now_ns_();
+                slots_free_ns[slot] = std::max(now, slots_free_ns[slot]) + exec_us * 1000;
+                jobs.push_back({ fd, fred_msg_get_req_id(&msg), slots_free_ns[slot] });
+                std::push_heap(jobs.begin(), jobs.end(), [](auto &a, auto &b) {
+                                    return a.done_ns > b.done_ns; });
+
+            } else {
+                // Init is acknowledged, bind gets no buffers
+                fred_msg_set_head(&msg, fred_msg_get_head(&msg) == FRED_MSG_INIT ?
+                                        FRED_MSG_ACK : FRED_MSG_BUFFS);
+                fred_msg_set_arg(&msg, 0);
+                write(fd, &msg, sizeof(msg));
+            }
+        }
+
+        // Busy wait the last sub-millisecond
+        now = now_ns_();
+        while (!jobs.empty() && jobs.front().done_ns <= now + 1000000) {
+            while (now_ns_() < jobs.front().done_ns)
+                ;
+
+            std::pop_heap(jobs.begin(), jobs.end(), [](auto &a, auto &b) {
+                                return a.done_ns > b.done_ns; });
+            fred_msg_set_head(&msg, FRED_MSG_DONE);
+            fred_msg_set_arg(&msg, 0);
+            fred_msg_set_req_id(&msg, jobs.back().req_id);
+            fred_msg_set_deadline_us(&msg, 0);
+            write(jobs.back().sock, &msg, sizeof(msg));
+            jobs.pop_back();
+            now = now_ns_();
+        }
+    }
+}
+
+//---------------------------------------------------------------------------------------------
+
+static
+void report_(const char *name, uint64_t elapsed_ns, uint64_t lat_sum_ns, uint64_t cpu_ns)
+{
+    const double jobs = (double)BENCH_CONNS * BENCH_JOBS;
+
+    printf("%-32s %8.0f jobs/s %8.1f us latency %6.2f us client cpu/job\n", name,
+            jobs * 1e9 / elapsed_ns, lat_sum_ns / jobs / 1000.0, cpu_ns / jobs / 1000.0);
+}
+
+static
+void bench_blocking_(void)
+{
+    std::vector<std::thread> threads;
+    std::vector<uint64_t> lat_sums(BENCH_CONNS);
+    std::vector<uint64_t> cpu_sums(BENCH_CONNS);
+    uint64_t start;
+
+    start = now_ns_();
+
+    for (int c = 0; c < BENCH_CONNS; ++c) {
+        threads.emplace_back([c, &lat_sums, &cpu_sums]() {
+            fred::connection conn(BENCH_SOCK_PATH);
+            fred::hw_task hw = conn.bind(1);
+            uint64_t cpu = clock_ns_(CLOCK_THREAD_CPUTIME_ID);
+            uint64_t t;
+
+            for (int j = 0; j < BENCH_JOBS; ++j) {
+                t = now_ns_();
+                conn.run_sync(hw);
+                lat_sums[c] += now_ns_() - t;
+            }
+
+            cpu_sums[c] = clock_ns_(CLOCK_THREAD_CPUTIME_ID) - cpu;
+        });
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+
+    uint64_t lat_sum = 0;
+    uint64_t cpu_sum = 0;
+    for (int c = 0; c < BENCH_CONNS; ++c) {
+        lat_sum += lat_sums[c];
+        cpu_sum += cpu_sums[c];
+    }
+
+    report_("blocking (thread per conn)", now_ns_() - start, lat_sum, cpu_sum);
+}
+
+static
+fred::task<> worker_(fred::connection &conn, const fred::hw_task &hw, int jobs,
+                        uint64_t &lat_sum)
+{
+    uint64_t t;
+
+    for (int j = 0; j < jobs; ++j) {
+        t = now_ns_();
+        co_await conn.run(hw);
+        lat_sum += now_ns_() - t;
+    }
+}
+
+static
+void bench_coroutines_(int depth)
+{
+    fred::executor ex;
+    std::vector<std::unique_ptr<fred::connection>> conns;
+    std::vector<fred::hw_task> hws;
+    uint64_t lat_sum = 0;
+    uint64_t start;
+    uint64_t cpu;
+    char name[64];
+
+    for (int c = 0; c < BENCH_CONNS; ++c) {
+        conns.push_back(std::make_unique<fred::connection>(BENCH_SOCK_PATH));
+        hws.push_back(conns.back()->bind(1));
+        ex.add(*conns.back());
+    }
+
+    start = now_ns_();
+    cpu = clock_ns_(CLOCK_THREAD_CPUTIME_ID);
+
+    for (int c = 0; c < BENCH_CONNS; ++c) {
+        for (int d = 0; d < depth; ++d)
+            ex.spawn(worker_(*conns[c], hws[c], BENCH_JOBS / depth, lat_sum));
+    }
+
+    ex.run();
+
+    snprintf(name, sizeof(name), "coroutines (1 thread, depth %d)", depth);
+    report_(name, now_ns_() - start, lat_sum, clock_ns_(CLOCK_THREAD_CPUTIME_ID) - cpu);
+}
+
+int main(int argc, char **argv)
+{
+    int list_sock;
+    int stop_fd[2];
+    sockaddr_un addr = {};
+
+    if (argc > 1)
+        exec_us = atoi(argv[1]);
+
+    unlink(BENCH_SOCK_PATH);
+    list_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, BENCH_SOCK_PATH, sizeof(addr.sun_path) - 1);
+
+    if (bind(list_sock, (sockaddr *)&addr, sizeof(addr)) || listen(list_sock, BENCH_CONNS)) {
+        perror("bench: listen");
+        return 1;
+    }
+
+    if (pipe(stop_fd)) {
+        perror("bench: pipe");
+        return 1;
+    }
+
+    std::thread server(fake_server_, list_sock, stop_fd);
+
+    printf("%d connections, %d jobs each, %d slots, %d us per job\n",
+            BENCH_CONNS, BENCH_JOBS, BENCH_SLOTS, exec_us);
+
+    bench_blocking_();
+    bench_coroutines_(1);
+    bench_coroutines_(BENCH_DEPTH);
+
+    write(stop_fd[1], "", 1);
+    server.join();
+    close(list_sock);
+    unlink(BENCH_SOCK_PATH);
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+// FRI queue microbenchmark: steady state pop + push at a fixed queue depth,
+// sorted list insertion (original FRED) vs. binary heap.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/queue.h>
+
+#include "../parameters.h"
+#include "../srv_core/accel_req.h"
+#include "../srv_core/req_heap.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define BENCH_OPS       200000
+
+//---------------------------------------------------------------------------------------------
+
+static
+uint64_t now_ns_(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint32_t jitter[BENCH_OPS + MAX_SW_TASKS];
+
+// Arrival order with some reordering, as seen by the arbiter in sharded mode.
+// With a spread key the new request lands anywhere in the queue, emulating the
+// shortest bitstream and least laxity orderings.
+static inline
+void stamp_(struct accel_req *request, uint64_t seq, int depth, int spread)
+{
+    uint64_t ns;
+
+    ns = seq * 1000 + jitter[seq] % 4000;
+
+    request->tstamp.tv_sec = ns / 1000000000;
+    request->tstamp.tv_nsec = ns % 1000000000;
+
+    request->heap_key = spread ? seq * 1000 + jitter[seq] % (depth * 2000) : ns;
+}
+
+//---------------------------------------------------------------------------------------------
+
+// Original FRED insertion
+static
+void list_ins_ordered_(struct accel_req_queue *queue_head, struct accel_req *new_request)
+{
+    struct accel_req *req = NULL;
+
+    TAILQ_FOREACH(req, queue_head, queue_elem) {
+        if (req->heap_key > new_request->heap_key ||
+            (req->heap_key == new_request->heap_key &&
+            accel_req_compare_timestamps(req, new_request) == 1))
+            break;
+    }
+
+    if (req == NULL)
+        TAILQ_INSERT_TAIL(queue_head, new_request, queue_elem);
+    else
+        TAILQ_INSERT_BEFORE(req, new_request, queue_elem);
+}
+
+static
+double bench_list_(struct accel_req *reqs, int depth, int spread)
+{
+    struct accel_req_queue queue_head;
+    struct accel_req *request;
+    uint64_t seq = 0;
+    uint64_t start_ns;
+
+    TAILQ_INIT(&queue_head);
+
+    for (int i = 0; i < depth; ++i) {
+        stamp_(&reqs[i], seq++, depth, spread);
+        list_ins_ordered_(&queue_head, &reqs[i]);
+    }
+
+    start_ns = now_ns_();
+
+    for (int i = 0; i < BENCH_OPS; ++i) {
+        request = TAILQ_FIRST(&queue_head);
+        TAILQ_REMOVE(&queue_head, request, queue_elem);
+
+        stamp_(request, seq++, depth, spread);
+        list_ins_ordered_(&queue_head, request);
+    }
+
+    return (double)(now_ns_() - start_ns) / BENCH_OPS;
+}
+
+static
+double bench_heap_(struct accel_req *reqs, int depth, int spread)
+{
+    struct req_heap heap;
+    struct accel_req *request;
+    uint64_t seq = 0;
+    uint64_t start_ns;
+
+    if (req_heap_init(&heap, depth))
+        return -1;
+
+    for (int i = 0; i < depth; ++i) {
+        stamp_(&reqs[i], seq++, depth, spread);
+        req_heap_push(&heap, &reqs[i]);
+    }
+
+    start_ns = now_ns_();
+
+    for (int i = 0; i < BENCH_OPS; ++i) {
+        request = req_heap_pop(&heap);
+
+        stamp_(request, seq++, depth, spread);
+        req_heap_push(&heap, request);
+    }
+
+    start_ns = now_ns_() - start_ns;
+
+    req_heap_free(&heap);
+
+    return (double)start_ns / BENCH_OPS;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    struct accel_req *reqs;
+    double list_ns, heap_ns;
+
+    reqs = calloc(MAX_SW_TASKS, sizeof(*reqs));
+    if (!reqs)
+        return -1;
+
+    srand(1);
+    for (int i = 0; i < BENCH_OPS + MAX_SW_TASKS; ++i)
+        jitter[i] = rand();
+
+    printf("FRI queue pop + push, %d ops per point (ns/op)\n\n", BENCH_OPS);
+    printf("%-8s %-6s %12s %12s %9s\n", "depth", "key", "sorted list", "heap", "speedup");
+
+    for (int spread = 0; spread < 2; ++spread) {
+        for (int depth = 1; depth <= MAX_SW_TASKS; depth *= 2) {
+            list_ns = bench_list_(reqs, depth, spread);
+            heap_ns = bench_heap_(reqs, depth, spread);
+
+            printf("%-8d %-6s %12.1f %12.1f %8.1fx\n", depth, spread ? "spread" : "fifo",
+                    list_ns, heap_ns, list_ns / heap_ns);
+        }
+    }
+
+    free(reqs);
+
+    return 0;
+}
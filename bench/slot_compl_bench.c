@@ -0,0 +1,234 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+// Slot completion latency microbenchmark on the null slot driver: interrupt mode
+// (the completion wakes up the epoll reactor) vs. polled mode (busy waited after the
+// start and posted to the reactor), as done by slot_start_compute(). The latency is
+// measured from the start of the computation to the completion handler, the null
+// hw-task completes at once. The spin budget is given in us as argument.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "../parameters.h"
+#include "../srv_core/reactor.h"
+#include "../hw_support/slot_drv_null.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define BENCH_RUNS          100000
+#define BENCH_DEF_SPIN_US   20
+
+// Power of two buckets (ns)
+#define BENCH_HIST_MIN_LOG  7
+#define BENCH_HIST_BUCKETS  12
+
+//---------------------------------------------------------------------------------------------
+
+struct bench_slot {
+    // ------------------------//
+    struct event_handler handler;
+    // ------------------------//
+
+    struct slot_drv *slot_dev;
+    struct reactor *reactor;
+    uint64_t spin_us;
+
+    uint64_t start_ns;
+    uint64_t *lat_ns;
+    int runs;
+    int fallbacks;
+};
+
+static
+uint64_t now_ns_(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static
+int start_(struct bench_slot *slot)
+{
+    uintptr_t args[1] = { 0 };
+    int polled;
+    int retval;
+
+    polled = slot->spin_us != 0;
+    slot_drv_set_polled(slot->slot_dev, polled);
+
+    slot->start_ns = now_ns_();
+
+    retval = slot_drv_start_compute(slot->slot_dev, args, 1);
+    if (retval || !polled)
+        return retval;
+
+    if (slot_drv_wait_for_compl(slot->slot_dev, slot->spin_us))
+        return reactor_post_event(slot->reactor, &slot->handler);
+
+    slot->fallbacks++;
+
+    return 0;
+}
+
+static
+int get_fd_handle_(const struct event_handler *self)
+{
+    return slot_drv_get_fd(((const struct bench_slot *)self)->slot_dev);
+}
+
+// Completion, start the next run
+static
+int handle_event_(struct event_handler *self)
+{
+    struct bench_slot *slot;
+
+    slot = (struct bench_slot *)self;
+
+    slot->lat_ns[slot->runs++] = now_ns_() - slot->start_ns;
+    slot_drv_after_compute(slot->slot_dev);
+
+    if (slot->runs == BENCH_RUNS)
+        return -1;
+
+    return start_(slot) ? -1 : 0;
+}
+
+static
+void get_name_(const struct event_handler *self, char *msg, int msg_size)
+{
+    snprintf(msg, msg_size, "bench slot");
+}
+
+static
+void free_(struct event_handler *self)
+{
+}
+
+//---------------------------------------------------------------------------------------------
+
+static
+int cmp_u64_(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static
+void report_(const char *name, uint64_t *lat_ns, int fallbacks)
+{
+    int hist[BENCH_HIST_BUCKETS] = { 0 };
+    int bucket;
+    uint64_t bound;
+
+    qsort(lat_ns, BENCH_RUNS, sizeof(*lat_ns), cmp_u64_);
+
+    for (int i = 0; i < BENCH_RUNS; ++i) {
+        bucket = 0;
+        while (bucket < BENCH_HIST_BUCKETS - 1 &&
+                lat_ns[i] >= UINT64_C(1) << (BENCH_HIST_MIN_LOG + bucket + 1))
+            bucket++;
+        hist[bucket]++;
+    }
+
+    printf("%s: p50 %"PRIu64" ns, p99 %"PRIu64" ns, p99.9 %"PRIu64" ns, max %"PRIu64" ns"
+            " (%d interrupt fallbacks)\n", name, lat_ns[BENCH_RUNS / 2],
+            lat_ns[BENCH_RUNS / 100 * 99], lat_ns[BENCH_RUNS / 1000 * 999],
+            lat_ns[BENCH_RUNS - 1], fallbacks);
+
+    for (int b = 0; b < BENCH_HIST_BUCKETS; ++b) {
+        bound = UINT64_C(1) << (BENCH_HIST_MIN_LOG + b + 1);
+        printf("  %s %8"PRIu64" ns %8d  ", b < BENCH_HIST_BUCKETS - 1 ? "<" : ">",
+                b < BENCH_HIST_BUCKETS - 1 ? bound : bound / 2, hist[b]);
+
+        for (int i = 0; i < hist[b] * 60 / BENCH_RUNS; ++i)
+            putchar('#');
+        putchar('\n');
+    }
+    putchar('\n');
+}
+
+static
+int bench_mode_(const char *name, uint64_t spin_us)
+{
+    struct bench_slot slot = { 0 };
+    int retval;
+
+    slot.handler.get_fd_handle = get_fd_handle_;
+    slot.handler.handle_event = handle_event_;
+    slot.handler.get_name = get_name_;
+    slot.handler.free = free_;
+    slot.spin_us = spin_us;
+
+    slot.lat_ns = calloc(BENCH_RUNS, sizeof(*slot.lat_ns));
+    if (!slot.lat_ns)
+        return -1;
+
+    retval = slot_drv_null_init(&slot.slot_dev, "bench");
+    if (retval)
+        goto error_free;
+
+    retval = reactor_init(&slot.reactor, REACTOR_EPOLL);
+    if (retval)
+        goto error_drv;
+
+    retval = reactor_add_event_handler(slot.reactor, &slot.handler, REACT_HW_HANDLER,
+                                        REACT_NOT_OWNED);
+    if (retval)
+        goto error_reactor;
+
+    // Runs until the last completion
+    retval = start_(&slot);
+    if (retval)
+        goto error_reactor;
+
+    reactor_event_loop(slot.reactor);
+
+    report_(name, slot.lat_ns, slot.fallbacks);
+
+error_reactor:
+    reactor_free(slot.reactor);
+error_drv:
+    slot_drv_free(slot.slot_dev);
+error_free:
+    free(slot.lat_ns);
+
+    return retval;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t spin_us = BENCH_DEF_SPIN_US;
+    char name[64];
+
+    if (argc > 1)
+        spin_us = strtoul(argv[1], NULL, 10);
+
+    printf("Null slot completion latency, %d runs for each mode\n\n", BENCH_RUNS);
+
+    if (bench_mode_("interrupt", 0))
+        return -1;
+
+    snprintf(name, sizeof(name), "polled (spin %"PRIu64" us)", spin_us);
+    if (bench_mode_(name, spin_us))
+        return -1;
+
+    return 0;
+}
@@ -0,0 +1,812 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef FRED_CLIENT_HPP_
+#define FRED_CLIENT_HPP_
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <coroutine>
+#include <cstring>
+#include <exception>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../parameters.h"
+#include "../shared_user/fred_msg.h"
+#include "../shared_user/user_buff.h"
+
+//---------------------------------------------------------------------------------------------
+//
+// Header-only C++20 client for the fred server (same protocol as libfred-client).
+//
+//  fred::executor ex;
+//  fred::connection conn;                      // Connect, blocking
+//  fred::hw_task hw = conn.bind(id);           // Bind, blocking
+//  fred::buffer in = hw.map(0);                // Map a data buffer (RAII)
+//  ex.add(conn);
+//  ex.spawn([&]() -> fred::task<> {
+//      fred::result r = co_await conn.run(hw); // Suspends until the reply
+//  }());
+//  ex.run();                                   // Until all spawned tasks are finished
+//
+// An executor multiplexes any number of connections over one epoll instance, on the
+// calling thread. Each connection keeps up to MAX_CLIENT_REQS jobs in flight, further
+// runs are submitted as jobs complete. conn.run_sync() is the blocking equivalent.
+// Errors on connect, bind and map throw std::system_error. When a connection is lost
+// all its jobs complete with result::error. Nothing is thread safe.
+//
+//---------------------------------------------------------------------------------------------
+
+namespace fred {
+
+enum class result : int {
+    done        = FRED_MSG_DONE,
+    overrun     = FRED_MSG_OVERRUN,
+    expired     = FRED_MSG_EXPIRED,
+    cancelled   = FRED_MSG_CANCELLED,
+    error       = FRED_MSG_ERROR
+};
+
+class connection;
+class executor;
+
+template <typename T = void>
+class task;
+
+//---------------------------------------------------------------------------------------------
+
+// Data buffer mapped into the process, unmapped on destruction
+class buffer {
+public:
+    explicit buffer(const user_buff &buff)
+        : length_(buff.length)
+    {
+        int fd = buff.file_d;
+
+        // Buffers passed by the server are already open
+        if (buff.dev_name[0]) {
+            fd = fd_ = ::open(buff.dev_name, O_RDWR | O_CLOEXEC);
+            if (fd_ < 0)
+                throw std::system_error(errno, std::generic_category(), buff.dev_name);
+        }
+
+        addr_ = ::mmap(nullptr, length_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr_ == MAP_FAILED) {
+            int err = errno;
+            if (fd_ >= 0)
+                ::close(fd_);
+            throw std::system_error(err, std::generic_category(), "fred: mmap");
+        }
+    }
+
+    buffer(buffer &&other) noexcept
+        : addr_(std::exchange(other.addr_, nullptr)), length_(other.length_),
+          fd_(std::exchange(other.fd_, -1)) {}
+
+    buffer &operator=(buffer &&other) noexcept
+    {
+        std::swap(addr_, other.addr_);
+        std::swap(length_, other.length_);
+        std::swap(fd_, other.fd_);
+        return *this;
+    }
+
+    buffer(const buffer &) = delete;
+    buffer &operator=(const buffer &) = delete;
+
+    ~buffer()
+    {
+        if (addr_)
+            ::munmap(addr_, length_);
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    void *data() const noexcept { return addr_; }
+    size_t size() const noexcept { return length_; }
+
+private:
+    void *addr_ = nullptr;
+    size_t length_ = 0;
+    int fd_ = -1;                   // Only if opened by path
+};
+
+// Hw-task bound to a connection. The binding lasts as the connection, the data
+// buffers are mapped on request. Buffers passed as fds are closed on destruction
+class hw_task {
+public:
+    hw_task(uint32_t id, std::vector<user_buff> buffs)
+        : id_(id), buffs_(std::move(buffs)) {}
+
+    hw_task(hw_task &&other) noexcept
+        : id_(other.id_), buffs_(std::exchange(other.buffs_, {})) {}
+
+    hw_task &operator=(hw_task &&other) noexcept
+    {
+        std::swap(id_, other.id_);
+        std::swap(buffs_, other.buffs_);
+        return *this;
+    }
+
+    hw_task(const hw_task &) = delete;
+    hw_task &operator=(const hw_task &) = delete;
+
+    ~hw_task()
+    {
+        for (auto &buff : buffs_) {
+            if (!buff.dev_name[0] && buff.file_d >= 0)
+                ::close(buff.file_d);
+        }
+    }
+
+    uint32_t id() const noexcept { return id_; }
+    int buffs_count() const noexcept { return static_cast<int>(buffs_.size()); }
+    size_t buff_size(int idx) const { return buffs_.at(idx).length; }
+
+    buffer map(int idx) const { return buffer(buffs_.at(idx)); }
+
+private:
+    uint32_t id_;
+    std::vector<user_buff> buffs_;
+};
+
+//---------------------------------------------------------------------------------------------
+
+namespace detail {
+
+struct promise_base {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    struct final_awaiter {
+        bool await_ready() const noexcept { return false; }
+
+        // Resume the awaiting coroutine, if any
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) const noexcept
+        {
+            auto cont = h.promise().continuation;
+            return cont ? cont : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    final_awaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+template <typename T>
+struct promise : promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+
+    template <typename U>
+    void return_value(U &&v) { value.emplace(std::forward<U>(v)); }
+
+    T result()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+        return std::move(*value);
+    }
+};
+
+template <>
+struct promise<void> : promise_base {
+    task<void> get_return_object() noexcept;
+
+    void return_void() const noexcept {}
+
+    void result()
+    {
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+};
+
+} // namespace detail
+
+// Lazily started coroutine, awaitable or passed to executor::spawn()
+template <typename T>
+class [[nodiscard]] task {
+public:
+    using promise_type = detail::promise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    explicit task(handle_type h) noexcept : handle_(h) {}
+    task(task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+
+    ~task()
+    {
+        if (handle_)
+            handle_.destroy();
+    }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> cont) noexcept
+    {
+        handle_.promise().continuation = cont;
+        return handle_;
+    }
+
+    T await_resume() { return handle_.promise().result(); }
+
+private:
+    friend class executor;
+
+    handle_type handle_;
+};
+
+template <typename T>
+inline task<T> detail::promise<T>::get_return_object() noexcept
+{
+    return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> detail::promise<void>::get_return_object() noexcept
+{
+    return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+//---------------------------------------------------------------------------------------------
+
+// A job: awaiting it submits the job and suspends until its reply
+class run_op {
+public:
+    run_op(const run_op &) = delete;
+    run_op &operator=(const run_op &) = delete;
+
+    inline bool await_ready();
+    inline void await_suspend(std::coroutine_handle<> handle);
+    result await_resume() const noexcept { return res_; }
+
+private:
+    friend class connection;
+
+    run_op(connection *conn, const hw_task &hw, std::span<const fred_arg> args,
+            uint32_t deadline_us)
+        : conn_(conn), hw_task_id_(hw.id()), deadline_us_(deadline_us),
+          args_count_(static_cast<uint32_t>(args.size()))
+    {
+        if (args.size() > args_.size())
+            throw std::invalid_argument("fred: too many arguments");
+        std::copy(args.begin(), args.end(), args_.begin());
+    }
+
+    connection *conn_;
+    uint32_t hw_task_id_;
+    uint32_t deadline_us_;
+    uint32_t args_count_;
+    std::array<fred_arg, FRED_RUN_MAX_ARGS> args_;
+
+    std::coroutine_handle<> handle_;
+    result res_ = result::error;
+    bool done_ = false;
+    run_op *next_ = nullptr;        // Waiting for a free job
+};
+
+class connection {
+public:
+    explicit connection(const char *path = LIST_SOCK_PATH)
+    {
+        sockaddr_un addr = {};
+
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+        // The server listens either on a stream or on a sequenced packets socket
+        for (int type : { SOCK_STREAM, SOCK_SEQPACKET }) {
+            sock_ = ::socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+            if (sock_ < 0)
+                throw std::system_error(errno, std::generic_category(), "fred: socket");
+
+            if (!::connect(sock_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)))
+                break;
+
+            int err = errno;
+            ::close(sock_);
+            sock_ = -1;
+            if (err != EPROTOTYPE || type == SOCK_SEQPACKET)
+                throw std::system_error(err, std::generic_category(), "fred: connect");
+        }
+
+        // Prefer the data buffers already open
+        if (ctrl_request_(FRED_MSG_INIT, FRED_INIT_BUFF_FDS) != FRED_MSG_ACK) {
+            ::close(sock_);
+            throw std::system_error(ECONNREFUSED, std::generic_category(), "fred: init");
+        }
+
+        buff_fds_ = fred_msg_get_arg(&ctrl_msg_) & FRED_INIT_BUFF_FDS;
+    }
+
+    // Jobs in flight point to the connection
+    connection(const connection &) = delete;
+    connection &operator=(const connection &) = delete;
+
+    ~connection()
+    {
+        for (int i = 0; i < rx_fds_count_; ++i)
+            ::close(rx_fds_[i]);
+        ::close(sock_);
+    }
+
+    int fd() const noexcept { return sock_; }
+    bool broken() const noexcept { return broken_; }
+
+    hw_task bind(uint32_t hw_task_id)
+    {
+        if (ctrl_request_(FRED_MSG_BIND, hw_task_id) != FRED_MSG_BUFFS)
+            throw std::system_error(EINVAL, std::generic_category(), "fred: bind");
+
+        std::vector<user_buff> buffs(ctrl_buffs_, ctrl_buffs_ + fred_msg_get_arg(&ctrl_msg_));
+        for (auto &buff : buffs) {
+            buff.map_addr = nullptr;
+            if (!buff_fds_)
+                buff.file_d = -1;
+            buff.dev_name[sizeof(buff.dev_name) - 1] = '\0';
+        }
+
+        return hw_task(hw_task_id, std::move(buffs));
+    }
+
+    // With no arguments the hw-task gets its data buffers (as FRED_MSG_RUN)
+    run_op run(const hw_task &hw, std::span<const fred_arg> args = {},
+                uint32_t deadline_us = 0)
+    {
+        return run_op(this, hw, args, deadline_us);
+    }
+
+    // Blocking equivalent of co_await run()
+    result run_sync(const hw_task &hw, std::span<const fred_arg> args = {},
+                    uint32_t deadline_us = 0)
+    {
+        run_op op(this, hw, args, deadline_us);
+
+        submit_(&op);
+        while (!op.done_)
+            wait_();
+
+        return op.res_;
+    }
+
+    // Read the available replies and resume the completed jobs
+    void process()
+    {
+        ssize_t nread;
+
+        while (!broken_) {
+            nread = recv_fds_();
+            if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return;
+            if (nread < 0 && errno == EINTR)
+                continue;
+            if (nread <= 0) {
+                fail_();
+                return;
+            }
+
+            rx_len_ += nread;
+            parse_();
+        }
+    }
+
+private:
+    friend class run_op;
+
+    static constexpr uint32_t idx_bits = 8;
+    static constexpr uint32_t idx_mask = (1U << idx_bits) - 1;
+
+    void submit_(run_op *op)
+    {
+        int idx = -1;
+        fred_msg msg;
+        uint32_t count = op->args_count_;
+        char buff[sizeof(msg) + sizeof(count) + sizeof(fred_arg) * FRED_RUN_MAX_ARGS];
+        size_t len = sizeof(msg);
+
+        if (broken_) {
+            complete_(op, result::error);
+            return;
+        }
+
+        for (int i = 0; i < MAX_CLIENT_REQS; ++i) {
+            if (!jobs_[i]) {
+                idx = i;
+                break;
+            }
+        }
+
+        // Submitted when a job completes
+        if (idx < 0) {
+            op->next_ = nullptr;
+            if (waiters_tail_)
+                waiters_tail_->next_ = op;
+            else
+                waiters_head_ = op;
+            waiters_tail_ = op;
+            return;
+        }
+
+        // Ids carry a generation, id 0 is used by bind and init replies
+        if (!(++gen_ << idx_bits))
+            gen_ = 1;
+
+        jobs_[idx] = op;
+        ids_[idx] = (gen_ << idx_bits) | idx;
+
+        fred_msg_set_head(&msg, count ? FRED_MSG_RUN_ARGS : FRED_MSG_RUN);
+        fred_msg_set_arg(&msg, op->hw_task_id_);
+        fred_msg_set_req_id(&msg, ids_[idx]);
+        fred_msg_set_deadline_us(&msg, op->deadline_us_);
+
+        // The arguments must be sent in the same write
+        std::memcpy(buff, &msg, sizeof(msg));
+        if (count) {
+            std::memcpy(buff + len, &count, sizeof(count));
+            len += sizeof(count);
+            std::memcpy(buff + len, op->args_.data(), sizeof(fred_arg) * count);
+            len += sizeof(fred_arg) * count;
+        }
+
+        if (::write(sock_, buff, len) != static_cast<ssize_t>(len))
+            fail_();
+    }
+
+    void complete_(run_op *op, result res)
+    {
+        op->res_ = res;
+        op->done_ = true;
+
+        if (op->handle_)
+            op->handle_.resume();
+    }
+
+    void complete_job_(uint32_t req_id, result res)
+    {
+        uint32_t idx = req_id & idx_mask;
+        run_op *op;
+
+        if (idx >= MAX_CLIENT_REQS || !jobs_[idx] || ids_[idx] != req_id)
+            return;
+
+        op = jobs_[idx];
+        jobs_[idx] = nullptr;
+
+        // The freed job goes to the first waiter
+        if (waiters_head_) {
+            run_op *next = waiters_head_;
+            waiters_head_ = next->next_;
+            if (!waiters_head_)
+                waiters_tail_ = nullptr;
+            submit_(next);
+        }
+
+        complete_(op, res);
+    }
+
+    // All jobs in flight and waiting complete with an error
+    void fail_()
+    {
+        broken_ = true;
+
+        for (auto &op : jobs_) {
+            if (op)
+                complete_(std::exchange(op, nullptr), result::error);
+        }
+
+        while (waiters_head_)
+            complete_(std::exchange(waiters_head_, waiters_head_->next_), result::error);
+        waiters_tail_ = nullptr;
+    }
+
+    void parse_()
+    {
+        fred_msg msg;
+        size_t len;
+
+        while (!broken_ && rx_len_ >= sizeof(msg)) {
+            std::memcpy(&msg, rx_.data(), sizeof(msg));
+            len = sizeof(msg);
+
+            // Buffers replies are followed by the buffers representations
+            if (fred_msg_get_head(&msg) == FRED_MSG_BUFFS) {
+                uint32_t count = fred_msg_get_arg(&msg);
+
+                if (count > MAX_DATA_BUFFS || (buff_fds_ && rx_fds_count_ < (int)count)) {
+                    fail_();
+                    return;
+                }
+
+                len += (buff_fds_ ? sizeof(uint64_t) : sizeof(user_buff)) * count;
+                if (rx_len_ < len)
+                    return;
+
+                if (buff_fds_)
+                    take_buffs_fds_(count);
+                else
+                    std::memcpy(ctrl_buffs_, rx_.data() + sizeof(msg), len - sizeof(msg));
+            }
+
+            // Consume before resuming, coroutines may submit again
+            rx_len_ -= len;
+            std::memmove(rx_.data(), rx_.data() + len, rx_len_);
+
+            switch (fred_msg_get_head(&msg)) {
+            case FRED_MSG_DONE:
+            case FRED_MSG_OVERRUN:
+            case FRED_MSG_EXPIRED:
+            case FRED_MSG_CANCELLED:
+                complete_job_(fred_msg_get_req_id(&msg),
+                                static_cast<result>(fred_msg_get_head(&msg)));
+                break;
+
+            case FRED_MSG_ERROR:
+                // Errors on bind and init requests carry no id
+                if (fred_msg_get_req_id(&msg)) {
+                    complete_job_(fred_msg_get_req_id(&msg), result::error);
+                    break;
+                }
+                [[fallthrough]];
+
+            case FRED_MSG_ACK:
+            case FRED_MSG_BUFFS:
+                ctrl_msg_ = msg;
+                ctrl_pending_ = false;
+                break;
+
+            default:
+                fail_();
+                return;
+            }
+        }
+    }
+
+    // Read from the socket keeping the passed fds, returns as recv()
+    ssize_t recv_fds_()
+    {
+        ssize_t nread;
+        msghdr msg = {};
+        iovec iov;
+        union {
+            char buf[CMSG_SPACE(sizeof(int) * MAX_DATA_BUFFS)];
+            cmsghdr align;
+        } ctrl;
+
+        iov.iov_base = rx_.data() + rx_len_;
+        iov.iov_len = rx_.size() - rx_len_;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = sizeof(ctrl.buf);
+
+        nread = ::recvmsg(sock_, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (nread <= 0)
+            return nread;
+
+        for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+
+            int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (int i = 0; i < count; ++i) {
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(cmsg) + sizeof(int) * i, sizeof(fd));
+                if (rx_fds_count_ < (int)rx_fds_.size())
+                    rx_fds_[rx_fds_count_++] = fd;
+                else
+                    ::close(fd);
+            }
+        }
+
+        if (msg.msg_flags & MSG_CTRUNC)
+            return 0;
+
+        return nread;
+    }
+
+    // The fds arrive with the first byte of the buffers reply
+    void take_buffs_fds_(uint32_t count)
+    {
+        uint64_t length;
+
+        for (uint32_t i = 0; i < count; ++i) {
+            std::memcpy(&length, rx_.data() + sizeof(fred_msg) + sizeof(length) * i,
+                        sizeof(length));
+            ctrl_buffs_[i] = {};
+            ctrl_buffs_[i].file_d = rx_fds_[i];
+            ctrl_buffs_[i].length = length;
+        }
+
+        rx_fds_count_ -= count;
+        std::memmove(rx_fds_.data(), rx_fds_.data() + count, sizeof(int) * rx_fds_count_);
+    }
+
+    // Block until the server sends something
+    void wait_()
+    {
+        pollfd pfd = { sock_, POLLIN, 0 };
+
+        if (::poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            throw std::system_error(errno, std::generic_category(), "fred: poll");
+
+        process();
+    }
+
+    int ctrl_request_(int head, uint32_t arg)
+    {
+        fred_msg msg;
+
+        if (broken_)
+            return -1;
+
+        fred_msg_set_head(&msg, head);
+        fred_msg_set_arg(&msg, arg);
+        fred_msg_set_req_id(&msg, 0);
+        fred_msg_set_deadline_us(&msg, 0);
+
+        ctrl_pending_ = true;
+        if (::write(sock_, &msg, sizeof(msg)) != sizeof(msg))
+            fail_();
+
+        while (ctrl_pending_ && !broken_)
+            wait_();
+
+        return broken_ ? -1 : fred_msg_get_head(&ctrl_msg_);
+    }
+
+    int sock_ = -1;
+    bool broken_ = false;
+    bool buff_fds_ = false;         // Data buffers passed as fds
+
+    std::array<run_op *, MAX_CLIENT_REQS> jobs_ = {};
+    std::array<uint32_t, MAX_CLIENT_REQS> ids_ = {};
+    uint32_t gen_ = 0;
+    run_op *waiters_head_ = nullptr;
+    run_op *waiters_tail_ = nullptr;
+
+    bool ctrl_pending_ = false;
+    fred_msg ctrl_msg_ = {};
+    user_buff ctrl_buffs_[MAX_DATA_BUFFS];
+
+    // Replies are parsed only when complete
+    std::array<char, sizeof(fred_msg) + sizeof(user_buff) * MAX_DATA_BUFFS> rx_;
+    size_t rx_len_ = 0;
+    std::array<int, MAX_DATA_BUFFS * 2> rx_fds_;
+    int rx_fds_count_ = 0;
+};
+
+inline bool run_op::await_ready()
+{
+    return conn_->broken();
+}
+
+inline void run_op::await_suspend(std::coroutine_handle<> handle)
+{
+    handle_ = handle;
+    conn_->submit_(this);
+}
+
+//---------------------------------------------------------------------------------------------
+
+class executor {
+public:
+    executor()
+    {
+        epfd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        if (epfd_ < 0)
+            throw std::system_error(errno, std::generic_category(), "fred: epoll");
+    }
+
+    executor(const executor &) = delete;
+    executor &operator=(const executor &) = delete;
+
+    ~executor()
+    {
+        for (auto handle : tasks_)
+            handle.destroy();
+        ::close(epfd_);
+    }
+
+    void add(connection &conn)
+    {
+        epoll_event ev = {};
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = &conn;
+        if (::epoll_ctl(epfd_, EPOLL_CTL_ADD, conn.fd(), &ev))
+            throw std::system_error(errno, std::generic_category(), "fred: epoll_ctl");
+    }
+
+    void remove(connection &conn)
+    {
+        ::epoll_ctl(epfd_, EPOLL_CTL_DEL, conn.fd(), nullptr);
+    }
+
+    // Start a task, owned by the executor until finished
+    void spawn(task<> t)
+    {
+        auto handle = std::exchange(t.handle_, {});
+
+        tasks_.push_back(handle);
+        handle.resume();
+    }
+
+    // Run until all spawned tasks are finished. An exception
+    // escaped from a task is rethrown once all are finished
+    void run()
+    {
+        std::array<epoll_event, 64> events;
+        std::exception_ptr exception;
+        int count;
+
+        for (;;) {
+            reap_(exception);
+            if (tasks_.empty())
+                break;
+
+            count = ::epoll_wait(epfd_, events.data(), events.size(), -1);
+            if (count < 0 && errno != EINTR)
+                throw std::system_error(errno, std::generic_category(), "fred: epoll_wait");
+
+            for (int i = 0; i < count; ++i)
+                static_cast<connection *>(events[i].data.ptr)->process();
+        }
+
+        if (exception)
+            std::rethrow_exception(exception);
+    }
+
+private:
+    void reap_(std::exception_ptr &exception)
+    {
+        for (size_t i = 0; i < tasks_.size();) {
+            if (!tasks_[i].done()) {
+                ++i;
+                continue;
+            }
+
+            if (tasks_[i].promise().exception && !exception)
+                exception = tasks_[i].promise().exception;
+
+            tasks_[i].destroy();
+            tasks_[i] = tasks_.back();
+            tasks_.pop_back();
+        }
+    }
+
+    int epfd_ = -1;
+    std::vector<task<>::handle_type> tasks_;
+};
+
+} // namespace fred
+
+#endif /* FRED_CLIENT_HPP_ */
@@ -0,0 +1,740 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "fred_lib.h"
+#include "../utils/dbg_print.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Job ids carry the job index in the low byte and a generation
+// counter above it, so that a stale reply cannot match a new job
+#define JOB_IDX_BITS    8
+#define JOB_IDX_MASK    ((1U << JOB_IDX_BITS) - 1)
+
+struct fred_job {
+    int in_use;
+    int done;
+    uint32_t job_id;
+    int head;
+    fred_job_cb *callback;
+    void *user_data;
+};
+
+struct fred_data {
+    int sock;
+    int broken;
+    int buff_fds;                   // Data buffers passed as fds
+
+    struct fred_job jobs[FRED_LIB_MAX_JOBS];
+    uint32_t gen;
+
+    // Completed jobs without callback, in completion order
+    int comps[FRED_LIB_MAX_JOBS];
+    int comps_count;
+
+    // Reply to the pending bind or init request
+    int ctrl_pending;
+    struct fred_msg ctrl_msg;
+    struct user_buff ctrl_buffs[MAX_DATA_BUFFS];
+
+    struct fred_hw_task *hw_tasks[MAX_HW_TASKS];
+    int hw_tasks_count;
+
+    // Replies are parsed only when complete, the fds
+    // received meanwhile wait for their buffers reply
+    char rx_buff[sizeof(struct fred_msg) + sizeof(struct user_buff) * MAX_DATA_BUFFS];
+    size_t rx_len;
+    int rx_fds[MAX_DATA_BUFFS * 2];
+    int rx_fds_count;
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int write_to_server_(struct fred_data *self, const void *data, size_t data_len)
+{
+    ssize_t retval;
+
+    retval = write(self->sock, data, data_len);
+    if (retval != (ssize_t)data_len) {
+        ERROR_PRINT("fred_lib: unable to reach server. Error: %s\n", strerror(errno));
+        self->broken = 1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline
+int send_fred_message_(struct fred_data *self, int head, uint32_t arg, uint32_t req_id,
+                        uint32_t deadline_us)
+{
+    struct fred_msg msg;
+
+    fred_msg_set_head(&msg, head);
+    fred_msg_set_arg(&msg, arg);
+    fred_msg_set_req_id(&msg, req_id);
+    fred_msg_set_deadline_us(&msg, deadline_us);
+
+    return write_to_server_(self, &msg, sizeof(msg));
+}
+
+static
+int complete_job_(struct fred_data *self, uint32_t job_id, int head)
+{
+    struct fred_job *job;
+    struct fred_completion comp;
+
+    // Ignore replies not matching an outstanding job
+    if ((job_id & JOB_IDX_MASK) >= FRED_LIB_MAX_JOBS)
+        return 0;
+
+    job = &self->jobs[job_id & JOB_IDX_MASK];
+    if (!job->in_use || job->done || job->job_id != job_id)
+        return 0;
+
+    if (!job->callback) {
+        job->done = 1;
+        job->head = head;
+        self->comps[self->comps_count++] = job_id & JOB_IDX_MASK;
+        return 1;
+    }
+
+    // The job is released first, so that the callback can submit again
+    comp.job_id = job_id;
+    comp.head = head;
+    comp.user_data = job->user_data;
+    job->in_use = 0;
+
+    job->callback(self, &comp);
+
+    return 1;
+}
+
+// Returns the number of jobs completed, -1 on protocol error
+static
+int dispatch_msg_(struct fred_data *self, const struct fred_msg *msg)
+{
+    switch (fred_msg_get_head(msg)) {
+    case FRED_MSG_DONE:
+    case FRED_MSG_OVERRUN:
+    case FRED_MSG_EXPIRED:
+    case FRED_MSG_CANCELLED:
+        return complete_job_(self, fred_msg_get_req_id(msg), fred_msg_get_head(msg));
+
+    case FRED_MSG_ERROR:
+        // Errors on bind and init requests carry no id
+        if (fred_msg_get_req_id(msg))
+            return complete_job_(self, fred_msg_get_req_id(msg), FRED_MSG_ERROR);
+        // Fall through
+
+    case FRED_MSG_ACK:
+    case FRED_MSG_BUFFS:
+        if (!self->ctrl_pending) {
+            ERROR_PRINT("fred_lib: unexpected reply from server\n");
+            return -1;
+        }
+        self->ctrl_msg = *msg;
+        self->ctrl_pending = 0;
+        return 0;
+
+    case FRED_MSG_CRIT:
+        ERROR_PRINT("fred_lib: server critical error\n");
+        return -1;
+
+    default:
+        ERROR_PRINT("fred_lib: unknown reply from server: %d\n", fred_msg_get_head(msg));
+        return -1;
+    }
+}
+
+// Returns 1 if the buffers reply is not complete yet, -1 on protocol error
+static
+int parse_buffs_(struct fred_data *self, const struct fred_msg *msg, size_t *msg_len)
+{
+    uint32_t count;
+    uint64_t length;
+
+    count = fred_msg_get_arg(msg);
+    if (count > MAX_DATA_BUFFS) {
+        ERROR_PRINT("fred_lib: malformed buffers reply from server\n");
+        return -1;
+    }
+
+    if (!self->buff_fds) {
+        *msg_len += sizeof(struct user_buff) * count;
+        if (self->rx_len < *msg_len)
+            return 1;
+
+        memcpy(self->ctrl_buffs, self->rx_buff + sizeof(*msg), *msg_len - sizeof(*msg));
+        return 0;
+    }
+
+    // The fds arrive with the first byte of the reply
+    *msg_len += sizeof(length) * count;
+    if (self->rx_len < *msg_len)
+        return 1;
+
+    if (self->rx_fds_count < (int)count) {
+        ERROR_PRINT("fred_lib: buffers reply without file descriptors\n");
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        memcpy(&length, self->rx_buff + sizeof(*msg) + sizeof(length) * i, sizeof(length));
+        user_buff_init_fd(&self->ctrl_buffs[i], self->rx_fds[i], length);
+    }
+
+    self->rx_fds_count -= count;
+    memmove(self->rx_fds, self->rx_fds + count, sizeof(self->rx_fds[0]) * self->rx_fds_count);
+
+    return 0;
+}
+
+// Read from the socket keeping the passed fds, returns as recv()
+static
+ssize_t recv_fds_(struct fred_data *self)
+{
+    ssize_t nread;
+    int count;
+    int *fds;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * MAX_DATA_BUFFS)];
+        struct cmsghdr align;
+    } ctrl;
+
+    iov.iov_base = self->rx_buff + self->rx_len;
+    iov.iov_len = sizeof(self->rx_buff) - self->rx_len;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    nread = recvmsg(self->sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (nread <= 0)
+        return nread;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        fds = (int *)CMSG_DATA(cmsg);
+
+        for (int i = 0; i < count; ++i) {
+            if (self->rx_fds_count < (int)(sizeof(self->rx_fds) / sizeof(self->rx_fds[0])))
+                self->rx_fds[self->rx_fds_count++] = fds[i];
+            else
+                close(fds[i]);
+        }
+    }
+
+    if (msg.msg_flags & MSG_CTRUNC) {
+        ERROR_PRINT("fred_lib: file descriptors from server truncated\n");
+        errno = EPROTO;
+        return -1;
+    }
+
+    return nread;
+}
+
+// Consume the complete replies in the receive buffer
+static
+int parse_replies_(struct fred_data *self)
+{
+    int retval;
+    int completed = 0;
+    size_t msg_len;
+    struct fred_msg msg;
+
+    while (self->rx_len >= sizeof(msg)) {
+        memcpy(&msg, self->rx_buff, sizeof(msg));
+        msg_len = sizeof(msg);
+
+        // Buffers replies are followed by the buffers representations
+        if (fred_msg_get_head(&msg) == FRED_MSG_BUFFS) {
+            retval = parse_buffs_(self, &msg, &msg_len);
+            if (retval < 0)
+                return -1;
+            else if (retval)
+                break;
+        }
+
+        // Consume before dispatching, callbacks may reenter the library
+        self->rx_len -= msg_len;
+        memmove(self->rx_buff, self->rx_buff + msg_len, self->rx_len);
+
+        retval = dispatch_msg_(self, &msg);
+        if (retval < 0)
+            return -1;
+
+        completed += retval;
+    }
+
+    return completed;
+}
+
+// Wait until the server sends something, then process it
+static
+int wait_replies_(struct fred_data *self)
+{
+    int retval;
+    struct pollfd pfd;
+
+    pfd.fd = self->sock;
+    pfd.events = POLLIN;
+
+    do {
+        retval = poll(&pfd, 1, -1);
+    } while (retval < 0 && errno == EINTR);
+
+    if (retval < 0) {
+        ERROR_PRINT("fred_lib: error waiting for server: %s\n", strerror(errno));
+        return -1;
+    }
+
+    return fred_process(self);
+}
+
+// Send a bind or init request and wait for the reply
+static
+int ctrl_request_(struct fred_data *self, int head, uint32_t arg)
+{
+    int retval;
+
+    if (self->broken)
+        return -1;
+
+    self->ctrl_pending = 1;
+
+    retval = send_fred_message_(self, head, arg, 0, 0);
+    if (retval)
+        return -1;
+
+    while (self->ctrl_pending) {
+        retval = wait_replies_(self);
+        if (retval < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+// The server listens either on a stream or on a sequenced packets socket
+static
+int connect_server_(void)
+{
+    int sock;
+    int retval;
+    const int types[] = {SOCK_STREAM, SOCK_SEQPACKET};
+    struct sockaddr_un serv_addr;
+
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sun_family = AF_UNIX;
+    strncpy(serv_addr.sun_path, LIST_SOCK_PATH, sizeof(serv_addr.sun_path) - 1);
+
+    for (int i = 0; i < 2; ++i) {
+        sock = socket(AF_UNIX, types[i], 0);
+        if (sock < 0) {
+            ERROR_PRINT("fred_lib: error opening socket: %s\n", strerror(errno));
+            return -1;
+        }
+
+        retval = connect(sock, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
+        if (!retval)
+            return sock;
+
+        close(sock);
+        if (errno != EPROTOTYPE)
+            break;
+    }
+
+    ERROR_PRINT("fred_lib: unable to connect to server: %s\n", strerror(errno));
+
+    return -1;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int fred_init(struct fred_data **self)
+{
+    int retval;
+
+    assert(self);
+
+    *self = calloc(1, sizeof(**self));
+    if (!(*self))
+        return -1;
+
+    (*self)->sock = connect_server_();
+    if ((*self)->sock < 0)
+        goto error_free;
+
+    // Prefer the data buffers already open
+    retval = ctrl_request_(*self, FRED_MSG_INIT, FRED_INIT_BUFF_FDS);
+    if (retval || fred_msg_get_head(&(*self)->ctrl_msg) != FRED_MSG_ACK) {
+        ERROR_PRINT("fred_lib: server refused the connection\n");
+        goto error_close;
+    }
+
+    (*self)->buff_fds = !!(fred_msg_get_arg(&(*self)->ctrl_msg) & FRED_INIT_BUFF_FDS);
+
+    DBG_PRINT("fred_lib: connected to server\n");
+
+    return 0;
+
+error_close:
+    close((*self)->sock);
+error_free:
+    free(*self);
+    *self = NULL;
+    return -1;
+}
+
+void fred_free(struct fred_data *self)
+{
+    if (!self)
+        return;
+
+    for (int i = 0; i < self->hw_tasks_count; ++i) {
+        for (int j = 0; j < self->hw_tasks[i]->buffs_count; ++j)
+            user_buff_close(&self->hw_tasks[i]->buffs[j]);
+        free(self->hw_tasks[i]);
+    }
+
+    for (int i = 0; i < self->rx_fds_count; ++i)
+        close(self->rx_fds[i]);
+
+    close(self->sock);
+    free(self);
+}
+
+int fred_get_fd(const struct fred_data *self)
+{
+    assert(self);
+
+    return self->sock;
+}
+
+int fred_bind(struct fred_data *self, struct fred_hw_task **hw_task, uint32_t hw_task_id)
+{
+    int retval;
+    int buffs_count;
+
+    assert(self);
+    assert(hw_task);
+
+    if (self->hw_tasks_count >= MAX_HW_TASKS)
+        return -1;
+
+    retval = ctrl_request_(self, FRED_MSG_BIND, hw_task_id);
+    if (retval || fred_msg_get_head(&self->ctrl_msg) != FRED_MSG_BUFFS) {
+        ERROR_PRINT("fred_lib: unable to bind hw-task id: %u\n", hw_task_id);
+        return -1;
+    }
+
+    buffs_count = fred_msg_get_arg(&self->ctrl_msg);
+
+    *hw_task = calloc(1, sizeof(**hw_task));
+    if (!(*hw_task)) {
+        for (int i = 0; self->buff_fds && i < buffs_count; ++i)
+            user_buff_close(&self->ctrl_buffs[i]);
+        return -1;
+    }
+
+    (*hw_task)->hw_task_id = hw_task_id;
+    (*hw_task)->buffs_count = buffs_count;
+
+    // Only the length and the device name (or fd) are meaningful on this side
+    for (int i = 0; i < buffs_count; ++i) {
+        if (self->buff_fds) {
+            (*hw_task)->buffs[i] = self->ctrl_buffs[i];
+            continue;
+        }
+
+        user_buff_init(&(*hw_task)->buffs[i]);
+        (*hw_task)->buffs[i].length = self->ctrl_buffs[i].length;
+        memcpy((*hw_task)->buffs[i].dev_name, self->ctrl_buffs[i].dev_name,
+                sizeof((*hw_task)->buffs[i].dev_name));
+        (*hw_task)->buffs[i].dev_name[MAX_PATH - 1] = '\0';
+    }
+
+    self->hw_tasks[self->hw_tasks_count++] = *hw_task;
+
+    return 0;
+}
+
+void *fred_map_buff(const struct fred_data *self, struct fred_hw_task *hw_task, int buff_idx)
+{
+    assert(self);
+    assert(hw_task);
+
+    if (buff_idx < 0 || buff_idx >= hw_task->buffs_count)
+        return NULL;
+
+    return user_buff_map(&hw_task->buffs[buff_idx]);
+}
+
+void fred_unmap_buff(const struct fred_data *self, struct fred_hw_task *hw_task, int buff_idx)
+{
+    assert(self);
+    assert(hw_task);
+
+    if (buff_idx < 0 || buff_idx >= hw_task->buffs_count)
+        return;
+
+    user_buff_unmap(&hw_task->buffs[buff_idx]);
+    hw_task->buffs[buff_idx].map_addr = NULL;
+}
+
+int fred_get_buffs_count(const struct fred_hw_task *hw_task)
+{
+    assert(hw_task);
+
+    return hw_task->buffs_count;
+}
+
+size_t fred_get_buff_size(const struct fred_hw_task *hw_task, int buff_idx)
+{
+    assert(hw_task);
+    assert(buff_idx >= 0 && buff_idx < hw_task->buffs_count);
+
+    return user_buff_get_size(&hw_task->buffs[buff_idx]);
+}
+
+int fred_submit(struct fred_data *self, const struct fred_hw_task *hw_task,
+                uint32_t deadline_us, const struct fred_arg *args, int args_count,
+                fred_job_cb *callback, void *user_data, uint32_t *job_id)
+{
+    int retval;
+    int idx = -1;
+    uint32_t count;
+    struct fred_job *job;
+    struct fred_msg msg;
+    char buff[sizeof(msg) + sizeof(count) + sizeof(struct fred_arg) * FRED_RUN_MAX_ARGS];
+
+    assert(self);
+    assert(hw_task);
+    assert(args || !args_count);
+
+    if (self->broken || args_count < 0 || args_count > FRED_RUN_MAX_ARGS)
+        return -1;
+
+    for (int i = 0; i < FRED_LIB_MAX_JOBS; ++i) {
+        if (!self->jobs[i].in_use) {
+            idx = i;
+            break;
+        }
+    }
+
+    if (idx < 0)
+        return 1;
+
+    // Generation 0 is skipped, id 0 is used by bind and init replies
+    self->gen++;
+    if (!(self->gen << JOB_IDX_BITS))
+        self->gen = 1;
+
+    job = &self->jobs[idx];
+    job->in_use = 1;
+    job->done = 0;
+    job->job_id = (self->gen << JOB_IDX_BITS) | idx;
+    job->callback = callback;
+    job->user_data = user_data;
+
+    fred_msg_set_head(&msg, args_count ? FRED_MSG_RUN_ARGS : FRED_MSG_RUN);
+    fred_msg_set_arg(&msg, hw_task->hw_task_id);
+    fred_msg_set_req_id(&msg, job->job_id);
+    fred_msg_set_deadline_us(&msg, deadline_us);
+
+    // The arguments must be sent in the same write
+    if (args_count) {
+        count = args_count;
+        memcpy(buff, &msg, sizeof(msg));
+        memcpy(buff + sizeof(msg), &count, sizeof(count));
+        memcpy(buff + sizeof(msg) + sizeof(count), args, sizeof(args[0]) * args_count);
+        retval = write_to_server_(self, buff,
+                                    sizeof(msg) + sizeof(count) + sizeof(args[0]) * args_count);
+    } else {
+        retval = write_to_server_(self, &msg, sizeof(msg));
+    }
+
+    if (retval) {
+        job->in_use = 0;
+        return -1;
+    }
+
+    if (job_id)
+        *job_id = job->job_id;
+
+    return 0;
+}
+
+int fred_cancel(struct fred_data *self, uint32_t job_id)
+{
+    struct fred_job *job;
+
+    assert(self);
+
+    if (self->broken || (job_id & JOB_IDX_MASK) >= FRED_LIB_MAX_JOBS)
+        return -1;
+
+    // Nothing to cancel once completed
+    job = &self->jobs[job_id & JOB_IDX_MASK];
+    if (!job->in_use || job->job_id != job_id)
+        return -1;
+
+    if (job->done)
+        return 0;
+
+    return send_fred_message_(self, FRED_MSG_CANCEL, 0, job_id, 0);
+}
+
+int fred_process(struct fred_data *self)
+{
+    ssize_t nread;
+    int retval;
+    int completed = 0;
+
+    assert(self);
+
+    if (self->broken)
+        return -1;
+
+    // Drain the socket, so that edge triggered event loops can be used
+    for (;;) {
+        nread = recv_fds_(self);
+
+        if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+
+        } else if (nread < 0 && errno == EINTR) {
+            continue;
+
+        } else if (nread <= 0) {
+            ERROR_PRINT("fred_lib: connection to server lost\n");
+            self->broken = 1;
+            return -1;
+        }
+
+        self->rx_len += nread;
+
+        retval = parse_replies_(self);
+        if (retval < 0) {
+            self->broken = 1;
+            return -1;
+        }
+
+        completed += retval;
+    }
+
+    return completed;
+}
+
+int fred_get_completions(struct fred_data *self, struct fred_completion *comps, int comps_max)
+{
+    int count;
+    struct fred_job *job;
+
+    assert(self);
+    assert(comps);
+
+    count = comps_max < self->comps_count ? comps_max : self->comps_count;
+
+    for (int i = 0; i < count; ++i) {
+        job = &self->jobs[self->comps[i]];
+        comps[i].job_id = job->job_id;
+        comps[i].head = job->head;
+        comps[i].user_data = job->user_data;
+        job->in_use = 0;
+    }
+
+    self->comps_count -= count;
+    memmove(self->comps, self->comps + count, sizeof(self->comps[0]) * self->comps_count);
+
+    return count;
+}
+
+int fred_wait(struct fred_data *self, uint32_t job_id)
+{
+    int retval;
+    struct fred_job *job;
+
+    assert(self);
+
+    if ((job_id & JOB_IDX_MASK) >= FRED_LIB_MAX_JOBS)
+        return -1;
+
+    job = &self->jobs[job_id & JOB_IDX_MASK];
+    if (!job->in_use || job->callback || job->job_id != job_id)
+        return -1;
+
+    while (!job->done) {
+        retval = wait_replies_(self);
+        if (retval < 0)
+            return -1;
+    }
+
+    // Remove it from the completions to be reaped
+    for (int i = 0; i < self->comps_count; ++i) {
+        if (self->comps[i] == (int)(job_id & JOB_IDX_MASK)) {
+            self->comps_count--;
+            memmove(&self->comps[i], &self->comps[i + 1],
+                    sizeof(self->comps[0]) * (self->comps_count - i));
+            break;
+        }
+    }
+
+    job->in_use = 0;
+
+    return job->head;
+}
+
+int fred_accel(struct fred_data *self, const struct fred_hw_task *hw_task)
+{
+    int retval;
+    uint32_t job_id;
+
+    assert(self);
+    assert(hw_task);
+
+    // Wait for a free job if all are outstanding
+    while ((retval = fred_submit(self, hw_task, 0, NULL, 0, NULL, NULL, &job_id)) == 1) {
+        // Completed but not reaped jobs would never be freed
+        if (self->comps_count == FRED_LIB_MAX_JOBS)
+            return -1;
+
+        retval = wait_replies_(self);
+        if (retval < 0)
+            return -1;
+    }
+
+    if (retval)
+        return -1;
+
+    return fred_wait(self, job_id) == FRED_MSG_DONE ? 0 : -1;
+}
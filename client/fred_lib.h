@@ -0,0 +1,104 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef FRED_LIB_H_
+#define FRED_LIB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../parameters.h"
+#include "../shared_user/fred_msg.h"
+#include "../shared_user/user_buff.h"
+
+//---------------------------------------------------------------------------------------------
+//
+// Client library for the fred server (libfred-client).
+//
+// Hw-tasks are bound and their data buffers mapped with blocking calls. Jobs can then
+// be run in three flavors, mixed freely on the same connection:
+//  - blocking:     fred_accel() submits a job and waits for it;
+//  - non-blocking: fred_submit() without callback, then fred_process() when the fd
+//                  returned by fred_get_fd() is readable and fred_get_completions();
+//  - callback:     fred_submit() with a callback, called from fred_process().
+// Up to FRED_LIB_MAX_JOBS jobs can be outstanding. Callbacks may also be called from
+// the blocking calls, while they wait. The library is not thread safe.
+//
+//---------------------------------------------------------------------------------------------
+
+// As the server limit for each client
+#define FRED_LIB_MAX_JOBS       MAX_CLIENT_REQS
+
+struct fred_data;
+
+struct fred_hw_task {
+    uint32_t hw_task_id;
+    int buffs_count;
+    struct user_buff buffs[MAX_DATA_BUFFS];
+};
+
+struct fred_completion {
+    uint32_t job_id;
+    int head;               // FRED_MSG_DONE, OVERRUN, EXPIRED, CANCELLED or ERROR
+    void *user_data;
+};
+
+typedef void (fred_job_cb)(struct fred_data *fred, const struct fred_completion *comp);
+
+//---------------------------------------------------------------------------------------------
+
+// Connect to the server. Returns 0 on success, -1 on error
+int fred_init(struct fred_data **self);
+
+void fred_free(struct fred_data *self);
+
+// Readable when fred_process() has something to do
+int fred_get_fd(const struct fred_data *self);
+
+// Bind a hw-task to the client. Returns 0 on success, -1 on error
+int fred_bind(struct fred_data *self, struct fred_hw_task **hw_task, uint32_t hw_task_id);
+
+void *fred_map_buff(const struct fred_data *self, struct fred_hw_task *hw_task, int buff_idx);
+
+void fred_unmap_buff(const struct fred_data *self, struct fred_hw_task *hw_task, int buff_idx);
+
+int fred_get_buffs_count(const struct fred_hw_task *hw_task);
+
+size_t fred_get_buff_size(const struct fred_hw_task *hw_task, int buff_idx);
+
+// Submit a job without waiting. With no arguments the hw-task gets its data buffers
+// (as FRED_MSG_RUN), deadline_us is relative (0 for none). Returns 0 on success and
+// the job id, 1 if too many jobs are outstanding, -1 on error
+int fred_submit(struct fred_data *self, const struct fred_hw_task *hw_task,
+                uint32_t deadline_us, const struct fred_arg *args, int args_count,
+                fred_job_cb *callback, void *user_data, uint32_t *job_id);
+
+// Ask the server to drop a job not started yet. The job still completes, with
+// FRED_MSG_CANCELLED if it has been dropped. Returns 0 on success, -1 on error
+int fred_cancel(struct fred_data *self, uint32_t job_id);
+
+// Read the available replies without blocking and call the callbacks.
+// Returns the number of jobs completed, -1 if the connection is lost
+int fred_process(struct fred_data *self);
+
+// Get the completions of the jobs submitted without callback
+int fred_get_completions(struct fred_data *self, struct fred_completion *comps, int comps_max);
+
+// Wait for a job submitted without callback. Returns its head, -1 on error
+int fred_wait(struct fred_data *self, uint32_t job_id);
+
+// Run a job and wait for it. Returns 0 if done, -1 otherwise
+int fred_accel(struct fred_data *self, const struct fred_hw_task *hw_task);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* FRED_LIB_H_ */
@@ -28,8 +28,13 @@ struct slot_drv {
     int (*start_compute)(struct slot_drv *self, const uintptr_t *args, int args_size);
     void (*after_compute)(struct slot_drv *self);
 
-    // Only for testing
-    void (*wait_for_compl)(const struct slot_drv *self);
+    // Polled completion (set before starting): the interrupt is masked and the
+    // completion is busy waited with wait_for_compl()
+    void (*set_polled)(struct slot_drv *self, int polled);
+
+    // Busy wait the completion of a polled computation for at most spin_us.
+    // Returns 1 if completed, 0 if not, then the completion is signalled on the fd
+    int (*wait_for_compl)(struct slot_drv *self, uint64_t spin_us);
 
     void (*free)(struct slot_drv *self);
 };
@@ -88,11 +93,19 @@ void slot_drv_after_compute(struct slot_drv *self)
 }
 
 static inline
-void slot_drv_wait_for_compl(const struct slot_drv *self)
+void slot_drv_set_polled(struct slot_drv *self, int polled)
+{
+    assert(self);
+
+    self->set_polled(self, polled);
+}
+
+static inline
+int slot_drv_wait_for_compl(struct slot_drv *self, uint64_t spin_us)
 {
     assert(self);
 
-    self->wait_for_compl(self);
+    return self->wait_for_compl(self, spin_us);
 }
 
 static inline
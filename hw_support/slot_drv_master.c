@@ -13,6 +13,7 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "slot_drv_master.h"
 #include "../utils/dbg_print.h"
@@ -21,6 +22,10 @@
 
 #define SLOT_CTRL_BUS_DEPTH_ARGS        8
 
+// AP_CTRL bits
+#define AP_START                        (1U << 0)
+#define AP_IDLE                         (1U << 2)
+
 // 64-bit HW-tasks
 #ifdef HW_TASKS_A64
 struct slot_regs {
@@ -99,6 +104,7 @@ void slot_drv_master_after_rcfg_(struct slot_drv *self)
 
     // Enable global interrupt
     regs->GIE = 1U;
+    master_drv->polled = 0;
 }
 
 int slot_drv_master_start_compute_(struct slot_drv *self, const uintptr_t *args,
@@ -141,6 +147,10 @@ void slot_drv_master_after_compute_(struct slot_drv *self)
 
     regs = (struct slot_regs *)uio_get_base_addr(master_drv->uio_dev);
 
+    // Polled, the local interrupt register has been cleared already
+    if (master_drv->polled)
+        return;
+
     // Consume the UIO event
     uio_read_for_irq(master_drv->uio_dev);
 
@@ -151,10 +161,34 @@ void slot_drv_master_after_compute_(struct slot_drv *self)
     uio_clear_gic(master_drv->uio_dev);
 }
 
-void slot_drv_master_wait_for_compl_(const struct slot_drv *self)
+// The local interrupt stays enabled: a completion latched in the ISR while polling
+// raises the interrupt as soon as the global one is enabled again
+void slot_drv_master_set_polled_(struct slot_drv *self, int polled)
+{
+    struct slot_drv_master *master_drv;
+    struct slot_regs *regs;
+
+    assert(self);
+
+    master_drv = (struct slot_drv_master *)self;
+
+    if (master_drv->polled == polled)
+        return;
+
+    regs = (struct slot_regs *)uio_get_base_addr(master_drv->uio_dev);
+
+    regs->GIE = polled ? 0U : 1U;
+    master_drv->polled = polled;
+}
+
+int slot_drv_master_wait_for_compl_(struct slot_drv *self, uint64_t spin_us)
 {
     struct slot_drv_master *master_drv;
     struct slot_regs *regs;
+    struct timespec ts;
+    uint64_t now_ns;
+    uint64_t end_ns;
+    uint32_t ap_ctrl;
 
     assert(self);
 
@@ -162,7 +196,25 @@ void slot_drv_master_wait_for_compl_(const struct slot_drv *self)
 
     regs = (struct slot_regs *)uio_get_base_addr(master_drv->uio_dev);
 
-    do {} while (regs->AP_CTRL & 1U);
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    end_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec + spin_us * 1000;
+
+    do {
+        ap_ctrl = regs->AP_CTRL;
+        if (!(ap_ctrl & AP_START) && (ap_ctrl & AP_IDLE)) {
+            // Clear the latched completion, no interrupt will be raised
+            regs->ISR = 1U;
+            return 1;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    } while (now_ns < end_ns);
+
+    // Fall back to the interrupt
+    slot_drv_master_set_polled_(self, 0);
+
+    return 0;
 }
 
 void slot_drv_master_free_(struct slot_drv *self)
@@ -202,6 +254,7 @@ int slot_drv_master_init(struct slot_drv **self, const char *dev_name)
     master_drv->slot_drv.after_rcfg = slot_drv_master_after_rcfg_;
     master_drv->slot_drv.start_compute = slot_drv_master_start_compute_;
     master_drv->slot_drv.after_compute = slot_drv_master_after_compute_;
+    master_drv->slot_drv.set_polled = slot_drv_master_set_polled_;
     master_drv->slot_drv.wait_for_compl = slot_drv_master_wait_for_compl_;
     master_drv->slot_drv.free = slot_drv_master_free_;
 
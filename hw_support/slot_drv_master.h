@@ -25,6 +25,9 @@ struct slot_drv_master {
 
     // Driver UIO component
     struct uio_dev *uio_dev;
+
+    // Completion busy waited, global interrupt disabled
+    int polled;
 };
 
 //---------------------------------------------------------------------------------------------
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -81,14 +82,47 @@ void slot_drv_null_after_compute_(struct slot_drv *self)
 
     null_drv = (struct slot_drv_null *)self;
 
-    fd_utils_byte_read(null_drv->out_fd);
+    if (!null_drv->polled)
+        fd_utils_byte_read(null_drv->out_fd);
 }
 
-void slot_drv_null_wait_for_compl_(const struct slot_drv *self)
+void slot_drv_null_set_polled_(struct slot_drv *self, int polled)
 {
+    struct slot_drv_null *null_drv;
+
     assert(self);
 
-    // Empty, no actions required
+    null_drv = (struct slot_drv_null *)self;
+
+    null_drv->polled = polled;
+}
+
+// Emulated by consuming the byte before the reactor sees it
+int slot_drv_null_wait_for_compl_(struct slot_drv *self, uint64_t spin_us)
+{
+    struct slot_drv_null *null_drv;
+    struct timespec ts;
+    uint64_t now_ns;
+    uint64_t end_ns;
+
+    assert(self);
+
+    null_drv = (struct slot_drv_null *)self;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    end_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec + spin_us * 1000;
+
+    do {
+        if (!fd_utils_byte_read(null_drv->out_fd))
+            return 1;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now_ns = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+    } while (now_ns < end_ns);
+
+    null_drv->polled = 0;
+
+    return 0;
 }
 
 void slot_drv_null_free_(struct slot_drv *self)
@@ -128,6 +162,7 @@ int slot_drv_null_init(struct slot_drv **self, const char *dev_name)
     null_drv->slot_drv.after_rcfg = slot_drv_null_after_rcfg_;
     null_drv->slot_drv.start_compute = slot_drv_null_start_compute_;
     null_drv->slot_drv.after_compute = slot_drv_null_after_compute_;
+    null_drv->slot_drv.set_polled = slot_drv_null_set_polled_;
     null_drv->slot_drv.wait_for_compl = slot_drv_null_wait_for_compl_;
     null_drv->slot_drv.free = slot_drv_null_free_;
 
@@ -26,6 +26,9 @@ struct slot_drv_null {
     // Null driver
     int out_fd;
     int in_fd;
+
+    // Completion (byte) consumed while busy waiting
+    int polled;
 };
 
 //---------------------------------------------------------------------------------------------
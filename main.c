@@ -13,6 +13,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "srv_core/fred_sys.h"
@@ -23,30 +24,138 @@
 int main(int argc, char **argv)
 {
     int retval;
-    int opts;
+    int opt;
     struct fred_sys *fred_sys;
-    enum fred_sys_mode mode;
+    struct fred_sys_opts sys_opts;
+
+    sys_opts.mode = FRED_SYS_NORMAL_MODE;
+    sys_opts.reactor_type = REACTOR_EPOLL;
+    sys_opts.sharded = 0;
+    sys_opts.fri_order = FRI_ORDER_EDF;
+    sys_opts.slot_evict = SLOT_EVICT_LAST;
+    sys_opts.prefetch = 0;
+    sys_opts.fast_skip = 0;
+    sys_opts.lookahead = 0;
+    sys_opts.aging_limit = DEF_PART_QUEUE_AGING_LIMIT;
+    sys_opts.seqpacket = 0;
+    sys_opts.out_high_water = DEF_CLIENT_OUT_HIGH_WATER;
+    sys_opts.drain_budget = 0;
 
     opterr = 0;
-    opts = getopt(argc, argv, "hre");
-
-    switch (opts) {
-        case 'h':
-            printf("Use -r for reconfiguration test, -e for execution test\n");
-            return 0;
-            break;
-        case 'r':
-            mode = FRED_SYS_RCFG_TEST_MODE;
-            break;
-        case 'e':
-            mode = FRED_SYS_HW_TASKS_TEST_MODE;
-            break;
-        default:
-            mode = FRED_SYS_NORMAL_MODE;
-            break;
+    while ((opt = getopt(argc, argv, "hresfkpb:o:c:l:a:q:d:")) != -1) {
+        switch (opt) {
+            case 'h':
+                printf("Use -r for reconfiguration test, -e for execution test\n");
+                printf("Use -b epoll|poll|uring to select the event reactor backend\n");
+                printf("Use -s to run each partition on its own event loop thread\n");
+                printf("Use -o edf|fifo|sbf|llf to select the reconfiguration queue ordering\n");
+                printf("Use -c last|lru|lfu|cost to select the slot eviction policy\n");
+                printf("Use -f to speculatively reconfigure idle slots\n");
+                printf("Use -k to start requests not needing rcfg without queuing\n");
+                printf("Use -l <window> to let queued requests reuse a freed slot (max %d)\n",
+                        MAX_PART_QUEUE_LOOKAHEAD);
+                printf("Use -a <limit> to set how many times a queued request can be bypassed\n");
+                printf("Use -p to accept clients on a sequenced packets socket\n");
+                printf("Use -q <bytes> to set the pending replies that throttle a client"
+                        " (max %d)\n", CLIENT_OUT_BUFF_SIZE);
+                printf("Use -d <requests> to serve clients edge-triggered, reading up to"
+                        " <requests> for each event\n");
+                return 0;
+                break;
+            case 'r':
+                sys_opts.mode = FRED_SYS_RCFG_TEST_MODE;
+                break;
+            case 'e':
+                sys_opts.mode = FRED_SYS_HW_TASKS_TEST_MODE;
+                break;
+            case 's':
+                sys_opts.sharded = 1;
+                break;
+            case 'f':
+                sys_opts.prefetch = 1;
+                break;
+            case 'k':
+                sys_opts.fast_skip = 1;
+                break;
+            case 'p':
+                sys_opts.seqpacket = 1;
+                break;
+            case 'b':
+                if (!strcmp(optarg, "poll")) {
+                    sys_opts.reactor_type = REACTOR_POLL;
+                } else if (!strcmp(optarg, "uring")) {
+                    sys_opts.reactor_type = REACTOR_URING;
+                } else if (!strcmp(optarg, "epoll")) {
+                    sys_opts.reactor_type = REACTOR_EPOLL;
+                } else {
+                    printf("Unknown reactor backend: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'o':
+                if (!strcmp(optarg, "sbf")) {
+                    sys_opts.fri_order = FRI_ORDER_SHORTEST_BIT;
+                } else if (!strcmp(optarg, "llf")) {
+                    sys_opts.fri_order = FRI_ORDER_LEAST_LAXITY;
+                } else if (!strcmp(optarg, "fifo")) {
+                    sys_opts.fri_order = FRI_ORDER_FIFO;
+                } else if (!strcmp(optarg, "edf")) {
+                    sys_opts.fri_order = FRI_ORDER_EDF;
+                } else {
+                    printf("Unknown reconfiguration queue ordering: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'c':
+                if (!strcmp(optarg, "lfu")) {
+                    sys_opts.slot_evict = SLOT_EVICT_LFU;
+                } else if (!strcmp(optarg, "cost")) {
+                    sys_opts.slot_evict = SLOT_EVICT_COST;
+                } else if (!strcmp(optarg, "last")) {
+                    sys_opts.slot_evict = SLOT_EVICT_LAST;
+                } else if (!strcmp(optarg, "lru")) {
+                    sys_opts.slot_evict = SLOT_EVICT_LRU;
+                } else {
+                    printf("Unknown slot eviction policy: %s\n", optarg);
+                    return -1;
+                }
+                break;
+            case 'l':
+                sys_opts.lookahead = atoi(optarg);
+                if (sys_opts.lookahead < 0 || sys_opts.lookahead > MAX_PART_QUEUE_LOOKAHEAD) {
+                    printf("Look-ahead window must be between 0 and %d\n",
+                            MAX_PART_QUEUE_LOOKAHEAD);
+                    return -1;
+                }
+                break;
+            case 'a':
+                sys_opts.aging_limit = atoi(optarg);
+                if (sys_opts.aging_limit < 0) {
+                    printf("Aging limit must not be negative\n");
+                    return -1;
+                }
+                break;
+            case 'q':
+                sys_opts.out_high_water = atoi(optarg);
+                if (atoi(optarg) <= 0 || sys_opts.out_high_water > CLIENT_OUT_BUFF_SIZE) {
+                    printf("Throttling mark must be between 1 and %d bytes\n",
+                            CLIENT_OUT_BUFF_SIZE);
+                    return -1;
+                }
+                break;
+            case 'd':
+                sys_opts.drain_budget = atoi(optarg);
+                if (sys_opts.drain_budget <= 0) {
+                    printf("Drain budget must be positive\n");
+                    return -1;
+                }
+                break;
+            default:
+                break;
+        }
     }
 
-    retval = fred_sys_init(&fred_sys, ARCH_FILE, HW_TASKS_FILE, mode);
+    retval = fred_sys_init(&fred_sys, ARCH_FILE, HW_TASKS_FILE, &sys_opts);
     if (retval < 0)
         return -1;
 
@@ -31,6 +31,19 @@
 
 #define MAX_SW_TASKS            1024
 
+// Max outstanding acceleration requests for each sw-task client
+#define MAX_CLIENT_REQS         16
+
+// Output queue of each sw-task client, for the replies its socket cannot take yet.
+// Sizes must be powers of two, the buffer must hold the largest reply
+#define CLIENT_OUT_BUFF_SIZE    (32 * 1024)
+
+// Enough for a buffer of the shortest replies (a bare message)
+#define CLIENT_OUT_RECS         (CLIENT_OUT_BUFF_SIZE / 16)
+
+// Requests of a client are not read while its output queue is above this mark
+#define DEF_CLIENT_OUT_HIGH_WATER   (16 * 1024)
+
 //-------------------------------------------------------------------------------
 
 #define MAX_HW_TASKS            128
@@ -41,10 +54,17 @@
 
 //-------------------------------------------------------------------------------
 
+// Slots of a partition are tracked with 64 bit masks (at most 64)
 #define MAX_SLOTS               64
 
 #define MAX_PARTITIONS          32
 
+// Partition queues reordering: at most MAX_PART_QUEUE_LOOKAHEAD requests are scanned
+// for one that can reuse a freed slot, a request can be bypassed at most aging limit times
+#define MAX_PART_QUEUE_LOOKAHEAD    32
+
+#define DEF_PART_QUEUE_AGING_LIMIT  4
+
 //-------------------------------------------------------------------------------
 
 #define MAX_NAMES               128
@@ -55,12 +75,33 @@
 
 #define MAX_EVENTS_SRCS         (MAX_SLOTS * MAX_PARTITIONS + MAX_SW_TASKS + 1)
 
+// Epoll reactor, initial capacity of the handlers repository (doubled when full)
+// and events served for each wakeup
+#define REACTOR_INIT_SRCS       64
+
+#define REACTOR_EVENTS_BATCH    64
+
+// Epoll reactor, events of non hardware handlers served for each batch (after the
+// hardware ones), the others are served in the next batches in arrival order
+#define REACTOR_CLIENTS_BUDGET  16
+
+// Sharded mode, capacity of the queues between the arbiter and each partition
+// shard. Must be a power of two able to hold all outstanding requests
+#define SHARD_QUEUE_SIZE        (MAX_SW_TASKS * MAX_CLIENT_REQS)
+
 //-------------------------------------------------------------------------------
 
 #define DEF_HW_TASK_TIMEOUT_US  (10 * 1000 * 1000)
 
+// Completion busy waited after the start (spin=<us> in the hw-tasks file), for short
+// hw-tasks the interrupt path costs about as much as the computation
+#define MAX_HW_TASK_SPIN_US     1000
+
 #define SIG_HW_TASK_TIMEOUT     SIGRTMIN
 
+// Resolution of the hw-tasks watchdog timer wheel
+#define TIMER_WHEEL_TICK_US     1000
+
 //-------------------------------------------------------------------------------
 
 #ifndef LOG_GLOBAL_LEVEL
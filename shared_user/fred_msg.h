@@ -13,7 +13,9 @@
 #ifndef FRED_MSG_H_
 #define FRED_MSG_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 //-------------------------------------------------------------------------------
 
@@ -22,9 +24,17 @@ enum msg_head_ {
     FRED_MSG_INIT       = 101,
     FRED_MSG_BIND       = 201,
     FRED_MSG_RUN        = 301,
+    FRED_MSG_RUN_BATCH  = 302,  // Followed by the jobs (see below)
+    FRED_MSG_RUN_ARGS   = 303,  // Followed by the arguments (see below)
+    FRED_MSG_RUN_CHAIN  = 304,  // Followed by the stages (see below)
+    FRED_MSG_CANCEL     = 305,  // Drop a job, batch or chain not started yet
     // Server Replies
     FRED_MSG_DONE       = 401,
     FRED_MSG_OVERRUN    = 402,
+    FRED_MSG_EXPIRED    = 403,  // Deadline passed before the request started
+    FRED_MSG_BATCH_DONE = 404,  // Followed by the outcome of each job
+    FRED_MSG_CHAIN_DONE = 405,  // Followed by the outcome of each stage
+    FRED_MSG_CANCELLED  = 406,  // Dropped on FRED_MSG_CANCEL before starting
     FRED_MSG_ACK        = 501,
     FRED_MSG_BUFFS      = 601,
     FRED_MSG_ERROR      = 701,  // Client request error
@@ -32,11 +42,105 @@ enum msg_head_ {
     FRED_MSG_CRIT       = 801,  // Server internal error
 };
 
+// FRED_MSG_INIT options (arg field). The server replies with
+// FRED_MSG_ACK carrying in the arg field the options it granted
+enum msg_init_flags_ {
+    FRED_INIT_RING      = 1 << 0,   // Shared memory rings (see fred_ring.h)
+    FRED_INIT_BUFF_FDS  = 1 << 1,   // Data buffers passed as file descriptors
+};
+
+// FRED_MSG_BUFFS (reply to FRED_MSG_BIND) carries in the arg field the number of data
+// buffers of the hw-task, it is followed in the same write by a struct user_buff for
+// each buffer, holding its length and device path. With FRED_INIT_BUFF_FDS it is
+// followed instead by a uint64_t length for each buffer, and the buffers are passed
+// already open as SCM_RIGHTS ancillary data (same order), ready to be mapped.
+
+// Replies and notices carry the req_id of the request they refer to.
+// This allows a client to keep multiple acceleration requests in flight.
+// FRED_MSG_RUN may carry a deadline relative to its arrival (0 for none):
+// requests are served earliest deadline first, and a request still queued
+// when its deadline passes is answered with FRED_MSG_EXPIRED.
 struct fred_msg {
     enum msg_head_ head;
     uint32_t arg;
+    uint32_t req_id;
+    uint32_t deadline_us;
+};
+
+// FRED_MSG_CANCEL carries the req_id of an outstanding FRED_MSG_RUN (or RUN_ARGS),
+// or of a batch or a chain (all its jobs or stages). It gets no reply of its own:
+// each job is still answered once, with FRED_MSG_CANCELLED if it was dropped before
+// starting, as usual otherwise (the jobs already running are not interrupted).
+// Unknown ids are ignored. A batch or chain reply reports FRED_MSG_CANCELLED as the
+// outcome of the dropped jobs.
+
+// Max jobs in a batch (as the outstanding requests of a client)
+#define FRED_BATCH_MAX_JOBS     16
+
+// FRED_MSG_RUN_BATCH submits several jobs in one message. The arg field holds the
+// number of jobs and the completion threshold (0 for all the jobs), the message is
+// followed by the jobs in the same write. Each job runs one of the bound hw-tasks on
+// its data buffers. When threshold jobs have finished the server replies with one
+// FRED_MSG_BATCH_DONE, carrying the batch req_id and in the arg field the number of
+// finished jobs, followed by a uint32_t for each job: the head the job would have got
+// if submitted alone (FRED_MSG_DONE, OVERRUN, EXPIRED or ERROR), 0 if still running.
+// If some jobs were still running, a second FRED_MSG_BATCH_DONE follows when the
+// last one finishes.
+struct fred_batch_job {
+    uint32_t hw_task_id;
+    uint32_t deadline_us;
+};
+
+// Arguments registers on the hw-tasks control bus
+#define FRED_RUN_MAX_ARGS       8
+
+// FRED_MSG_RUN_ARGS is a FRED_MSG_RUN (same fields) choosing the value of each
+// argument register, instead of the base addresses of the bound data buffers. The
+// message is followed, in the same write, by the number of arguments (uint32_t) and
+// by the arguments. A buffer argument selects a window of one of the data buffers
+// of the hw-task (in FRED_MSG_BUFFS order): the register gets the physical address
+// at offset, the window must lie within the buffer. A window length to be known by
+// the hw-task must be passed as a scalar argument too.
+enum fred_arg_type {
+    FRED_ARG_SCALAR     = 1,
+    FRED_ARG_BUFF       = 2,
+    FRED_ARG_STAGE_BUFF = 3     // Chains only, see below
+};
+
+struct fred_arg {
+    uint32_t type;
+    uint32_t buff_idx;      // FRED_ARG_BUFF: data buffer index
+    uint64_t value;         // FRED_ARG_SCALAR: value, FRED_ARG_BUFF: offset
+    uint64_t length;        // FRED_ARG_BUFF: window length
+};
+
+#define FRED_CHAIN_MAX_STAGES   8
+
+// FRED_MSG_RUN_CHAIN runs a chain of hw-tasks, each stage starting when the previous
+// one has completed. The server may reserve and reconfigure the slot of a stage while
+// the previous one runs. The arg field holds the number of stages, the message is
+// followed by the stages in the same write. A stage with no arguments uses the base
+// addresses of its data buffers (as FRED_MSG_RUN). A FRED_ARG_STAGE_BUFF argument
+// selects a window of a data buffer of an earlier stage (buff_idx built with
+// FRED_ARG_STAGE_BUFF_IDX), typically its output. The server replies with a single
+// FRED_MSG_CHAIN_DONE when the chain is over, carrying the chain req_id and in the arg
+// field the number of stages completed, followed by a uint32_t for each stage: its
+// outcome head (as in a batch), 0 if the stage did not run. After a failed stage the
+// following ones do not run.
+struct fred_chain_stage {
+    uint32_t hw_task_id;
+    uint32_t deadline_us;   // Relative to the stage submission (when the previous starts)
+    uint32_t args_count;
+    uint32_t reserved;
+    struct fred_arg args[FRED_RUN_MAX_ARGS];
 };
 
+#define FRED_ARG_STAGE_BUFF_IDX(stage, buff)    (((uint32_t)(stage) << 16) | (buff))
+
+// Longest request: a message followed by its payload (a chain of the maximum length)
+#define FRED_MSG_MAX_REQ_LEN    (sizeof(struct fred_msg) + \
+                                    sizeof(struct fred_chain_stage) * FRED_CHAIN_MAX_STAGES)
+
 //-------------------------------------------------------------------------------
 
 static inline
@@ -48,7 +152,7 @@ int fred_msg_get_head(const struct fred_msg *msg)
 static inline
 void fred_msg_set_head(struct fred_msg *msg, int head)
 {
-    msg->head = head;
+    msg->head = (enum msg_head_)head;
 }
 
 static inline
@@ -63,6 +167,90 @@ void fred_msg_set_arg(struct fred_msg *msg, uint32_t arg)
     msg->arg = arg;
 }
 
+static inline
+uint32_t fred_msg_get_req_id(const struct fred_msg *msg)
+{
+    return msg->req_id;
+}
+
+static inline
+void fred_msg_set_req_id(struct fred_msg *msg, uint32_t req_id)
+{
+    msg->req_id = req_id;
+}
+
+static inline
+uint32_t fred_msg_get_deadline_us(const struct fred_msg *msg)
+{
+    return msg->deadline_us;
+}
+
+static inline
+void fred_msg_set_deadline_us(struct fred_msg *msg, uint32_t deadline_us)
+{
+    msg->deadline_us = deadline_us;
+}
+
+static inline
+uint32_t fred_msg_get_batch_jobs(const struct fred_msg *msg)
+{
+    return msg->arg & 0xffff;
+}
+
+static inline
+uint32_t fred_msg_get_batch_threshold(const struct fred_msg *msg)
+{
+    return msg->arg >> 16;
+}
+
+static inline
+void fred_msg_set_batch(struct fred_msg *msg, uint32_t jobs, uint32_t threshold)
+{
+    msg->arg = (threshold << 16) | (jobs & 0xffff);
+}
+
+// Framing: length of the request at the head of data, a message and its payload.
+// Returns 1 and the length, 0 if data holds only part of it, -1 if malformed
+static inline
+int fred_msg_get_req_len(const void *data, size_t data_len, size_t *req_len)
+{
+    const struct fred_msg *msg = (const struct fred_msg *)data;
+    uint32_t count;
+
+    if (data_len < sizeof(*msg))
+        return 0;
+
+    *req_len = sizeof(*msg);
+
+    switch (fred_msg_get_head(msg)) {
+    case FRED_MSG_RUN_BATCH:
+        if (fred_msg_get_batch_jobs(msg) > FRED_BATCH_MAX_JOBS)
+            return -1;
+        *req_len += sizeof(struct fred_batch_job) * fred_msg_get_batch_jobs(msg);
+        break;
+
+    case FRED_MSG_RUN_ARGS:
+        if (data_len < sizeof(*msg) + sizeof(count))
+            return 0;
+        memcpy(&count, (const char *)data + sizeof(*msg), sizeof(count));
+        if (count > FRED_RUN_MAX_ARGS)
+            return -1;
+        *req_len += sizeof(count) + sizeof(struct fred_arg) * count;
+        break;
+
+    case FRED_MSG_RUN_CHAIN:
+        if (fred_msg_get_arg(msg) > FRED_CHAIN_MAX_STAGES)
+            return -1;
+        *req_len += sizeof(struct fred_chain_stage) * fred_msg_get_arg(msg);
+        break;
+
+    default:
+        break;
+    }
+
+    return data_len >= *req_len;
+}
+
 //-------------------------------------------------------------------------------
 
 #endif /* FRED_MSG_H_ */
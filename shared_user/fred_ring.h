@@ -0,0 +1,85 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef FRED_RING_H_
+#define FRED_RING_H_
+
+#include <stdint.h>
+
+//-------------------------------------------------------------------------------
+//
+// Shared memory submission/completion rings (optional, see FRED_INIT_RING).
+// After the handshake the client receives three file descriptors:
+// the shared memory holding a struct fred_ring, the submission doorbell
+// eventfd, and the completion doorbell eventfd.
+//
+// Client: fill sqes[sq_tail & mask], release-store sq_tail, then write
+// the submission doorbell. Many submissions can share a single doorbell.
+// Server: post cqes[cq_tail & mask], release-store cq_tail, and write the
+// completion doorbell only if the client set FRED_RING_CQ_NEED_WAKEUP.
+// The server stops consuming submissions when the completion ring could
+// overflow. After reaping completions the client must ring the submission
+// doorbell again if submissions are still pending. Submissions beyond the
+// requests the server keeps for each client are left on the ring, the
+// server resumes consuming them by itself as the requests complete.
+// A ring whose indexes are set beyond its size is hung up.
+//
+//-------------------------------------------------------------------------------
+
+#define FRED_RING_SQ_ENTRIES        64
+#define FRED_RING_CQ_ENTRIES        64
+
+#define FRED_RING_SQ_MASK           (FRED_RING_SQ_ENTRIES - 1)
+#define FRED_RING_CQ_MASK           (FRED_RING_CQ_ENTRIES - 1)
+
+#define FRED_RING_CACHE_LINE        64
+
+// Flags
+#define FRED_RING_CQ_NEED_WAKEUP    (1U << 0)
+
+//-------------------------------------------------------------------------------
+
+struct fred_ring_sqe {
+    uint32_t hw_task_id;
+    uint32_t req_id;
+    uint32_t deadline_us;   // Relative deadline, 0 for none (see fred_msg.h)
+};
+
+struct fred_ring_cqe {
+    int32_t head;           // FRED_MSG_DONE, FRED_MSG_OVERRUN, FRED_MSG_EXPIRED,
+                            // FRED_MSG_CANCELLED or FRED_MSG_ERROR
+    uint32_t req_id;
+};
+
+// Indexes are free running, producer and consumer
+// indexes are kept on different cache lines
+struct fred_ring {
+    // Submission queue (client produces, server consumes)
+    uint32_t sq_tail __attribute__((aligned(FRED_RING_CACHE_LINE)));
+    uint32_t sq_head __attribute__((aligned(FRED_RING_CACHE_LINE)));
+
+    // Completion queue (server produces, client consumes)
+    uint32_t cq_tail __attribute__((aligned(FRED_RING_CACHE_LINE)));
+    uint32_t cq_head __attribute__((aligned(FRED_RING_CACHE_LINE)));
+
+    // Set by the client before waiting on the completion doorbell
+    uint32_t flags __attribute__((aligned(FRED_RING_CACHE_LINE)));
+
+    struct fred_ring_sqe sqes[FRED_RING_SQ_ENTRIES]
+                                __attribute__((aligned(FRED_RING_CACHE_LINE)));
+    struct fred_ring_cqe cqes[FRED_RING_CQ_ENTRIES]
+                                __attribute__((aligned(FRED_RING_CACHE_LINE)));
+};
+
+//-------------------------------------------------------------------------------
+
+#endif /* FRED_RING_H_ */
@@ -33,14 +33,37 @@ void user_buff_init(struct user_buff *buff)
     buff->length = 0;
 }
 
+void user_buff_init_fd(struct user_buff *buff, int file_d, size_t length)
+{
+    assert(buff);
+
+    buff->map_addr = NULL;
+    buff->file_d = file_d;
+    buff->length = length;
+    buff->dev_name[0] = '\0';
+}
+
+void user_buff_close(struct user_buff *buff)
+{
+    assert(buff);
+
+    if (!buff->dev_name[0] && buff->file_d >= 0) {
+        close(buff->file_d);
+        buff->file_d = -1;
+    }
+}
+
 void* user_buff_map(struct user_buff *buff)
 {
     assert(buff);
 
-    buff->file_d = open(buff->dev_name, O_RDWR);
-    if (buff->file_d < 1) {
-        DBG_PRINT("buff: unable to open fred buffer file descriptor: %s\n", buff->dev_name);
-        return NULL;
+    // Buffers passed by the server are already open
+    if (buff->dev_name[0]) {
+        buff->file_d = open(buff->dev_name, O_RDWR);
+        if (buff->file_d < 1) {
+            DBG_PRINT("buff: unable to open fred buffer file descriptor: %s\n", buff->dev_name);
+            return NULL;
+        }
     }
 
     if (buff->map_addr) {
@@ -75,7 +98,9 @@ void user_buff_unmap(struct user_buff *buff)
         return;
     }
 
-    close(buff->file_d);
+    // Buffers passed by the server stay open until closed
+    if (buff->dev_name[0])
+        close(buff->file_d);
 }
 
 size_t user_buff_get_size(const struct user_buff *buff)
@@ -29,6 +29,12 @@ struct user_buff {
 
 void user_buff_init(struct user_buff *buff);
 
+// Buffer passed already open by the server (no device name)
+void user_buff_init_fd(struct user_buff *buff, int file_d, size_t length);
+
+// Close a buffer passed by the server
+void user_buff_close(struct user_buff *buff);
+
 void *user_buff_map(struct user_buff *buff);
 
 void user_buff_unmap(struct user_buff *buff);
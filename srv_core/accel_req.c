@@ -27,7 +27,8 @@ const struct phy_bit *accel_req_get_phy_bit(const struct accel_req *self)
 }
 
 void accel_req_set_notifier(struct accel_req *self,
-                            int (*notify_action)(void *, enum notify_action_msg),
+                            int (*notify_action)(void *, struct accel_req *,
+                                                    enum notify_action_msg),
                             void *notifier)
 {
     assert(self);
@@ -20,6 +20,7 @@
 
 #include "../parameters.h"
 #include "../srv_core/phy_bit.h"
+#include "timer_wheel.h"
 
 //---------------------------------------------------------------------------------------------
 
@@ -30,13 +31,33 @@ struct hw_task;
 
 enum notify_action_msg {
     NOTIFY_ACTION_DONE,
-    NOTIFY_ACTION_OVERRUN
+    NOTIFY_ACTION_OVERRUN,
+    NOTIFY_ACTION_EXPIRED,          // Deadline passed while still queued
+    NOTIFY_ACTION_ABORTED,          // Previous stage of the chain failed
+    NOTIFY_ACTION_CANCELLED         // Cancelled by the client before starting
 };
 
 //---------------------------------------------------------------------------------------------
 
+struct accel_req;
+
+// Armed by the scheduler while the request is queued, on expiration the owner
+// (the scheduler holding the queue) drops the request
+struct req_deadline_timer {
+    // ------------------------//
+    struct wheel_timer wheel_timer; // Timer wheel entry
+    // ------------------------//
+
+    struct timer_wheel *wheel;
+    struct accel_req *request;
+    void *owner;
+};
+
 struct accel_req {
 
+    // Request id chosen by the client (echoed back on notification)
+    uint32_t req_id;
+
     // Hw-task parameters array
     uintptr_t args[HW_OP_ARGS_SIZE];
     int args_size;
@@ -48,12 +69,40 @@ struct accel_req {
     // Issuing time stamp
     struct timespec tstamp;
 
+    // Relative deadline chosen by the client (0 if none) and
+    // absolute deadline (CLOCK_MONOTONIC), set when time stamped
+    uint32_t rel_deadline_us;
+    uint64_t deadline_ns;
+    struct req_deadline_timer deadline_timer;
+
     // Optimization
     int skip_rcfg;
 
+    // FRI queue ordering key (lower first) and position in the heap
+    uint64_t heap_key;
+    int heap_idx;
+
+    // Times a later request has been preferred in the partition queue
+    int bypassed;
+
+    // Chain of hw-tasks. The next stage is handed to the scheduler when this one
+    // starts, its slot may be prepared meanwhile, but it starts only when this
+    // one completes. If this one overruns the next stage is aborted
+    struct accel_req *chain_next;
+    int chain_wait;                 // Previous stage not completed yet
+    int chain_parked;               // Slot ready, waiting for the previous stage
+    int chain_abort;                // Previous stage failed
+
+    // Cancelled by the client, dropped as soon as the scheduler gets hold of
+    // it again (if it is started meanwhile the execution is completed)
+    int cancelled;
+
+    // Measured execution time, set on completion
+    uint64_t exec_time_us;
+
     // Notify when the request has been executed
     // (whole acceleration process has been completed)
-    int (*notify_action)(void *self, enum notify_action_msg);
+    int (*notify_action)(void *self, struct accel_req *request, enum notify_action_msg);
     void *notifier;
 
     // List element (next and previous element pointers)
@@ -74,6 +123,28 @@ void accel_req_unbind(struct accel_req *self)
     self->hw_task = NULL;
     self->slot = NULL;
     self->skip_rcfg = 0;
+    self->rel_deadline_us = 0;
+    self->chain_next = NULL;
+    self->chain_wait = 0;
+    self->chain_parked = 0;
+    self->chain_abort = 0;
+    self->cancelled = 0;
+}
+
+static inline
+uint32_t accel_req_get_req_id(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->req_id;
+}
+
+static inline
+void accel_req_set_req_id(struct accel_req *self, uint32_t req_id)
+{
+    assert(self);
+
+    self->req_id = req_id;
 }
 
 static inline
@@ -174,12 +245,72 @@ void accel_req_set_hw_task(struct accel_req *self, struct hw_task *hw_task)
     self->hw_task = hw_task;
 }
 
+static inline
+struct accel_req *accel_req_get_chain_next(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->chain_next;
+}
+
+static inline
+void accel_req_set_chain_next(struct accel_req *self, struct accel_req *next)
+{
+    assert(self);
+    assert(next);
+
+    self->chain_next = next;
+    next->chain_wait = 1;
+}
+
+static inline
+int accel_req_get_chain_wait(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->chain_wait;
+}
+
+// The previous stage of the chain completed (or failed)
+static inline
+void accel_req_release_chain_wait(struct accel_req *self, int abort)
+{
+    assert(self);
+
+    self->chain_wait = 0;
+    self->chain_abort = abort;
+}
+
+static inline
+int accel_req_get_cancelled(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->cancelled;
+}
+
+static inline
+void accel_req_set_cancelled(struct accel_req *self)
+{
+    assert(self);
+
+    self->cancelled = 1;
+}
+
 static inline
 int accel_req_notify_action(struct accel_req *self, enum notify_action_msg msg)
 {
     assert(self);
 
-    return self->notify_action(self->notifier, msg);
+    return self->notify_action(self->notifier, self, msg);
+}
+
+static inline
+uint64_t accel_req_get_timestamp_ns(const struct accel_req *self)
+{
+    assert(self);
+
+    return (uint64_t)self->tstamp.tv_sec * 1000000000 + self->tstamp.tv_nsec;
 }
 
 static inline
@@ -188,6 +319,113 @@ void accel_req_stamp_timestamp(struct accel_req *self)
     assert(self);
 
     clock_gettime(CLOCK_MONOTONIC, &self->tstamp);
+
+    self->bypassed = 0;
+
+    if (self->rel_deadline_us)
+        self->deadline_ns = accel_req_get_timestamp_ns(self) +
+                            (uint64_t)self->rel_deadline_us * 1000;
+    else
+        self->deadline_ns = 0;
+}
+
+static inline
+void accel_req_set_rel_deadline_us(struct accel_req *self, uint32_t rel_deadline_us)
+{
+    assert(self);
+
+    self->rel_deadline_us = rel_deadline_us;
+}
+
+static inline
+uint64_t accel_req_get_deadline_ns(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->deadline_ns;
+}
+
+// Earliest deadline first key, requests without a deadline go last
+static inline
+uint64_t accel_req_get_edf_key(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->deadline_ns ? self->deadline_ns : UINT64_MAX;
+}
+
+static inline
+int accel_req_is_expired(const struct accel_req *self)
+{
+    struct timespec now;
+
+    assert(self);
+
+    // A chain stage cannot be dropped while the previous one is running
+    if (!self->deadline_ns || self->chain_wait)
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec >= self->deadline_ns;
+}
+
+// Drop the request when its deadline passes (it fires at once if already passed).
+// A chain stage waiting for the previous one cannot be dropped, it is armed later
+static inline
+int accel_req_arm_deadline(struct accel_req *self, struct timer_wheel *wheel,
+                            int (*expired)(struct wheel_timer *self), void *owner)
+{
+    struct timespec now;
+    uint64_t now_ns;
+    struct req_deadline_timer *timer;
+
+    assert(self);
+    assert(wheel);
+
+    timer = &self->deadline_timer;
+
+    if (!self->deadline_ns || self->chain_wait || wheel_timer_is_armed(&timer->wheel_timer))
+        return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    now_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    wheel_timer_init(&timer->wheel_timer, expired);
+    timer->wheel = wheel;
+    timer->request = self;
+    timer->owner = owner;
+
+    // Round up, never before the deadline
+    return timer_wheel_arm(wheel, &timer->wheel_timer,
+                            now_ns < self->deadline_ns ?
+                                (self->deadline_ns - now_ns + 999) / 1000 : 0);
+}
+
+// The request left the queues (or has been dropped)
+static inline
+void accel_req_disarm_deadline(struct accel_req *self)
+{
+    assert(self);
+
+    if (wheel_timer_is_armed(&self->deadline_timer.wheel_timer))
+        timer_wheel_disarm(self->deadline_timer.wheel, &self->deadline_timer.wheel_timer);
+}
+
+static inline
+uint64_t accel_req_get_exec_time_us(const struct accel_req *self)
+{
+    assert(self);
+
+    return self->exec_time_us;
+}
+
+static inline
+void accel_req_set_exec_time_us(struct accel_req *self, uint64_t exec_time_us)
+{
+    assert(self);
+
+    self->exec_time_us = exec_time_us;
 }
 
 static inline
@@ -219,7 +457,8 @@ int accel_req_compare_timestamps(const struct accel_req *self,
 const struct phy_bit *accel_req_get_phy_bit(const struct accel_req *self);
 
 void accel_req_set_notifier(struct accel_req *self,
-                            int (*notify_action)(void *, enum notify_action_msg),
+                            int (*notify_action)(void *, struct accel_req *,
+                                                    enum notify_action_msg),
                             void *notifier);
 
 //---------------------------------------------------------------------------------------------
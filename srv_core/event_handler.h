@@ -26,13 +26,20 @@
 // In case of error or disconnection request the reactor relies on the
 // free() method to (eventually) deallocate the event handler after deregistering
 
+// handle_output() is optional, called when the fd is writable if the handler asked
+// for output readiness (see reactor_set_interest()). Same return values
+
 //---------------------------------------------------------------------------------------------
 
 struct event_handler {
     int id;
 
+    // Where the reactor keeps the handler while registered, reactor private
+    unsigned int reactor_idx;
+
     int (*get_fd_handle)(const struct event_handler *self);
     int (*handle_event)(struct event_handler *self);
+    int (*handle_output)(struct event_handler *self);
 
     void (*get_name)(const struct event_handler *self, char *msg, int msg_size);
     void (*free)(struct event_handler *self);
@@ -74,6 +81,17 @@ int event_handler_handle_event(struct event_handler *self)
     return self->handle_event(self);
 }
 
+static inline
+int event_handler_handle_output(struct event_handler *self)
+{
+    assert(self);
+
+    if (!self->handle_output)
+        return 0;
+
+    return self->handle_output(self);
+}
+
 static inline
 void event_handler_get_name(const struct event_handler *self, char *msg, int msg_size)
 {
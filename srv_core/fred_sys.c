@@ -19,6 +19,7 @@
 #include "sw_tasks_listener.h"
 #include "devcfg.h"
 #include "scheduler_fred.h"
+#include "scheduler_fred_sharded.h"
 #include "../srv_core_mocks/scheduler_fred_rand.h"
 #include "signals_recv.h"
 #include "../srv_support/buffctl.h"
@@ -48,7 +49,7 @@ struct fred_sys {
     // Configuration for hw components
     struct sys_hw_config hw_config;
 
-    // Epoll event reactor
+    // Event reactor
     struct reactor *reactor;
 
     // System layout: partition, slots, and hw-tasks
@@ -67,7 +68,8 @@ struct fred_sys {
 //---------------------------------------------------------------------------------------------
 
 static
-int init_base_sys_(struct fred_sys *self, const char *arch_file, const char *hw_tasks_file)
+int init_base_sys_(struct fred_sys *self, const char *arch_file, const char *hw_tasks_file,
+                    enum reactor_type reactor_type)
 {
     int retval;
 
@@ -79,12 +81,14 @@ int init_base_sys_(struct fred_sys *self, const char *arch_file, const char *hw_
     }
 
     // Initialize event demultiplexer
-    retval = reactor_init(&self->reactor);
+    retval = reactor_init(&self->reactor, reactor_type);
     if (retval) {
         ERROR_PRINT("fred_sys: error while initializing event reactor\n");
         goto error_reactor;
     }
 
+    DBG_PRINT("fred_sys: using %s event reactor\n", reactor_type_get_name(reactor_type));
+
     // Open kernel module interface file
     retval = buffctl_open(&self->buffctl, NULL);
     if (retval) {
@@ -139,10 +143,13 @@ void free_base_sys_(struct fred_sys *self)
 
 //---------------------------------------------------------------------------------------------
 
-int init_normal_mode_(struct fred_sys *self, const char *arch_file, const char *hw_tasks_file)
+int init_normal_mode_(struct fred_sys *self, const char *arch_file, const char *hw_tasks_file,
+                    const struct fred_sys_opts *opts)
 {
     struct event_handler *sw_tasks_listener;
     struct event_handler *signals_receiver;
+    struct sched_fred_params sched_params;
+    struct sw_client_params client_params;
     int retval;
 
     DBG_PRINT("fred_sys: starting in normal mode\n");
@@ -158,7 +165,16 @@ int init_normal_mode_(struct fred_sys *self, const char *arch_file, const char *
     }
 
     // Initialize scheduler
-    retval = sched_fred_init(&self->scheduler, SCHED_FRED_NORMAL, self->devcfg);
+    sched_params.mode = opts->fast_skip ? SCHED_FRED_FAST_SKIP : SCHED_FRED_NORMAL;
+    sched_params.fri_order = opts->fri_order;
+    sched_params.prefetch = opts->prefetch && !opts->sharded;
+    sched_params.lookahead = opts->lookahead;
+    sched_params.aging_limit = opts->aging_limit;
+
+    if (opts->sharded)
+        retval = sched_fred_sharded_init(&self->scheduler, &sched_params, self->devcfg);
+    else
+        retval = sched_fred_init(&self->scheduler, &sched_params, self->devcfg);
     if (retval) {
         ERROR_PRINT("fred_sys: error while initializing scheduler\n");
         goto sched_init_error;
@@ -168,13 +184,20 @@ int init_normal_mode_(struct fred_sys *self, const char *arch_file, const char *
     devcfg_attach_scheduler(self->devcfg, self->scheduler);
 
     // Initialize base system
-    retval = init_base_sys_(self, arch_file, hw_tasks_file);
+    retval = init_base_sys_(self, arch_file, hw_tasks_file, opts->reactor_type);
     if (retval)
         goto base_sys_init_error;
 
+    sys_layout_set_slot_evict(self->layout, opts->slot_evict);
+
     // Create sw-task listener
+    client_params.seqpacket = opts->seqpacket;
+    client_params.out_high_water = opts->out_high_water;
+    client_params.drain_budget = opts->drain_budget;
+
     retval = sw_tasks_listener_init(&sw_tasks_listener, self->layout,
-                                    self->reactor, self->scheduler, self->buffctl);
+                                    self->reactor, self->scheduler, self->buffctl,
+                                    &client_params);
     if (retval) {
         ERROR_PRINT("fred_sys: error while initializing sw-task listener\n");
         goto sw_tasks_listener_init_error;
@@ -204,10 +227,16 @@ int init_normal_mode_(struct fred_sys *self, const char *arch_file, const char *
     }
 
     // Register all slots of all partitions to the reactor
-    retval = sys_layout_register_slots(self->layout, self->reactor);
-    if (retval) {
-        ERROR_PRINT("fred_sys: error while registering slots handler\n");
-        goto handlers_reg_error;
+    // (in sharded mode slots are served by the partitions shards)
+    if (!opts->sharded) {
+        retval = sys_layout_register_slots(self->layout, self->reactor);
+        if (retval) {
+            ERROR_PRINT("fred_sys: error while registering slots handler\n");
+            goto handlers_reg_error;
+        }
+
+        // Queued requests deadlines share the slots timer wheel
+        sched_fred_attach_timer_wheel(self->scheduler, self->layout->timer_wheel);
     }
 
     // Register sw-task listener
@@ -218,6 +247,16 @@ int init_normal_mode_(struct fred_sys *self, const char *arch_file, const char *
         goto handlers_reg_error;
     }
 
+    // Start the shards threads last, the error chain cannot stop them
+    if (opts->sharded) {
+        retval = sched_fred_sharded_start(self->scheduler, self->layout, self->reactor,
+                                            opts->reactor_type);
+        if (retval) {
+            ERROR_PRINT("fred_sys: error while starting partitions shards\n");
+            goto sw_tasks_listener_init_error;
+        }
+    }
+
     retval = 0;
     goto out;
 
@@ -240,7 +279,8 @@ out:
 //---------------------------------------------------------------------------------------------
 
 int init_rcfg_test_mode_(struct fred_sys *self, const char *arch_file,
-                            const char *hw_tasks_file)
+                            const char *hw_tasks_file,
+                    const struct fred_sys_opts *opts)
 {
     struct event_handler *cyclic_client;
     struct event_handler *signals_receiver;
@@ -269,7 +309,7 @@ int init_rcfg_test_mode_(struct fred_sys *self, const char *arch_file,
     devcfg_attach_scheduler(self->devcfg, self->scheduler);
 
     // Initialize base system
-    retval = init_base_sys_(self, arch_file, hw_tasks_file);
+    retval = init_base_sys_(self, arch_file, hw_tasks_file, opts->reactor_type);
     if (retval)
         goto base_sys_init_error;
 
@@ -341,7 +381,8 @@ out:
 //---------------------------------------------------------------------------------------------
 
 int init_hw_tasks_test_mode_(struct fred_sys *self, const char *arch_file,
-                                const char *hw_tasks_file)
+                                const char *hw_tasks_file,
+                    const struct fred_sys_opts *opts)
 {
     struct event_handler *cyclic_client;
     struct event_handler *signals_receiver;
@@ -370,7 +411,7 @@ int init_hw_tasks_test_mode_(struct fred_sys *self, const char *arch_file,
     devcfg_attach_scheduler(self->devcfg, self->scheduler);
 
     // Initialize base system
-    retval = init_base_sys_(self, arch_file, hw_tasks_file);
+    retval = init_base_sys_(self, arch_file, hw_tasks_file, opts->reactor_type);
     if (retval)
         goto base_sys_init_error;
 
@@ -442,7 +483,7 @@ out:
 //---------------------------------------------------------------------------------------------
 
 int fred_sys_init(struct fred_sys **self, const char *arch_file,
-                  const char *hw_tasks_file, enum fred_sys_mode mode)
+                  const char *hw_tasks_file, const struct fred_sys_opts *opts)
 {
     int retval;
 
@@ -454,16 +495,22 @@ int fred_sys_init(struct fred_sys **self, const char *arch_file,
 
     DBG_PRINT(fred_logo);
 
-    switch (mode) {
+    if (opts->sharded && opts->mode != FRED_SYS_NORMAL_MODE)
+        DBG_PRINT("fred_sys: sharded mode ignored in test modes\n");
+
+    if (opts->sharded && opts->prefetch)
+        DBG_PRINT("fred_sys: speculative reconfiguration not supported in sharded mode\n");
+
+    switch (opts->mode) {
         case FRED_SYS_RCFG_TEST_MODE:
-            retval = init_rcfg_test_mode_(*self, arch_file, hw_tasks_file);
+            retval = init_rcfg_test_mode_(*self, arch_file, hw_tasks_file, opts);
             break;
         case FRED_SYS_HW_TASKS_TEST_MODE:
-            retval = init_hw_tasks_test_mode_(*self, arch_file, hw_tasks_file);
+            retval = init_hw_tasks_test_mode_(*self, arch_file, hw_tasks_file, opts);
             break;
         case FRED_SYS_NORMAL_MODE:
         default:
-            retval = init_normal_mode_(*self, arch_file, hw_tasks_file);
+            retval = init_normal_mode_(*self, arch_file, hw_tasks_file, opts);
             break;
     }
 
@@ -482,14 +529,15 @@ void fred_sys_free(struct fred_sys *self)
 
     DBG_PRINT("fred_sys: shutting down\n");
 
+    // Stop the scheduler first, shards threads may still reference clients requests
+    if (self->scheduler)
+        scheduler_free(self->scheduler);
+
     // Will release all registered clients using the
     // free method of the handler
     if (self->reactor)
         reactor_free(self->reactor);
 
-    if (self->scheduler)
-        scheduler_free(self->scheduler);
-
     if (self->layout)
         sys_layout_free(self->layout);
 
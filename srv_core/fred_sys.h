@@ -13,6 +13,9 @@
 #ifndef FRED_SYS_H_
 #define FRED_SYS_H_
 
+#include "reactor.h"
+#include "fri_queue.h"
+#include "partition.h"
 
 //---------------------------------------------------------------------------------------------
 
@@ -24,10 +27,25 @@ enum fred_sys_mode {
     FRED_SYS_HW_TASKS_TEST_MODE     // Hw-tasks execution cyclic test
 };
 
+struct fred_sys_opts {
+    enum fred_sys_mode mode;
+    enum reactor_type reactor_type;     // Event demultiplexing backend
+    int sharded;                        // One event loop thread per partition
+    enum fri_order fri_order;           // Reconfiguration queue ordering
+    enum slot_evict slot_evict;         // Choice of the slot to reconfigure
+    int prefetch;                       // Speculative reconfiguration of idle slots
+    int fast_skip;                      // Requests without rcfg bypass the FRI queue
+    int lookahead;                      // Partition queue look-ahead window (0 off)
+    int aging_limit;                    // Max bypasses of a partition queue request
+    int seqpacket;                      // Clients connect with sequenced packets sockets
+    size_t out_high_water;              // Client output queue length throttling its requests
+    int drain_budget;                   // Client requests read for each event (0 level)
+};
+
 //---------------------------------------------------------------------------------------------
 
 int fred_sys_init(struct fred_sys **self, const char *arch_file,
-                  const char *hw_tasks_file, enum fred_sys_mode mode);
+                  const char *hw_tasks_file, const struct fred_sys_opts *opts);
 
 void fred_sys_free(struct fred_sys *self);
 
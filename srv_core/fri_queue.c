@@ -0,0 +1,120 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include "fri_queue.h"
+#include "hw_task.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Initial capacity, the heap grows on demand
+#define FRI_QUEUE_INIT_SIZE     64
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+uint64_t fifo_key_(const struct accel_req *request)
+{
+    return accel_req_get_timestamp_ns(request);
+}
+
+static inline
+uint64_t shortest_bit_key_(const struct accel_req *request)
+{
+    // Nothing to be transferred if the slot already holds the hw-task
+    if (accel_req_get_skip_rcfg(request))
+        return 0;
+
+    return phy_bit_get_size(accel_req_get_phy_bit(request));
+}
+
+// Without an explicit deadline, a request is due when its hw-task timeout
+// elapses from arrival. The laxity is the deadline minus the remaining work
+// (reconfiguration and execution) and, since all laxities shrink at the same
+// rate, the order established at insertion holds while the request is queued.
+static inline
+uint64_t least_laxity_key_(const struct accel_req *request)
+{
+    const struct hw_task *hw_task;
+    uint64_t deadline_ns;
+    uint64_t work_ns;
+
+    hw_task = accel_req_get_hw_task(request);
+
+    deadline_ns = accel_req_get_deadline_ns(request);
+    if (!deadline_ns)
+        deadline_ns = accel_req_get_timestamp_ns(request) +
+                        hw_task_get_timeout_us(hw_task) * 1000;
+
+    work_ns = hw_task_get_exec_est_us(hw_task) * 1000;
+    if (!accel_req_get_skip_rcfg(request))
+        work_ns += hw_task_get_rcfg_est_us(hw_task) * 1000;
+
+    return deadline_ns > work_ns ? deadline_ns - work_ns : 0;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int fri_queue_push(struct fri_queue *self, struct accel_req *request)
+{
+    assert(self);
+    assert(request);
+
+    switch (self->order) {
+        case FRI_ORDER_SHORTEST_BIT:
+            request->heap_key = shortest_bit_key_(request);
+            break;
+        case FRI_ORDER_LEAST_LAXITY:
+            request->heap_key = least_laxity_key_(request);
+            break;
+        case FRI_ORDER_EDF:
+            request->heap_key = accel_req_get_edf_key(request);
+            break;
+        case FRI_ORDER_FIFO:
+        default:
+            request->heap_key = fifo_key_(request);
+            break;
+    }
+
+    return req_heap_push(&self->heap, request);
+}
+
+const char *fri_order_get_name(enum fri_order order)
+{
+    switch (order) {
+        case FRI_ORDER_SHORTEST_BIT:
+            return "shortest bitstream first";
+        case FRI_ORDER_LEAST_LAXITY:
+            return "least laxity first";
+        case FRI_ORDER_EDF:
+            return "earliest deadline first";
+        case FRI_ORDER_FIFO:
+        default:
+            return "fifo";
+    }
+}
+
+int fri_queue_init(struct fri_queue *self, enum fri_order order)
+{
+    assert(self);
+
+    self->order = order;
+
+    return req_heap_init(&self->heap, FRI_QUEUE_INIT_SIZE);
+}
+
+void fri_queue_free(struct fri_queue *self)
+{
+    if (!self)
+        return;
+
+    req_heap_free(&self->heap);
+}
@@ -0,0 +1,98 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef FRI_QUEUE_H_
+#define FRI_QUEUE_H_
+
+#include <assert.h>
+
+#include "accel_req.h"
+#include "req_heap.h"
+
+//---------------------------------------------------------------------------------------------
+
+enum fri_order {
+    FRI_ORDER_EDF,                  // Earliest deadline first, then arrival time
+    FRI_ORDER_FIFO,                 // Arrival time (original FRED)
+    FRI_ORDER_SHORTEST_BIT,         // Shortest bitstream first
+    FRI_ORDER_LEAST_LAXITY          // Least laxity first
+};
+
+// FPGA reconfiguration interface queue. The ordering key is computed once
+// when the request is inserted, so the order cannot change while queued.
+struct fri_queue {
+    struct req_heap heap;
+    enum fri_order order;
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int fri_queue_is_empty(const struct fri_queue *self)
+{
+    assert(self);
+
+    return req_heap_is_empty(&self->heap);
+}
+
+static inline
+struct accel_req *fri_queue_peek(const struct fri_queue *self)
+{
+    assert(self);
+
+    return req_heap_peek(&self->heap);
+}
+
+static inline
+struct accel_req *fri_queue_pop(struct fri_queue *self)
+{
+    assert(self);
+
+    return req_heap_pop(&self->heap);
+}
+
+static inline
+void fri_queue_remove(struct fri_queue *self, struct accel_req *request)
+{
+    assert(self);
+
+    req_heap_remove(&self->heap, request);
+}
+
+// The queue holds at most a request for each slot, a scan does not rely on the
+// position kept by the request (which a shard thread may be writing meanwhile)
+static inline
+int fri_queue_contains(const struct fri_queue *self, const struct accel_req *request)
+{
+    assert(self);
+
+    for (int i = 0; i < self->heap.count; ++i) {
+        if (self->heap.reqs[i] == request)
+            return 1;
+    }
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int fri_queue_init(struct fri_queue *self, enum fri_order order);
+
+void fri_queue_free(struct fri_queue *self);
+
+int fri_queue_push(struct fri_queue *self, struct accel_req *request);
+
+const char *fri_order_get_name(enum fri_order order);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* FRI_QUEUE_H_ */
@@ -24,6 +24,22 @@
 
 //---------------------------------------------------------------------------------------------
 
+// Weight of the new sample in the times moving averages (1/8)
+#define HW_TASK_EST_SHIFT   3
+
+// Successors tracked for each hw-task (prefetcher)
+#define HW_TASK_SUCC_WAYS   4
+
+//---------------------------------------------------------------------------------------------
+
+struct hw_task;
+
+// Hw-task requested next on the same partition and its (approximate) frequency
+struct hw_task_succ {
+    struct hw_task *hw_task;
+    uint32_t count;
+};
+
 struct hw_task {
     // Software ID should match the module ID
     // exported by the hardware module
@@ -44,6 +60,19 @@ struct hw_task {
     // Hardware timeout
     uint64_t timeout_us;
     int banned;
+
+    // Completion busy waited up to this, then signalled by the interrupt (0 only)
+    uint64_t spin_us;
+
+    // Idle slots of its partition already configured with this hw-task
+    uint64_t resident_mask;
+
+    // Moving averages of the measured times (0 until the first sample)
+    uint64_t exec_est_us;
+    uint64_t rcfg_est_us;
+
+    // Most frequent successors, used only by the prefetcher
+    struct hw_task_succ succ[HW_TASK_SUCC_WAYS];
 };
 
 // [1]  - The size maybe less than the buffer size due to proprietary bitstreams mangling
@@ -117,6 +146,22 @@ void hw_task_set_timeout_us(struct hw_task *self, uint64_t timeout_us)
     self->timeout_us = timeout_us;
 }
 
+static inline
+uint64_t hw_task_get_spin_us(const struct hw_task *self)
+{
+    assert(self);
+
+    return self->spin_us;
+}
+
+static inline
+void hw_task_set_spin_us(struct hw_task *self, uint64_t spin_us)
+{
+    assert(self);
+
+    self->spin_us = spin_us;
+}
+
 static inline
 void hw_task_set_banned(struct hw_task *self)
 {
@@ -133,6 +178,93 @@ int hw_task_get_banned(const struct hw_task *self)
     return self->banned;
 }
 
+static inline
+uint64_t hw_task_get_resident_mask(const struct hw_task *self)
+{
+    assert(self);
+
+    return self->resident_mask;
+}
+
+static inline
+void hw_task_set_resident(struct hw_task *self, int slot_idx)
+{
+    assert(self);
+
+    self->resident_mask |= UINT64_C(1) << slot_idx;
+}
+
+static inline
+void hw_task_clear_resident(struct hw_task *self, int slot_idx)
+{
+    assert(self);
+
+    self->resident_mask &= ~(UINT64_C(1) << slot_idx);
+}
+
+static inline
+uint64_t hw_task_update_est_(uint64_t est_us, uint64_t sample_us)
+{
+    if (!est_us)
+        return sample_us;
+
+    // Exponential moving average with weight 1 / 2^HW_TASK_EST_SHIFT
+    return est_us - (est_us >> HW_TASK_EST_SHIFT) + (sample_us >> HW_TASK_EST_SHIFT);
+}
+
+static inline
+uint64_t hw_task_get_exec_est_us(const struct hw_task *self)
+{
+    assert(self);
+
+    return self->exec_est_us;
+}
+
+static inline
+void hw_task_update_exec_est(struct hw_task *self, uint64_t exec_time_us)
+{
+    assert(self);
+
+    self->exec_est_us = hw_task_update_est_(self->exec_est_us, exec_time_us);
+}
+
+// In sharded mode the shards read the rcfg estimate as reload cost
+// while the arbiter updates it
+static inline
+uint64_t hw_task_get_rcfg_est_us(const struct hw_task *self)
+{
+    assert(self);
+
+    return __atomic_load_n(&self->rcfg_est_us, __ATOMIC_RELAXED);
+}
+
+static inline
+void hw_task_update_rcfg_est(struct hw_task *self, uint64_t rcfg_time_us)
+{
+    assert(self);
+
+    // Only the arbiter (or the single loop) writes it
+    __atomic_store_n(&self->rcfg_est_us,
+                        hw_task_update_est_(self->rcfg_est_us, rcfg_time_us),
+                        __ATOMIC_RELAXED);
+}
+
+// Estimated time to configure the hw-task in a slot. Until the first
+// reconfiguration is measured the bitstream size in KiB is used instead
+static inline
+uint64_t hw_task_get_reload_cost(const struct hw_task *self, int slot_idx)
+{
+    uint64_t rcfg_est_us;
+
+    assert(self);
+
+    rcfg_est_us = hw_task_get_rcfg_est_us(self);
+    if (rcfg_est_us)
+        return rcfg_est_us;
+
+    return phy_bit_get_size(&self->bits_phys[slot_idx]) >> 10;
+}
+
 //---------------------------------------------------------------------------------------------
 
 int hw_task_init(struct hw_task **self, uint32_t hw_id, const char *name,
@@ -0,0 +1,243 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "out_queue.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define SEND_FLAGS_     (MSG_DONTWAIT | MSG_NOSIGNAL)
+
+static inline
+size_t iov_len_(const struct iovec *iov, int iovcnt)
+{
+    size_t len = 0;
+
+    for (int i = 0; i < iovcnt; ++i)
+        len += iov[i].iov_len;
+
+    return len;
+}
+
+static inline
+struct out_queue_rec *get_rec_(const struct out_queue *self, unsigned int idx)
+{
+    return &self->recs[idx & (self->recs_size - 1)];
+}
+
+static inline
+int *get_fd_(struct out_queue *self, unsigned int idx)
+{
+    return &self->fds[idx % OUT_QUEUE_MAX_FDS];
+}
+
+static
+void close_fds_(struct out_queue *self, int fds_count)
+{
+    for (int i = 0; i < fds_count; ++i)
+        close(*get_fd_(self, self->fds_head++));
+}
+
+// Append the iov content, except its first skip bytes, to the ring
+static
+void copy_in_(struct out_queue *self, const struct iovec *iov, int iovcnt, size_t skip)
+{
+    const char *src;
+    size_t len;
+    size_t pos;
+    size_t chunk;
+
+    for (int i = 0; i < iovcnt; ++i) {
+        if (skip >= iov[i].iov_len) {
+            skip -= iov[i].iov_len;
+            continue;
+        }
+
+        src = (const char *)iov[i].iov_base + skip;
+        len = iov[i].iov_len - skip;
+        skip = 0;
+
+        while (len) {
+            pos = self->tail & (self->size - 1);
+            chunk = len < self->size - pos ? len : self->size - pos;
+            memcpy(self->buff + pos, src, chunk);
+
+            self->tail += chunk;
+            src += chunk;
+            len -= chunk;
+        }
+    }
+}
+
+static
+int push_(struct out_queue *self, const struct iovec *iov, int iovcnt, size_t skip,
+            size_t len, const int *fds, int fds_count)
+{
+    int fd;
+    struct out_queue_rec *rec;
+
+    // All or nothing
+    if (len > self->size - out_queue_get_len(self) ||
+        self->recs_tail - self->recs_head == self->recs_size ||
+        fds_count > OUT_QUEUE_MAX_FDS - (int)(self->fds_tail - self->fds_head))
+        return 1;
+
+    // The caller keeps its own fds
+    for (int i = 0; i < fds_count; ++i) {
+        fd = fcntl(fds[i], F_DUPFD_CLOEXEC, 0);
+        if (fd < 0) {
+            while (i--)
+                close(*get_fd_(self, --self->fds_tail));
+            return -1;
+        }
+        *get_fd_(self, self->fds_tail++) = fd;
+    }
+
+    copy_in_(self, iov, iovcnt, skip);
+
+    // On a stream only the records carrying fds must start on their own
+    if (!self->packets && !fds_count && self->recs_tail != self->recs_head) {
+        get_rec_(self, self->recs_tail - 1)->end = self->tail;
+        return 0;
+    }
+
+    rec = get_rec_(self, self->recs_tail++);
+    rec->end = self->tail;
+    rec->fds_count = fds_count;
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int out_queue_init(struct out_queue *self, size_t size, unsigned int recs_size, int packets)
+{
+    assert(self);
+    assert(size && !(size & (size - 1)));
+    assert(recs_size && !(recs_size & (recs_size - 1)));
+
+    memset(self, 0, sizeof(*self));
+
+    self->buff = malloc(size);
+    if (!self->buff)
+        return -1;
+
+    self->recs = calloc(recs_size, sizeof(*self->recs));
+    if (!self->recs) {
+        free(self->buff);
+        self->buff = NULL;
+        return -1;
+    }
+
+    self->size = size;
+    self->recs_size = recs_size;
+    self->packets = packets;
+
+    return 0;
+}
+
+void out_queue_free(struct out_queue *self)
+{
+    assert(self);
+
+    close_fds_(self, self->fds_tail - self->fds_head);
+
+    free(self->recs);
+    free(self->buff);
+    self->recs = NULL;
+    self->buff = NULL;
+}
+
+int out_queue_send(struct out_queue *self, int sock, const struct iovec *iov, int iovcnt,
+                    const int *fds, int fds_count)
+{
+    ssize_t retval;
+    size_t len;
+    size_t sent = 0;
+
+    assert(self);
+    assert(iov);
+
+    len = iov_len_(iov, iovcnt);
+
+    // Nothing ahead, try to send straight away
+    if (out_queue_is_empty(self)) {
+        retval = fd_utils_sendv_fds(sock, iov, iovcnt, fds, fds_count, SEND_FLAGS_);
+        if (retval < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            return -1;
+
+        if (retval == (ssize_t)len)
+            return 0;
+
+        // The fds have gone with the first byte
+        if (retval > 0) {
+            sent = retval;
+            fds_count = 0;
+        }
+    }
+
+    return push_(self, iov, iovcnt, sent, len - sent, fds, fds_count);
+}
+
+int out_queue_flush(struct out_queue *self, int sock)
+{
+    ssize_t retval;
+    uint64_t end;
+    size_t pos;
+    size_t len;
+    int fds[OUT_QUEUE_MAX_FDS];
+    struct iovec iov[2];
+    struct out_queue_rec *rec;
+
+    assert(self);
+
+    while (!out_queue_is_empty(self)) {
+        rec = get_rec_(self, self->recs_head);
+
+        // One record for each send, on a stream a new record starts only where
+        // fds are passed (the fds go with the first byte of their record)
+        end = rec->end;
+
+        // The bytes may wrap around the ring
+        pos = self->head & (self->size - 1);
+        len = end - self->head;
+        iov[0].iov_base = self->buff + pos;
+        iov[0].iov_len = len < self->size - pos ? len : self->size - pos;
+        iov[1].iov_base = self->buff;
+        iov[1].iov_len = len - iov[0].iov_len;
+
+        for (int i = 0; i < rec->fds_count; ++i)
+            fds[i] = *get_fd_(self, self->fds_head + i);
+
+        retval = fd_utils_sendv_fds(sock, iov, iov[1].iov_len ? 2 : 1,
+                                    fds, rec->fds_count, SEND_FLAGS_);
+        if (retval < 0)
+            return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+
+        // The client has its own references now
+        close_fds_(self, rec->fds_count);
+        rec->fds_count = 0;
+
+        self->head += retval;
+        while (self->recs_head != self->recs_tail &&
+                get_rec_(self, self->recs_head)->end <= self->head)
+            self->recs_head++;
+    }
+
+    return 0;
+}
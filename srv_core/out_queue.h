@@ -0,0 +1,90 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef OUT_QUEUE_H_
+#define OUT_QUEUE_H_
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include "../utils/fd_utils.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Records (messages) a non-blocking socket could not take, flushed in order when it
+// becomes writable. Bytes are kept in a ring, records boundaries are kept aside for
+// the file descriptors passed with a record and for sequenced packets sockets, where
+// each record must be sent alone. Queued fds are duplicates owned by the queue.
+
+#define OUT_QUEUE_MAX_FDS       (FD_UTILS_MAX_FDS * 2)
+
+struct out_queue_rec {
+    uint64_t end;               // Stream offset past the record
+    int fds_count;              // Not yet sent
+};
+
+struct out_queue {
+    char *buff;
+    size_t size;                // Power of two
+    uint64_t head;              // Stream offsets
+    uint64_t tail;
+
+    struct out_queue_rec *recs;
+    unsigned int recs_size;     // Power of two
+    unsigned int recs_head;
+    unsigned int recs_tail;
+
+    int fds[OUT_QUEUE_MAX_FDS];
+    unsigned int fds_head;
+    unsigned int fds_tail;
+
+    int packets;                // One record for each send
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int out_queue_is_empty(const struct out_queue *self)
+{
+    assert(self);
+
+    return self->head == self->tail;
+}
+
+static inline
+size_t out_queue_get_len(const struct out_queue *self)
+{
+    assert(self);
+
+    return self->tail - self->head;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int out_queue_init(struct out_queue *self, size_t size, unsigned int recs_size, int packets);
+
+// Also closes the queued fds
+void out_queue_free(struct out_queue *self);
+
+// Send a record, or queue what the socket cannot take now (always, behind queued records).
+// Returns 0 on success, 1 if the queue is full, -1 on error
+int out_queue_send(struct out_queue *self, int sock, const struct iovec *iov, int iovcnt,
+                    const int *fds, int fds_count);
+
+// Send as much as the socket takes. Returns 0 on success, -1 on socket error
+int out_queue_flush(struct out_queue *self, int sock);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* OUT_QUEUE_H_ */
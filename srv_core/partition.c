@@ -14,9 +14,55 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <inttypes.h>
 
 #include "partition.h"
+#include "hw_task.h"
 #include "slot.h"
+#include "../utils/dbg_print.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Pick the idle slot to be reconfigured according to the eviction policy
+static
+int select_victim_(struct partition *self)
+{
+    uint64_t mask;
+    uint64_t key;
+    uint64_t best_key = UINT64_MAX;
+    int best_idx = -1;
+    int idx;
+
+    for (mask = self->avail_mask; mask; mask &= mask - 1) {
+        idx = __builtin_ctzll(mask);
+
+        switch (self->evict) {
+            case SLOT_EVICT_LFU:
+                key = self->use_count[idx];
+                break;
+            case SLOT_EVICT_COST:
+                key = self->credit[idx];
+                break;
+            case SLOT_EVICT_LRU:
+            default:
+                key = self->last_use[idx];
+                break;
+        }
+
+        // Ties go to the least recently used
+        if (best_idx < 0 || key < best_key || (key == best_key &&
+            self->last_use[idx] < self->last_use[best_idx])) {
+            best_key = key;
+            best_idx = idx;
+        }
+    }
+
+    // Age the credits of the slots that stay resident
+    if (self->evict == SLOT_EVICT_COST)
+        self->credit_floor = self->credit[best_idx];
+
+    return best_idx;
+}
 
 //---------------------------------------------------------------------------------------------
 
@@ -29,77 +75,96 @@ int partition_add_slot(struct partition *self, struct slot *slot, struct slot_ti
     if (self->slots_count >= MAX_SLOTS - 1)
         return -1;
 
+    // Slot bits in the masks are given by the slot index
+    assert(slot_get_index(slot) == self->slots_count);
+
     // Attach the slot and the timer
     self->slots[self->slots_count] = slot;
     self->timers[self->slots_count] = timer;
     self->slots_count++;
 
+    slot_attach_partition(slot, self);
+    if (slot_is_blank(slot))
+        partition_set_slot_blank(self, slot_get_index(slot));
+    else if (slot_is_available(slot))
+        partition_set_slot_avail(self, slot_get_index(slot));
+
     return 0;
 }
 
 int partition_search_slot(struct partition *self, struct slot **slot,
                             struct slot_timer **timer, const struct hw_task *hw_task)
 {
-    int slot_idx = -1;
+    uint64_t resident_mask;
+    int slot_idx;
     int rcfg = 1;
 
     assert(self);
     assert(hw_task);
 
-    // For all slots in the partition
-    for (int i = 0; i < self->slots_count; ++i) {
-        // If the slot is free
-        if (slot_is_available(self->slots[i])) {
-            slot_idx = i;
-            // And already contain the requested hw-task
-            if (slot_match_hw_task(self->slots[i], hw_task)) {
-                rcfg = 0;
-                break;
-            }
-        }
-    }
-
     // No slot found
-    if (slot_idx < 0) {
+    if (!self->avail_mask) {
         *slot = NULL;
         *timer = NULL;
-    // If slot found
+        return rcfg;
+    }
+
+    // Idle slots holding the hw-task are always available
+    resident_mask = hw_task_get_resident_mask(hw_task);
+    assert(!(resident_mask & ~self->avail_mask));
+
+    // If a free slot already contains the requested hw-task
+    if (resident_mask) {
+        slot_idx = __builtin_ctzll(resident_mask);
+        rcfg = 0;
+
+    // Otherwise the last free slot (original policy)
+    } else if (self->evict == SLOT_EVICT_LAST) {
+        slot_idx = 63 - __builtin_clzll(self->avail_mask);
+        if (!(self->blank_mask & (UINT64_C(1) << slot_idx)))
+            self->stats.evictions++;
+
+    // Or a blank slot, no hw-task has to be evicted
+    } else if (self->blank_mask) {
+        slot_idx = __builtin_ctzll(self->blank_mask);
+
     } else {
-        *slot = self->slots[slot_idx];
-        *timer = self->timers[slot_idx];
+        slot_idx = select_victim_(self);
+        self->stats.evictions++;
     }
 
+    *slot = self->slots[slot_idx];
+    *timer = self->timers[slot_idx];
+
     return rcfg;
 }
 
 int partition_search_random_slot(struct partition *self, struct slot **slot,
                                     struct slot_timer **timer, const struct hw_task *hw_task)
 {
-    int free_slots_idx[MAX_SLOTS];
-    int free_slots_count = 0;
+    uint64_t avail_mask;
     int slot_idx;
     int rcfg = 1;
 
     assert(self);
     assert(hw_task);
 
-    // Collect all free slots in the partition
-    for (int i = 0; i < self->slots_count; ++i) {
-        // If the slot is free
-        if (slot_is_available(self->slots[i]))
-            free_slots_idx[free_slots_count++] = i;
-    }
+    avail_mask = self->avail_mask;
 
     // No slot found
-    if (free_slots_count == 0) {
+    if (!avail_mask) {
         *slot = NULL;
         *timer = NULL;
     // If one or more slots has been found, pick a random slot
     } else {
-        slot_idx = free_slots_idx[rand() % free_slots_count];
+        // Drop the lowest set bits to select a random free slot
+        for (int n = rand() % __builtin_popcountll(avail_mask); n > 0; --n)
+            avail_mask &= avail_mask - 1;
+
+        slot_idx = __builtin_ctzll(avail_mask);
         *slot = self->slots[slot_idx];
         *timer = self->timers[slot_idx];
-        if (slot_match_hw_task(self->slots[slot_idx], hw_task))
+        if (hw_task_get_resident_mask(hw_task) & (UINT64_C(1) << slot_idx))
             rcfg = 0;
     }
 
@@ -113,17 +178,13 @@ int partiton_register_slots(struct partition *self, struct reactor *reactor)
     assert(self);
     assert(reactor);
 
-    // Register all slots and timers
+    // Register all slots (timers are served by the timer wheel)
     for (int i = 0; i < self->slots_count; ++i) {
-        retval = reactor_add_event_handler( reactor,
-                                            slot_get_event_handler(self->slots[i]),
-                                            REACT_NORMAL_HANDLER, REACT_NOT_OWNED);
-        if (retval)
-            return -1;
+        slot_attach_reactor(self->slots[i], reactor);
 
         retval = reactor_add_event_handler( reactor,
-                                            slot_timer_get_event_handler(self->timers[i]),
-                                            REACT_NORMAL_HANDLER, REACT_NOT_OWNED);
+                                            slot_get_event_handler(self->slots[i]),
+                                            REACT_HW_HANDLER, REACT_NOT_OWNED);
         if (retval)
             return -1;
     }
@@ -131,6 +192,26 @@ int partiton_register_slots(struct partition *self, struct reactor *reactor)
     return 0;
 }
 
+void partition_attach_scheduler(struct partition *self, struct scheduler *scheduler)
+{
+    assert(self);
+    assert(scheduler);
+
+    for (int i = 0; i < self->slots_count; ++i) {
+        slot_attach_scheduler(self->slots[i], scheduler);
+        slot_timer_attach_scheduler(self->timers[i], scheduler);
+    }
+}
+
+void partition_attach_timer_wheel(struct partition *self, struct timer_wheel *wheel)
+{
+    assert(self);
+    assert(wheel);
+
+    for (int i = 0; i < self->slots_count; ++i)
+        slot_timer_attach_wheel(self->timers[i], wheel);
+}
+
 void partiton_print(const struct partition *self, char *str, int str_size)
 {
     assert(self);
@@ -151,16 +232,42 @@ int partition_init(struct partition **self, const char *name, int index)
     return 0;
 }
 
+const char *slot_evict_get_name(enum slot_evict evict)
+{
+    switch (evict) {
+        case SLOT_EVICT_LRU:
+            return "lru";
+        case SLOT_EVICT_LFU:
+            return "lfu";
+        case SLOT_EVICT_COST:
+            return "cost";
+        case SLOT_EVICT_LAST:
+        default:
+            return "last";
+    }
+}
+
 void partition_free(struct partition *self)
 {
+    uint64_t starts;
+
     assert(self);
 
+    starts = self->stats.rcfg_skips + self->stats.rcfgs;
+    if (starts)
+        DBG_PRINT("fred_sys: partition %s: %"PRIu64" hw-tasks started, %"PRIu64
+                    " rcfg skips (%.1f%%), %"PRIu64" evictions (%s), %"PRIu64
+                    " prefetches\n",
+                    self->name, starts, self->stats.rcfg_skips,
+                    100.0 * self->stats.rcfg_skips / starts, self->stats.evictions,
+                    slot_evict_get_name(self->evict), self->stats.prefetches);
+
     for (int i = 0; i < MAX_SLOTS; ++i) {
         if (self->slots[i])
             event_handler_free(slot_get_event_handler(self->slots[i]));
 
         if (self->timers[i])
-            event_handler_free(slot_timer_get_event_handler(self->timers[i]));
+            slot_timer_free(self->timers[i]);
     }
 
     free(self);
@@ -14,6 +14,7 @@
 #define PARTITION_H_
 
 #include <assert.h>
+#include <stdint.h>
 
 #include "../parameters.h"
 #include "slot_timer.h"
@@ -25,9 +26,25 @@
 
 struct hw_task;
 struct slot;
+struct scheduler;
 
 //---------------------------------------------------------------------------------------------
 
+// Choice of the idle slot to reconfigure when no free slot holds the hw-task
+enum slot_evict {
+    SLOT_EVICT_LAST,                // Last available slot (original FRED)
+    SLOT_EVICT_LRU,                 // Least recently used
+    SLOT_EVICT_LFU,                 // Least frequently used since its last rcfg
+    SLOT_EVICT_COST                 // Cheapest to reload, with aging (GreedyDual)
+};
+
+struct partition_stats {
+    uint64_t rcfg_skips;            // Hw-tasks started without reconfiguration
+    uint64_t rcfgs;                 // Hw-tasks started after a reconfiguration
+    uint64_t evictions;             // Idle slots picked for reconfiguration
+    uint64_t prefetches;            // Speculative reconfigurations done ahead of demand
+};
+
 struct partition {
     char name[MAX_NAMES];
     int index;
@@ -35,6 +52,20 @@ struct partition {
     struct slot *slots[MAX_SLOTS];
     int slots_count;
 
+    // Available slots (idle or blank), bit i for slot i
+    uint64_t avail_mask;
+    uint64_t blank_mask;
+
+    // Eviction policy and per slot bookkeeping, updated when a slot completes
+    enum slot_evict evict;
+    uint64_t use_clock;
+    uint64_t last_use[MAX_SLOTS];
+    uint64_t use_count[MAX_SLOTS];
+    uint64_t credit[MAX_SLOTS];
+    uint64_t credit_floor;
+
+    struct partition_stats stats;
+
     // One execution timer per slot
     struct slot_timer *timers[MAX_SLOTS];
 };
@@ -65,6 +96,94 @@ int partition_get_slots_count(const struct partition *self)
     return self->slots_count;
 }
 
+static inline
+uint64_t partition_get_avail_mask(const struct partition *self)
+{
+    assert(self);
+
+    return self->avail_mask;
+}
+
+static inline
+void partition_set_slot_avail(struct partition *self, int slot_idx)
+{
+    assert(self);
+
+    self->avail_mask |= UINT64_C(1) << slot_idx;
+}
+
+static inline
+void partition_clear_slot_avail(struct partition *self, int slot_idx)
+{
+    assert(self);
+
+    self->avail_mask &= ~(UINT64_C(1) << slot_idx);
+    self->blank_mask &= ~(UINT64_C(1) << slot_idx);
+}
+
+static inline
+void partition_set_slot_blank(struct partition *self, int slot_idx)
+{
+    assert(self);
+
+    self->avail_mask |= UINT64_C(1) << slot_idx;
+    self->blank_mask |= UINT64_C(1) << slot_idx;
+}
+
+// The slot completed an execution, reload_cost estimates the time
+// to configure its hw-task again if evicted
+static inline
+void partition_note_slot_use(struct partition *self, int slot_idx, uint64_t reload_cost)
+{
+    assert(self);
+
+    self->last_use[slot_idx] = ++self->use_clock;
+    self->use_count[slot_idx]++;
+    self->credit[slot_idx] = self->credit_floor + reload_cost;
+}
+
+// The slot has been speculatively configured, the hw-task has not been used yet
+static inline
+void partition_note_slot_load(struct partition *self, int slot_idx, uint64_t reload_cost)
+{
+    assert(self);
+
+    self->stats.prefetches++;
+    self->last_use[slot_idx] = ++self->use_clock;
+    self->use_count[slot_idx] = 0;
+    self->credit[slot_idx] = self->credit_floor + reload_cost;
+}
+
+static inline
+void partition_note_slot_start(struct partition *self, int slot_idx, int rcfg_skipped)
+{
+    assert(self);
+
+    if (rcfg_skipped) {
+        self->stats.rcfg_skips++;
+    } else {
+        // New hw-task in the slot
+        self->stats.rcfgs++;
+        self->use_count[slot_idx] = 0;
+    }
+}
+
+static inline
+const struct partition_stats *partition_get_stats(const struct partition *self)
+{
+    assert(self);
+
+    return &self->stats;
+}
+
+static inline
+void partition_set_slot_evict(struct partition *self, enum slot_evict evict)
+{
+    assert(self);
+
+    self->evict = evict;
+}
+
 //---------------------------------------------------------------------------------------------
 
 int partition_init(struct partition **self, const char *name, int index);
@@ -86,8 +205,16 @@ int partition_search_random_slot(struct partition *self, struct slot **slot,
 
 int partiton_register_slots(struct partition *self, struct reactor *reactor);
 
+// Route the events of all slots and timers to the given scheduler
+void partition_attach_scheduler(struct partition *self, struct scheduler *scheduler);
+
+// Move all slots timers to the given timer wheel
+void partition_attach_timer_wheel(struct partition *self, struct timer_wheel *wheel);
+
 void partiton_print(const struct partition *self, char *str, int str_size);
 
+const char *slot_evict_get_name(enum slot_evict evict);
+
 //---------------------------------------------------------------------------------------------
 
 #endif /* PARTITION_H_ */
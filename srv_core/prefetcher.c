@@ -0,0 +1,130 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <string.h>
+
+#include "prefetcher.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Transitions to be observed before a prediction is trusted
+#define PREFETCH_MIN_COUNT      4
+
+// Counts are halved when one of them reaches this value, to follow phase changes
+#define PREFETCH_MAX_COUNT      256
+
+//---------------------------------------------------------------------------------------------
+
+static
+void add_successor_(struct hw_task *prev, struct hw_task *next)
+{
+    struct hw_task_succ *succ;
+    struct hw_task_succ *min_succ;
+
+    succ = prev->succ;
+    min_succ = &succ[0];
+
+    for (int i = 0; i < HW_TASK_SUCC_WAYS; ++i) {
+        if (succ[i].hw_task == next) {
+            if (++succ[i].count >= PREFETCH_MAX_COUNT) {
+                for (int j = 0; j < HW_TASK_SUCC_WAYS; ++j)
+                    succ[j].count /= 2;
+            }
+            return;
+        }
+
+        if (succ[i].count < min_succ->count)
+            min_succ = &succ[i];
+    }
+
+    // Space-saving: replace the least frequent successor inheriting its count
+    min_succ->hw_task = next;
+    min_succ->count++;
+}
+
+static
+struct hw_task *get_best_successor_(const struct hw_task *prev)
+{
+    const struct hw_task_succ *best = NULL;
+
+    for (int i = 0; i < HW_TASK_SUCC_WAYS; ++i) {
+        if (prev->succ[i].hw_task && (!best || prev->succ[i].count > best->count))
+            best = &prev->succ[i];
+    }
+
+    if (!best || best->count < PREFETCH_MIN_COUNT)
+        return NULL;
+
+    return best->hw_task;
+}
+
+//---------------------------------------------------------------------------------------------
+
+void prefetcher_observe(struct prefetcher *self, struct hw_task *hw_task)
+{
+    struct partition *partition;
+    int part_idx;
+
+    assert(self);
+    assert(hw_task);
+
+    partition = hw_task_get_partition(hw_task);
+    part_idx = partition_get_index(partition);
+
+    if (self->last[part_idx] && self->last[part_idx] != hw_task)
+        add_successor_(self->last[part_idx], hw_task);
+
+    self->last[part_idx] = hw_task;
+    self->partitions[part_idx] = partition;
+}
+
+struct hw_task *prefetcher_predict(struct prefetcher *self, struct partition **partition)
+{
+    struct hw_task *hw_task;
+    int part_idx;
+
+    assert(self);
+    assert(partition);
+
+    for (int i = 0; i < MAX_PARTITIONS; ++i) {
+        part_idx = (self->next_part + i) % MAX_PARTITIONS;
+
+        if (!self->last[part_idx])
+            continue;
+
+        // No free slot to be configured
+        if (!partition_get_avail_mask(self->partitions[part_idx]))
+            continue;
+
+        hw_task = get_best_successor_(self->last[part_idx]);
+        if (!hw_task || hw_task_get_banned(hw_task))
+            continue;
+
+        // Already configured in a free slot
+        if (hw_task_get_resident_mask(hw_task))
+            continue;
+
+        self->next_part = (part_idx + 1) % MAX_PARTITIONS;
+        *partition = self->partitions[part_idx];
+
+        return hw_task;
+    }
+
+    return NULL;
+}
+
+void prefetcher_init(struct prefetcher *self)
+{
+    assert(self);
+
+    memset(self, 0, sizeof(*self));
+}
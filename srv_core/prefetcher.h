@@ -0,0 +1,48 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef PREFETCHER_H_
+#define PREFETCHER_H_
+
+#include "../parameters.h"
+#include "hw_task.h"
+#include "partition.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Learns, for each partition, which hw-task tends to be requested after the
+// last one (first order transitions) and predicts the next hw-task to be
+// configured. Successors are kept in small space-saving tables in the hw-tasks.
+struct prefetcher {
+    // Last requested hw-task for each partition seen so far
+    struct hw_task *last[MAX_PARTITIONS];
+    struct partition *partitions[MAX_PARTITIONS];
+
+    // Round robin among partitions
+    int next_part;
+};
+
+//---------------------------------------------------------------------------------------------
+
+void prefetcher_init(struct prefetcher *self);
+
+// Record a new request
+void prefetcher_observe(struct prefetcher *self, struct hw_task *hw_task);
+
+// Get the hw-task to be speculatively configured and its partition. Returns
+// NULL if no prediction is confident enough or if the predicted hw-task is
+// already resident or there is no free slot for it
+struct hw_task *prefetcher_predict(struct prefetcher *self, struct partition **partition);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* PREFETCHER_H_ */
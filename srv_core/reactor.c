@@ -0,0 +1,51 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include "reactor.h"
+#include "reactor_epoll.h"
+#include "reactor_poll.h"
+#include "reactor_uring.h"
+
+//---------------------------------------------------------------------------------------------
+
+int reactor_init(struct reactor **self, enum reactor_type type)
+{
+    int retval;
+
+    switch (type) {
+        case REACTOR_POLL:
+            retval = reactor_poll_init(self);
+            break;
+        case REACTOR_URING:
+            retval = reactor_uring_init(self);
+            break;
+        case REACTOR_EPOLL:
+        default:
+            retval = reactor_epoll_init(self);
+            break;
+    }
+
+    return retval;
+}
+
+const char *reactor_type_get_name(enum reactor_type type)
+{
+    switch (type) {
+        case REACTOR_POLL:
+            return "poll";
+        case REACTOR_URING:
+            return "io_uring";
+        case REACTOR_EPOLL:
+        default:
+            return "epoll";
+    }
+}
@@ -13,17 +13,30 @@
 #ifndef REACTOR_H_
 #define REACTOR_H_
 
-#include "event_handler.h"
+#include <assert.h>
+#include <stddef.h>
 
-//--- Reactor opaque type ---------------------------------------------------------------------
+#include "event_handler.h"
 
-struct reactor;
+//---------------------------------------------------------------------------------------------
 
-//--- Reactor interface -----------------------------------------------------------------------
+enum reactor_type {
+    REACTOR_EPOLL,
+    REACTOR_POLL,
+    REACTOR_URING
+};
 
+// An edge handler is signalled only when new readiness arrives (where the backend
+// supports it, level otherwise): it must drain its fd, or requeue itself setting its
+// interest again (reactor_set_interest() re-arms it even when unchanged).
+// A hw handler is a normal handler serving the hardware (slots, timers). The epoll
+// reactor serves the hw and pri handlers first in each batch of events, then the
+// others within a budget, the rest waiting for the next batch
 enum react_handler_mode {
     REACT_NORMAL_HANDLER,
-    REACT_PRI_HANDLER
+    REACT_PRI_HANDLER,
+    REACT_EDGE_HANDLER,
+    REACT_HW_HANDLER
 };
 
 enum react_handler_ownership {
@@ -31,15 +44,105 @@ enum react_handler_ownership {
     REACT_OWNED
 };
 
-int reactor_init(struct reactor **self);
+// Readiness a normal handler is waiting for (input only when added)
+enum react_interest {
+    REACT_INTEREST_IN = 1 << 0,
+    REACT_INTEREST_OUT = 1 << 1
+};
 
-void reactor_free(struct reactor *self);
+//---------------------------------------------------------------------------------------------
+// Reactor interface
 
-int reactor_add_event_handler(struct reactor *self, struct event_handler *event_handler,
+struct reactor {
+
+    int (*add_event_handler)(struct reactor *self, struct event_handler *event_handler,
                                 enum react_handler_mode handler_mode,
                                 enum react_handler_ownership handler_ownership);
 
-void reactor_event_loop(struct reactor *self);
+    // Deregister an event handler. Owned handlers are also freed
+    int (*remove_event_handler)(struct reactor *self, struct event_handler *event_handler);
+
+    // Change the readiness a registered normal handler is waiting for
+    int (*set_interest)(struct reactor *self, struct event_handler *event_handler,
+                        int interest);
+
+    // Serve a hw handler in the next round of the event loop as if its fd were
+    // readable, when it knows already about its event (optional)
+    int (*post_event)(struct reactor *self, struct event_handler *event_handler);
+
+    void (*event_loop)(struct reactor *self);
+
+    void (*free)(struct reactor *self);
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int reactor_add_event_handler(struct reactor *self, struct event_handler *event_handler,
+                                enum react_handler_mode handler_mode,
+                                enum react_handler_ownership handler_ownership)
+{
+    assert(self);
+
+    return self->add_event_handler(self, event_handler, handler_mode, handler_ownership);
+}
+
+static inline
+int reactor_remove_event_handler(struct reactor *self, struct event_handler *event_handler)
+{
+    assert(self);
+
+    return self->remove_event_handler(self, event_handler);
+}
+
+static inline
+int reactor_set_interest(struct reactor *self, struct event_handler *event_handler,
+                            int interest)
+{
+    assert(self);
+
+    return self->set_interest(self, event_handler, interest);
+}
+
+static inline
+int reactor_can_post(const struct reactor *self)
+{
+    assert(self);
+
+    return self->post_event != NULL;
+}
+
+static inline
+int reactor_post_event(struct reactor *self, struct event_handler *event_handler)
+{
+    assert(self);
+
+    if (!self->post_event)
+        return -1;
+
+    return self->post_event(self, event_handler);
+}
+
+static inline
+void reactor_event_loop(struct reactor *self)
+{
+    assert(self);
+
+    self->event_loop(self);
+}
+
+static inline
+void reactor_free(struct reactor *self)
+{
+    if (self)
+        self->free(self);
+}
+
+//---------------------------------------------------------------------------------------------
+
+int reactor_init(struct reactor **self, enum reactor_type type);
+
+const char *reactor_type_get_name(enum reactor_type type);
 
 //---------------------------------------------------------------------------------------------
 
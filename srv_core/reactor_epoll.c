@@ -13,71 +13,274 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
-#include "reactor.h"
+#include "reactor_epoll.h"
 #include "event_handler.h"
 #include "../parameters.h"
 #include "../utils/dbg_print.h"
 
-#ifndef USE_POLL
-
 //---------------------------------------------------------------------------------------------
 
 // Epoll implementation of the reactor
 
 //---------------------------------------------------------------------------------------------
 
+// Event handlers are kept in a slab that grows on demand, free entries are linked in
+// a list. Epoll carries a handle (entry index and generation) rather than a pointer:
+// the slab may move when it grows, and an entry freed while serving a batch of events
+// (and possibly reused) bumps its generation, so the events left in the batch for the
+// old handler are recognized as stale and dropped.
+//
+// The hardware handlers (hw and pri) are served first in each batch, so that a slot
+// completion or the end of a reconfiguration does not wait behind the clients. The
+// events of the other handlers are queued (one entry for each handler, the events
+// merged) and at most REACTOR_CLIENTS_BUDGET of them are served for each batch.
+// While some are queued epoll is only polled, so the hardware is checked in between.
+// Events posted by the hardware handlers themselves (a completion busy waited) are
+// queued aside and served in the next round, after the hardware events.
+
+#define SRC_NONE_           UINT32_MAX
+
 // Internal event handler wrapper
 struct event_source_ {
     int active;
+    uint32_t gen;
+    uint32_t next_free;
+    int edge;                   // Edge-triggered
+    int hw;                     // Served first
+    uint32_t ready_events;      // Waiting to be served, or posted (0 not queued)
+    uint32_t ready_prev;
+    uint32_t ready_next;
     enum react_handler_ownership ownership;
     struct event_handler *handler;
 };
 
+// Handlers linked through their entries
+struct ready_list_ {
+    uint32_t head;
+    uint32_t tail;
+};
+
 //---------------------------------------------------------------------------------------------
 
-struct reactor {
+struct reactor_epoll {
+    // ------------------------//
+    struct reactor reactor;
+    // ------------------------//
+
     // Epoll file descriptor
     int ep_fd;
 
     // Events handlers repository
-    struct event_source_ events_sources[MAX_EVENTS_SRCS];
+    struct event_source_ *events_sources;
+    uint32_t events_sources_size;
+    uint32_t free_head;
+
+    // Handlers waiting to be served, in arrival order
+    struct ready_list_ ready;
+
+    // Hardware handlers posted
+    struct ready_list_ posted;
+
+    // Statistics for comparing backends
+    uint64_t wakeups;
+    uint64_t events;
 };
 
 //--- Private methods -------------------------------------------------------------------------
 
+static inline
+uint64_t make_handle_(uint32_t idx, uint32_t gen)
+{
+    return (uint64_t)gen << 32 | idx;
+}
+
+// Returns NULL if the handler has been removed since the handle was taken
+static inline
+struct event_source_ *get_event_source_(struct reactor_epoll *self, uint64_t handle)
+{
+    uint32_t idx = (uint32_t)handle;
+    struct event_source_ *event_src;
+
+    if (idx >= self->events_sources_size)
+        return NULL;
+
+    event_src = &self->events_sources[idx];
+    if (!event_src->active || event_src->gen != (uint32_t)(handle >> 32))
+        return NULL;
+
+    return event_src;
+}
+
+// The entry of a registered handler, NULL if not registered
+static inline
+struct event_source_ *find_event_source_(struct reactor_epoll *self,
+                                            const struct event_handler *event_handler)
+{
+    struct event_source_ *event_src;
+
+    if (event_handler->reactor_idx >= self->events_sources_size)
+        return NULL;
+
+    event_src = &self->events_sources[event_handler->reactor_idx];
+    if (!event_src->active || event_src->handler != event_handler)
+        return NULL;
+
+    return event_src;
+}
+
+static inline
+uint64_t get_handle_(const struct reactor_epoll *self, const struct event_source_ *event_src)
+{
+    return make_handle_(event_src - self->events_sources, event_src->gen);
+}
+
+// Double the slab, the new entries are linked in index order
+static
+int grow_events_sources_(struct reactor_epoll *self)
+{
+    uint32_t size;
+    struct event_source_ *sources;
+
+    size = self->events_sources_size ? self->events_sources_size * 2 : REACTOR_INIT_SRCS;
+
+    sources = realloc(self->events_sources, size * sizeof(*sources));
+    if (!sources)
+        return -1;
+
+    for (uint32_t i = self->events_sources_size; i < size; ++i) {
+        sources[i].active = 0;
+        sources[i].gen = 0;
+        sources[i].handler = NULL;
+        sources[i].ready_events = 0;
+        sources[i].next_free = i + 1 < size ? i + 1 : self->free_head;
+    }
+
+    self->free_head = self->events_sources_size;
+    self->events_sources = sources;
+    self->events_sources_size = size;
+
+    return 0;
+}
+
 static
-void free_event_source_(struct reactor *self, struct event_source_ *event_src)
+struct event_source_ *alloc_event_source_(struct reactor_epoll *self)
+{
+    struct event_source_ *event_src;
+
+    if (self->free_head == SRC_NONE_ && grow_events_sources_(self))
+        return NULL;
+
+    event_src = &self->events_sources[self->free_head];
+    self->free_head = event_src->next_free;
+    event_src->active = 1;
+
+    return event_src;
+}
+
+// The hardware handlers can only be posted
+static inline
+struct ready_list_ *get_ready_list_(struct reactor_epoll *self,
+                                    const struct event_source_ *event_src)
+{
+    return event_src->hw ? &self->posted : &self->ready;
+}
+
+// Queue the events of an handler, merged with the ones already queued
+static
+void ready_push_(struct reactor_epoll *self, struct event_source_ *event_src, uint32_t events)
+{
+    uint32_t idx = event_src - self->events_sources;
+    struct ready_list_ *list;
+
+    if (!event_src->ready_events) {
+        list = get_ready_list_(self, event_src);
+
+        event_src->ready_prev = list->tail;
+        event_src->ready_next = SRC_NONE_;
+
+        if (list->tail != SRC_NONE_)
+            self->events_sources[list->tail].ready_next = idx;
+        else
+            list->head = idx;
+        list->tail = idx;
+    }
+
+    event_src->ready_events |= events;
+}
+
+static
+void ready_unlink_(struct reactor_epoll *self, struct event_source_ *event_src)
+{
+    struct ready_list_ *list;
+
+    if (!event_src->ready_events)
+        return;
+
+    list = get_ready_list_(self, event_src);
+
+    if (event_src->ready_prev != SRC_NONE_)
+        self->events_sources[event_src->ready_prev].ready_next = event_src->ready_next;
+    else
+        list->head = event_src->ready_next;
+
+    if (event_src->ready_next != SRC_NONE_)
+        self->events_sources[event_src->ready_next].ready_prev = event_src->ready_prev;
+    else
+        list->tail = event_src->ready_prev;
+
+    event_src->ready_events = 0;
+}
+
+// Outstanding handles to the entry become stale
+static
+void release_event_source_(struct reactor_epoll *self, struct event_source_ *event_src)
+{
+    ready_unlink_(self, event_src);
+
+    event_src->handler = NULL;
+    event_src->active = 0;
+    event_src->gen++;
+
+    event_src->next_free = self->free_head;
+    self->free_head = event_src - self->events_sources;
+}
+
+static
+void free_event_source_(struct reactor_epoll *self, struct event_source_ *event_src)
 {
     int handler_fd;
+    struct event_handler *handler;
     char handler_name[MAX_NAMES];
 
+    handler = event_src->handler;
+
     // Remove from epoll
-    handler_fd = event_handler_get_fd_handle(event_src->handler);
+    handler_fd = event_handler_get_fd_handle(handler);
     epoll_ctl(self->ep_fd, EPOLL_CTL_DEL, handler_fd, NULL);
 
     // Get handler name for print
-    event_handler_get_name(event_src->handler, handler_name, MAX_NAMES);
+    event_handler_get_name(handler, handler_name, MAX_NAMES);
 
     DBG_PRINT("fred_sys: epoll reactor: removing event handler %s\n", handler_name);
 
-    // Free the event handler object
-    event_handler_free(event_src->handler);
+    // Release the entry first, the handler may deregister others while freed
+    release_event_source_(self, event_src);
 
-    // Clear repository flag
-    event_src->handler = NULL;
-    event_src->active = 0;
+    // Free the event handler object
+    event_handler_free(handler);
 }
 
 static
-void free_all_events_source_(struct reactor *self)
+void free_all_events_source_(struct reactor_epoll *self)
 {
-    for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
+    for (uint32_t i = 0; i < self->events_sources_size; ++i) {
         if (self->events_sources[i].active &&
             self->events_sources[i].ownership == REACT_OWNED) {
                 free_event_source_(self, &self->events_sources[i]);
@@ -87,10 +290,13 @@ void free_all_events_source_(struct reactor *self)
 
 //--- Reactor interface implementation --------------------------------------------------------
 
-int reactor_add_event_handler(struct reactor *self, struct event_handler *event_handler,
-                                enum react_handler_mode handler_mode,
-                                enum react_handler_ownership handler_ownership)
+static
+int add_event_handler_(struct reactor *self, struct event_handler *event_handler,
+                        enum react_handler_mode handler_mode,
+                        enum react_handler_ownership handler_ownership)
 {
+    struct reactor_epoll *reactor;
+    struct event_source_ *event_src;
     int retval;
     int handler_fd = 0;
     char handler_name[MAX_NAMES];
@@ -101,98 +307,249 @@ int reactor_add_event_handler(struct reactor *self, struct event_handler *event_
     assert(self);
     assert(event_handler);
 
-    // Try to add the event handler to the repository
-    for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
-        if (!self->events_sources[i].active) {
-
-            // Add event source to the event repository
-            self->events_sources[i].handler = event_handler;
-            self->events_sources[i].ownership = handler_ownership;
-            self->events_sources[i].active = 1;
-
-            // Fill the epoll event structure and link the event handler wrapper
-            switch (handler_mode) {
-                case REACT_PRI_HANDLER:
-                    epoll_event.events = EPOLLERR | EPOLLPRI;
-                    break;
-                case REACT_NORMAL_HANDLER:
-                default:
-                    epoll_event.events = EPOLLIN;
-                    break;
-            }
+    reactor = (struct reactor_epoll *)self;
 
-            epoll_event.data.ptr = &self->events_sources[i];
+    // Add event source to the event repository
+    event_src = alloc_event_source_(reactor);
+    if (!event_src) {
+        ERROR_PRINT("fred_sys: epoll reactor: could not grow handlers repository\n");
+        return -1;
+    }
 
-            // Get handler name and file descriptor
-            event_handler_get_name(event_handler, handler_name, MAX_NAMES);
-            handler_fd = event_handler_get_fd_handle(event_handler);
+    event_src->handler = event_handler;
+    event_src->ownership = handler_ownership;
+    event_src->edge = handler_mode == REACT_EDGE_HANDLER;
+    event_src->hw = handler_mode == REACT_HW_HANDLER || handler_mode == REACT_PRI_HANDLER;
+    event_handler->reactor_idx = event_src - reactor->events_sources;
+
+    // Fill the epoll event structure and link the event handler wrapper
+    switch (handler_mode) {
+        case REACT_PRI_HANDLER:
+            epoll_event.events = EPOLLERR | EPOLLPRI;
+            break;
+        case REACT_EDGE_HANDLER:
+            epoll_event.events = EPOLLIN | EPOLLET;
+            break;
+        case REACT_HW_HANDLER:
+        case REACT_NORMAL_HANDLER:
+        default:
+            epoll_event.events = EPOLLIN;
+            break;
+    }
 
-            DBG_PRINT("fred_sys: epoll reactor: adding event handler: %s\n",
-                        handler_name);
+    epoll_event.data.u64 = get_handle_(reactor, event_src);
 
-            // Add to epoll
-            retval = epoll_ctl(self->ep_fd, EPOLL_CTL_ADD, handler_fd, &epoll_event);
-            if (retval < 0) {
-                ERROR_PRINT("fred_sys: epoll reactor: epoll_ctl: could not add event!\n");
-                return -1;
-            }
+    // Get handler name and file descriptor
+    event_handler_get_name(event_handler, handler_name, MAX_NAMES);
+    handler_fd = event_handler_get_fd_handle(event_handler);
 
-            return 0;
-        }
+    DBG_PRINT("fred_sys: epoll reactor: adding event handler: %s\n",
+                handler_name);
+
+    // Add to epoll
+    retval = epoll_ctl(reactor->ep_fd, EPOLL_CTL_ADD, handler_fd, &epoll_event);
+    if (retval < 0) {
+        ERROR_PRINT("fred_sys: epoll reactor: epoll_ctl: could not add event!\n");
+        release_event_source_(reactor, event_src);
+        return -1;
+    }
+
+    return 0;
+}
+
+static
+int remove_event_handler_(struct reactor *self, struct event_handler *event_handler)
+{
+    struct reactor_epoll *reactor;
+    struct event_source_ *event_src;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_epoll *)self;
+
+    event_src = find_event_source_(reactor, event_handler);
+    if (!event_src)
+        return -1;
+
+    if (event_src->ownership == REACT_OWNED) {
+        free_event_source_(reactor, event_src);
+    } else {
+        epoll_ctl(reactor->ep_fd, EPOLL_CTL_DEL,
+                    event_handler_get_fd_handle(event_handler), NULL);
+        release_event_source_(reactor, event_src);
     }
 
-    return -1;
+    return 0;
+}
+
+static
+int set_interest_(struct reactor *self, struct event_handler *event_handler, int interest)
+{
+    struct reactor_epoll *reactor;
+    struct event_source_ *event_src;
+    struct epoll_event epoll_event;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_epoll *)self;
+
+    event_src = find_event_source_(reactor, event_handler);
+    if (!event_src)
+        return -1;
+
+    epoll_event.events = 0;
+    if (interest & REACT_INTEREST_IN)
+        epoll_event.events |= EPOLLIN;
+    if (interest & REACT_INTEREST_OUT)
+        epoll_event.events |= EPOLLOUT;
+    if (event_src->edge)
+        epoll_event.events |= EPOLLET;
+    epoll_event.data.u64 = get_handle_(reactor, event_src);
+
+    // Epoll checks the readiness again, an edge handler still ready is queued again
+    return epoll_ctl(reactor->ep_fd, EPOLL_CTL_MOD,
+                        event_handler_get_fd_handle(event_handler), &epoll_event);
+}
+
+static
+int post_event_(struct reactor *self, struct event_handler *event_handler)
+{
+    struct reactor_epoll *reactor;
+    struct event_source_ *event_src;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_epoll *)self;
+
+    event_src = find_event_source_(reactor, event_handler);
+    if (!event_src || !event_src->hw)
+        return -1;
+
+    ready_push_(reactor, event_src, EPOLLIN);
+
+    return 0;
 }
 
-void reactor_event_loop(struct reactor *self)
+// Serve the events of an handler. Returns -1 if the event loop must be shut down
+static
+int dispatch_(struct reactor_epoll *self, uint64_t handle, uint32_t events)
 {
     int retval;
+    struct event_handler *handler;
+    struct event_source_ *event_src;
+
+    // The handler may have been removed while serving this batch
+    event_src = get_event_source_(self, handle);
+    if (!event_src)
+        return 0;
+
+    // Check event class
+    if (events & EPOLLRDHUP) {
+        ERROR_PRINT("fred_sys: EPOLLRDHUP, connection closed\n");
+        free_event_source_(self, event_src);
+        return 0;
+
+    } else if ((events & EPOLLERR) && !(events & EPOLLPRI)) {
+        ERROR_PRINT("fred_sys: epoll reactor: epoll_wait error\n");
+        return -1;
+    }
+
+    // The slab may move while the handler runs (adding handlers)
+    handler = event_src->handler;
+
+    // Handle event, output first since it may make room for the input
+    retval = 0;
+    if (events & EPOLLOUT)
+        retval = event_handler_handle_output(handler);
+    if (!retval && (events & ~EPOLLOUT) && get_event_source_(self, handle))
+        retval = event_handler_handle_event(handler);
+
+    // Single client error -> detach handler
+    if (retval > 0) {
+        event_src = get_event_source_(self, handle);
+        if (event_src)
+            free_event_source_(self, event_src);
+        return 0;
+    }
+
+    // System error -> shutdown
+    return retval < 0 ? -1 : 0;
+}
+
+static
+void event_loop_(struct reactor *self)
+{
+    struct reactor_epoll *reactor;
+    int retval;
+    uint32_t events;
+    unsigned int posted_count;
     struct event_source_ *event_src;
 
     // For epoll
-    struct epoll_event epoll_events[MAX_EVENTS_SRCS];
+    struct epoll_event epoll_events[REACTOR_EVENTS_BATCH];
     int events_count;
 
+    assert(self);
+
+    reactor = (struct reactor_epoll *)self;
+
     while (1) {
-        // Wait for events
-        events_count = epoll_wait(self->ep_fd, epoll_events, MAX_EVENTS_SRCS, -1);
+        // Wait for events, just check if some are still queued or posted
+        events_count = epoll_wait(reactor->ep_fd, epoll_events, REACTOR_EVENTS_BATCH,
+                                    reactor->ready.head != SRC_NONE_ ||
+                                    reactor->posted.head != SRC_NONE_ ? 0 : -1);
         if (events_count < 0) {
             ERROR_PRINT("fred_sys: epoll reactor: epoll_wait error %s\n", strerror(errno));
             goto exit_clear;
         }
 
-        // Process active events
-        for (int i = 0; i < events_count; ++i) {
+        reactor->wakeups++;
+        reactor->events += events_count;
 
-            // Get event handle
-            event_src = (struct event_source_ *)epoll_events[i].data.ptr;
+        // Serve the hardware events, queue the others
+        for (int i = 0; i < events_count; ++i) {
+            event_src = get_event_source_(reactor, epoll_events[i].data.u64);
+            if (!event_src)
+                continue;
 
-            // Check event class
-            if (epoll_events[i].events & EPOLLRDHUP) {
-                ERROR_PRINT("fred_sys: EPOLLRDHUP, connection closed\n");
-                free_event_source_(self, event_src);
+            if (!event_src->hw) {
+                ready_push_(reactor, event_src, epoll_events[i].events);
                 continue;
+            }
 
-            } else if ((epoll_events[i].events & EPOLLERR) &&
-                        !(epoll_events[i].events & EPOLLPRI)) {
-                ERROR_PRINT("fred_sys: epoll reactor: epoll_wait error\n");
+            retval = dispatch_(reactor, epoll_events[i].data.u64, epoll_events[i].events);
+            if (retval)
                 goto exit_clear;
-            }
+        }
 
-            assert(event_src);
+        // Then the posted ones, those posted meanwhile wait for the next round
+        posted_count = 0;
+        for (uint32_t idx = reactor->posted.head; idx != SRC_NONE_;
+                idx = reactor->events_sources[idx].ready_next)
+            posted_count++;
 
-            // Handle event
-            retval = event_handler_handle_event(event_src->handler);
+        for (; posted_count && reactor->posted.head != SRC_NONE_; --posted_count) {
+            event_src = &reactor->events_sources[reactor->posted.head];
+            events = event_src->ready_events;
+            ready_unlink_(reactor, event_src);
 
-            // Single client error -> detach handler
-            if (retval > 0) {
-                free_event_source_(self, event_src);
-                continue;
+            retval = dispatch_(reactor, get_handle_(reactor, event_src), events);
+            if (retval)
+                goto exit_clear;
+        }
+
+        // Then the queued ones, up to the budget
+        for (int i = 0; i < REACTOR_CLIENTS_BUDGET && reactor->ready.head != SRC_NONE_; ++i) {
+            event_src = &reactor->events_sources[reactor->ready.head];
+            events = event_src->ready_events;
+            ready_unlink_(reactor, event_src);
 
-            // System error -> shutdown
-            } else if (retval < 0) {
+            retval = dispatch_(reactor, get_handle_(reactor, event_src), events);
+            if (retval)
                 goto exit_clear;
-            }
         }
     }
 
@@ -200,37 +557,65 @@ void reactor_event_loop(struct reactor *self)
 // without using cumbersome logic conditions and unnecessary extra variables
 exit_clear:
     ERROR_PRINT("fred_sys: epoll reactor: shutting down event loop\n");
-    free_all_events_source_(self);
+    DBG_PRINT("fred_sys: epoll reactor: %"PRIu64" wakeups, %"PRIu64" events\n",
+                reactor->wakeups, reactor->events);
+    free_all_events_source_(reactor);
     return;
 }
 
-int reactor_init(struct reactor **self)
+static
+void free_(struct reactor *self)
+{
+    struct reactor_epoll *reactor;
+
+    if (!self)
+        return;
+
+    reactor = (struct reactor_epoll *)self;
+
+    free_all_events_source_(reactor);
+    close(reactor->ep_fd);
+
+    free(reactor->events_sources);
+    free(reactor);
+}
+
+//---------------------------------------------------------------------------------------------
+
+int reactor_epoll_init(struct reactor **self)
 {
+    struct reactor_epoll *reactor;
+
+    *self = NULL;
+
     // Allocate and set everything to zero
-    *self = calloc(1, sizeof(**self));
-    if (!(*self))
+    reactor = calloc(1, sizeof(*reactor));
+    if (!reactor)
         return -1;
 
+    reactor->free_head = SRC_NONE_;
+    reactor->ready.head = SRC_NONE_;
+    reactor->ready.tail = SRC_NONE_;
+    reactor->posted.head = SRC_NONE_;
+    reactor->posted.tail = SRC_NONE_;
+
     // Create epoll instance
-    (*self)->ep_fd = epoll_create1(0);
-    if ((*self)->ep_fd < 0) {
+    reactor->ep_fd = epoll_create1(0);
+    if (reactor->ep_fd < 0) {
         ERROR_PRINT("fred_sys: epoll reactor: epoll_create error\n");
-        free(*self);
+        free(reactor);
         return -1;
     }
 
-    return 0;
-}
+    // Reactor interface
+    reactor->reactor.add_event_handler = add_event_handler_;
+    reactor->reactor.remove_event_handler = remove_event_handler_;
+    reactor->reactor.set_interest = set_interest_;
+    reactor->reactor.post_event = post_event_;
+    reactor->reactor.event_loop = event_loop_;
+    reactor->reactor.free = free_;
 
-void reactor_free(struct reactor *self)
-{
-    if (!self)
-        return;
-
-    free_all_events_source_(self);
-    close(self->ep_fd);
+    *self = &reactor->reactor;
 
-    free(self);
+    return 0;
 }
-
-#endif //USE_POLL
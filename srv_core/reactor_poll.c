@@ -13,19 +13,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <poll.h>
 #include <unistd.h>
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
-#include "reactor.h"
+#include "reactor_poll.h"
 #include "event_handler.h"
 #include "../parameters.h"
 #include "../utils/dbg_print.h"
 
-#ifdef USE_POLL
-
 //---------------------------------------------------------------------------------------------
 
 // Poll implementation of the reactor
@@ -35,95 +34,126 @@
 // Internal event handler wrapper
 struct event_source_ {
     int active;
+    enum react_handler_ownership ownership;
     struct event_handler *handler;
 };
 
 //---------------------------------------------------------------------------------------------
 
-struct reactor {
-    // Active handlers count
+struct reactor_poll {
+    // ------------------------//
+    struct reactor reactor;
+    // ------------------------//
+
+    // Number of used entries (including holes left by removed handlers)
     int events_count;
 
     // Events handlers repository
     struct event_source_ events_sources[MAX_EVENTS_SRCS];
 
-    // pollfd array for poll
+    // pollfd array for poll. Removed entries have a negative
+    // fd so they are ignored by poll until reused
     struct pollfd events_fds[MAX_EVENTS_SRCS];
+
+    // Statistics for comparing backends
+    uint64_t wakeups;
+    uint64_t events;
 };
 
 //--- Private methods -------------------------------------------------------------------------
 
-// This is supposed to happens only in case of *faults* when a client crashes
 static
-void free_event_source_(struct reactor *self, int i)
+void clear_event_source_(struct reactor_poll *self, int i)
+{
+    self->events_sources[i].handler = NULL;
+    self->events_sources[i].active = 0;
+    self->events_fds[i].fd = -1;
+    self->events_fds[i].revents = 0;
+
+    // Shrink the used range if possible
+    while (self->events_count > 0 && !self->events_sources[self->events_count - 1].active)
+        self->events_count--;
+}
+
+static
+void free_event_source_(struct reactor_poll *self, int i)
 {
     char handler_name[MAX_NAMES];
-    struct event_source_ *event_source;
+    struct event_handler *handler;
 
-    // Get event source from the repository
-    event_source = &self->events_sources[i];
+    handler = self->events_sources[i].handler;
 
     // Get handler name for print
-    event_source->handler->get_name(event_source->handler, handler_name, MAX_NAMES);
+    event_handler_get_name(handler, handler_name, MAX_NAMES);
 
     DBG_PRINT("fred_sys: poll reactor: removing event handler %s\n", handler_name);
 
-    // Free the event handler object
-    event_source->handler->free(event_source->handler);
-
-    // Remove event source and compact arrays
-    memmove(&self->events_sources[i],
-            &self->events_sources[i + 1],
-            (self->events_count - 1 - i) * sizeof(self->events_sources[0]));
-
-    memmove(&self->events_fds[i],
-            &self->events_fds[i + 1],
-            (self->events_count - 1 - i) * sizeof(self->events_fds[0]));
+    // Remove first, the handler may remove other handlers while being freed
+    clear_event_source_(self, i);
 
-    self->events_sources[self->events_count - 1].handler = NULL;
-    self->events_sources[self->events_count - 1].active = 0;
-
-    self->events_count--;
+    // Free the event handler object
+    event_handler_free(handler);
 }
 
 // Called during shutdown
 static
-void free_all_events_source_(struct reactor *self)
+void free_all_events_source_(struct reactor_poll *self)
 {
     for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
-        if (self->events_sources[i].active) {
-            free_event_source_(self, i);
+        if (self->events_sources[i].active &&
+            self->events_sources[i].ownership == REACT_OWNED) {
+                free_event_source_(self, i);
         }
     }
 }
 
 //--- Reactor interface implementation --------------------------------------------------------
 
-int reactor_add_event_handler(struct reactor *self, struct event_handler *event_handler)
+static
+int add_event_handler_(struct reactor *self, struct event_handler *event_handler,
+                        enum react_handler_mode handler_mode,
+                        enum react_handler_ownership handler_ownership)
 {
-    int handler_fd = 0;
+    struct reactor_poll *reactor;
     char handler_name[MAX_NAMES];
 
     assert(self);
     assert(event_handler);
 
+    reactor = (struct reactor_poll *)self;
+
     // Try to add the event handler to the repository
     for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
-        if (!self->events_sources[i].active) {
+        if (!reactor->events_sources[i].active) {
 
             // Add event source to the event repository
-            self->events_sources[i].handler = event_handler;
-            self->events_sources[i].active = 1;
-
-            // Get handler name and file descriptor
-            event_handler->get_name(event_handler, handler_name, MAX_NAMES);
-            handler_fd = event_handler->get_fd_handle(event_handler);
+            reactor->events_sources[i].handler = event_handler;
+            reactor->events_sources[i].ownership = handler_ownership;
+            reactor->events_sources[i].active = 1;
 
             // Set pollfd struct
-            self->events_fds[i].fd = handler_fd;
-            self->events_fds[i].events = POLLIN;
+            reactor->events_fds[i].fd = event_handler_get_fd_handle(event_handler);
+            reactor->events_fds[i].revents = 0;
+
+            switch (handler_mode) {
+                case REACT_PRI_HANDLER:
+                    reactor->events_fds[i].events = POLLPRI;
+                    break;
+                // Level-triggered, edge handlers are just served more often.
+                // Events are served in the order they are reported
+                case REACT_EDGE_HANDLER:
+                case REACT_HW_HANDLER:
+                case REACT_NORMAL_HANDLER:
+                default:
+                    reactor->events_fds[i].events = POLLIN;
+                    break;
+            }
 
-            self->events_count++;
+            if (i >= reactor->events_count)
+                reactor->events_count = i + 1;
+
+            // Get handler name
+            event_handler_get_name(event_handler, handler_name, MAX_NAMES);
 
             DBG_PRINT("fred_sys: poll reactor: adding event handler: %s\n",
                         handler_name);
@@ -135,58 +165,159 @@ int reactor_add_event_handler(struct reactor *self, struct event_handler *event_
     return -1;
 }
 
-void reactor_event_loop(struct reactor *self)
+static
+int remove_event_handler_(struct reactor *self, struct event_handler *event_handler)
 {
+    struct reactor_poll *reactor;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_poll *)self;
+
+    for (int i = 0; i < reactor->events_count; ++i) {
+        if (reactor->events_sources[i].active &&
+            reactor->events_sources[i].handler == event_handler) {
+
+            if (reactor->events_sources[i].ownership == REACT_OWNED)
+                free_event_source_(reactor, i);
+            else
+                clear_event_source_(reactor, i);
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static
+int set_interest_(struct reactor *self, struct event_handler *event_handler, int interest)
+{
+    struct reactor_poll *reactor;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_poll *)self;
+
+    for (int i = 0; i < reactor->events_count; ++i) {
+        if (reactor->events_sources[i].active &&
+            reactor->events_sources[i].handler == event_handler) {
+
+            reactor->events_fds[i].events = 0;
+            if (interest & REACT_INTEREST_IN)
+                reactor->events_fds[i].events |= POLLIN;
+            if (interest & REACT_INTEREST_OUT)
+                reactor->events_fds[i].events |= POLLOUT;
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static
+void event_loop_(struct reactor *self)
+{
+    struct reactor_poll *reactor;
     int retval;
+    short revents;
+
+    assert(self);
+
+    reactor = (struct reactor_poll *)self;
 
     while (1) {
-        retval = poll(&self->events_fds[0], self->events_count, -1);
+        retval = poll(&reactor->events_fds[0], reactor->events_count, -1);
         if (retval < 0) {
             ERROR_PRINT("fred_sys: poll reactor: poll error %s\n", strerror(errno));
-            return;
-        } else {
-            // Handle events
-            for (int i = 0; i < self->events_count; ++i) {
-                // Ready for a read
-                if (self->events_fds[i].revents & POLLIN) {
-                    // Handle event
-                    retval = self->events_sources[i].handler->handle_event(
-                                self->events_sources[i].handler);
-
-                    // Single client error -> detach handler
-                    if (retval > 0) {
-                        free_event_source_(self, i);
-
-                    // System error -> shutdown
-                    } else if (retval < 0) {
-                        free_all_events_source_(self);
-                        ERROR_PRINT("fred_sys: poll reactor: shutting down event loop");
-                        return;
-                    }
-                }
+            goto exit_clear;
+        }
+
+        reactor->wakeups++;
+        reactor->events += retval;
+
+        // Handle events
+        for (int i = 0; i < reactor->events_count; ++i) {
+            revents = reactor->events_fds[i].revents;
+            reactor->events_fds[i].revents = 0;
+
+            // The handler may have been removed while serving this batch
+            if (!revents || !reactor->events_sources[i].active)
+                continue;
+
+            if ((revents & (POLLERR | POLLNVAL)) && !(revents & POLLPRI)) {
+                ERROR_PRINT("fred_sys: poll reactor: poll error on fd: %d\n",
+                            reactor->events_fds[i].fd);
+                goto exit_clear;
+            }
+
+            // Handle event, output first since it may make room for the input
+            retval = 0;
+            if (revents & POLLOUT)
+                retval = event_handler_handle_output(reactor->events_sources[i].handler);
+            if (!retval && (revents & ~POLLOUT))
+                retval = event_handler_handle_event(reactor->events_sources[i].handler);
+
+            // Single client error -> detach handler
+            if (retval > 0) {
+                free_event_source_(reactor, i);
+
+            // System error -> shutdown
+            } else if (retval < 0) {
+                goto exit_clear;
             }
         }
     }
-}
 
-int reactor_init(struct reactor **self)
-{
-    // Allocate and set everything to zero
-    *self = calloc(1, sizeof(**self));
-    if (!(*self))
-        return -1;
-
-    return 0;
+exit_clear:
+    ERROR_PRINT("fred_sys: poll reactor: shutting down event loop\n");
+    DBG_PRINT("fred_sys: poll reactor: %"PRIu64" wakeups, %"PRIu64" events\n",
+                reactor->wakeups, reactor->events);
+    free_all_events_source_(reactor);
 }
 
-void reactor_free(struct reactor *self)
+static
+void free_(struct reactor *self)
 {
+    struct reactor_poll *reactor;
+
     if (!self)
         return;
 
-    free_all_events_source_(self);
+    reactor = (struct reactor_poll *)self;
+
+    free_all_events_source_(reactor);
 
-    free(self);
+    free(reactor);
 }
 
-#endif //USE_POLL
+//---------------------------------------------------------------------------------------------
+
+int reactor_poll_init(struct reactor **self)
+{
+    struct reactor_poll *reactor;
+
+    *self = NULL;
+
+    // Allocate and set everything to zero
+    reactor = calloc(1, sizeof(*reactor));
+    if (!reactor)
+        return -1;
+
+    for (int i = 0; i < MAX_EVENTS_SRCS; ++i)
+        reactor->events_fds[i].fd = -1;
+
+    // Reactor interface
+    reactor->reactor.add_event_handler = add_event_handler_;
+    reactor->reactor.remove_event_handler = remove_event_handler_;
+    reactor->reactor.set_interest = set_interest_;
+    reactor->reactor.event_loop = event_loop_;
+    reactor->reactor.free = free_;
+
+    *self = &reactor->reactor;
+
+    return 0;
+}
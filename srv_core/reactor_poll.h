@@ -0,0 +1,24 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef REACTOR_POLL_H_
+#define REACTOR_POLL_H_
+
+#include "reactor.h"
+
+//---------------------------------------------------------------------------------------------
+
+int reactor_poll_init(struct reactor **self);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* REACTOR_POLL_H_ */
@@ -0,0 +1,604 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <unistd.h>
+#include <assert.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "reactor_uring.h"
+#include "event_handler.h"
+#include "../parameters.h"
+#include "../utils/dbg_print.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Io_uring implementation of the reactor (without liburing).
+// Readiness is obtained through poll requests. Multishot polls are used for
+// handlers that fully consume their fd on each event (devcfg), while the others
+// use one-shot polls re-armed after dispatching to retain level-triggered
+// semantics. Completions are harvested in batches and the re-arm requests are
+// submitted with the same io_uring_enter() call that waits for the next batch.
+
+//---------------------------------------------------------------------------------------------
+
+// Enough to re-arm all the events sources within a single submission
+#define URING_ENTRIES           4096
+
+// User data for requests whose completion must be ignored
+#define URING_IGNORE_UDATA      UINT64_MAX
+
+//---------------------------------------------------------------------------------------------
+
+// Internal event handler wrapper
+struct event_source_ {
+    int active;
+    int armed;
+    uint32_t gen;               // Filters stale completions
+    unsigned int poll_mask;
+    int multishot;
+    enum react_handler_ownership ownership;
+    struct event_handler *handler;
+};
+
+//---------------------------------------------------------------------------------------------
+
+struct reactor_uring {
+    // ------------------------//
+    struct reactor reactor;
+    // ------------------------//
+
+    int ring_fd;
+
+    // Submission queue ring
+    void *sq_ptr;
+    size_t sq_size;
+    unsigned int *sq_head;
+    unsigned int *sq_tail;
+    unsigned int *sq_mask;
+    unsigned int *sq_array;
+    unsigned int sq_entries;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+
+    // Completion queue ring
+    void *cq_ptr;
+    size_t cq_size;
+    unsigned int *cq_head;
+    unsigned int *cq_tail;
+    unsigned int *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    // Prepared but not yet submitted requests
+    unsigned int to_submit;
+
+    // Events handlers repository
+    struct event_source_ events_sources[MAX_EVENTS_SRCS];
+
+    // Statistics for comparing backends
+    uint64_t wakeups;
+    uint64_t events;
+};
+
+//--- Io_uring syscalls -----------------------------------------------------------------------
+
+static inline
+int io_uring_setup_(unsigned int entries, struct io_uring_params *params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline
+int io_uring_enter_(int ring_fd, unsigned int to_submit, unsigned int min_complete,
+                    unsigned int flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                        flags, NULL, 0);
+}
+
+//--- Private methods -------------------------------------------------------------------------
+
+static inline
+uint64_t source_udata_(const struct reactor_uring *self, int i)
+{
+    return ((uint64_t)self->events_sources[i].gen << 32) | (uint32_t)i;
+}
+
+static
+int submit_pending_(struct reactor_uring *self)
+{
+    int retval;
+
+    while (self->to_submit) {
+        retval = io_uring_enter_(self->ring_fd, self->to_submit, 0, 0);
+        if (retval < 0) {
+            if (errno == EINTR)
+                continue;
+            ERROR_PRINT("fred_sys: uring reactor: submit error %s\n", strerror(errno));
+            return -1;
+        }
+        self->to_submit -= retval;
+    }
+
+    return 0;
+}
+
+static
+struct io_uring_sqe *get_sqe_(struct reactor_uring *self)
+{
+    unsigned int head;
+    unsigned int tail;
+    struct io_uring_sqe *sqe;
+
+    head = __atomic_load_n(self->sq_head, __ATOMIC_ACQUIRE);
+    tail = *self->sq_tail;
+
+    // Submission ring full, flush it
+    if (tail - head >= self->sq_entries) {
+        if (submit_pending_(self))
+            return NULL;
+    }
+
+    sqe = &self->sqes[tail & *self->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+
+    self->sq_array[tail & *self->sq_mask] = tail & *self->sq_mask;
+    __atomic_store_n(self->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    self->to_submit++;
+
+    return sqe;
+}
+
+static
+int arm_event_source_(struct reactor_uring *self, int i)
+{
+    struct io_uring_sqe *sqe;
+    struct event_source_ *event_src;
+
+    event_src = &self->events_sources[i];
+
+    sqe = get_sqe_(self);
+    if (!sqe)
+        return -1;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = event_handler_get_fd_handle(event_src->handler);
+    sqe->poll32_events = event_src->poll_mask;
+    sqe->len = event_src->multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = source_udata_(self, i);
+
+    event_src->armed = 1;
+
+    return 0;
+}
+
+static
+void clear_event_source_(struct reactor_uring *self, int i)
+{
+    struct io_uring_sqe *sqe;
+    struct event_source_ *event_src;
+
+    event_src = &self->events_sources[i];
+
+    // Cancel the pending poll
+    if (event_src->armed) {
+        sqe = get_sqe_(self);
+        if (sqe) {
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = source_udata_(self, i);
+            sqe->user_data = URING_IGNORE_UDATA;
+        }
+    }
+
+    // New generation, completions still in flight will be discarded
+    event_src->gen++;
+    event_src->armed = 0;
+    event_src->handler = NULL;
+    event_src->active = 0;
+}
+
+static
+void free_event_source_(struct reactor_uring *self, int i)
+{
+    char handler_name[MAX_NAMES];
+    struct event_handler *handler;
+
+    handler = self->events_sources[i].handler;
+
+    // Get handler name for print
+    event_handler_get_name(handler, handler_name, MAX_NAMES);
+
+    DBG_PRINT("fred_sys: uring reactor: removing event handler %s\n", handler_name);
+
+    // Remove first, the handler may remove other handlers while being freed
+    clear_event_source_(self, i);
+
+    // Free the event handler object
+    event_handler_free(handler);
+}
+
+static
+void free_all_events_source_(struct reactor_uring *self)
+{
+    for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
+        if (self->events_sources[i].active &&
+            self->events_sources[i].ownership == REACT_OWNED) {
+                free_event_source_(self, i);
+        }
+    }
+}
+
+//--- Reactor interface implementation --------------------------------------------------------
+
+static
+int add_event_handler_(struct reactor *self, struct event_handler *event_handler,
+                        enum react_handler_mode handler_mode,
+                        enum react_handler_ownership handler_ownership)
+{
+    struct reactor_uring *reactor;
+    struct event_source_ *event_src;
+    char handler_name[MAX_NAMES];
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_uring *)self;
+
+    // Try to add the event handler to the repository
+    for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
+        event_src = &reactor->events_sources[i];
+
+        if (!event_src->active) {
+
+            // Add event source to the event repository
+            event_src->handler = event_handler;
+            event_src->ownership = handler_ownership;
+            event_src->active = 1;
+
+            switch (handler_mode) {
+                case REACT_PRI_HANDLER:
+                    event_src->poll_mask = POLLPRI | POLLERR;
+                    event_src->multishot = 1;
+                    break;
+                // Level-triggered, edge handlers are just served more often.
+                // Events are served in the order they are reported
+                case REACT_EDGE_HANDLER:
+                case REACT_HW_HANDLER:
+                case REACT_NORMAL_HANDLER:
+                default:
+                    event_src->poll_mask = POLLIN;
+                    event_src->multishot = 0;
+                    break;
+            }
+
+            // Get handler name
+            event_handler_get_name(event_handler, handler_name, MAX_NAMES);
+
+            DBG_PRINT("fred_sys: uring reactor: adding event handler: %s\n",
+                        handler_name);
+
+            // Will be submitted with the next io_uring_enter
+            if (arm_event_source_(reactor, i)) {
+                ERROR_PRINT("fred_sys: uring reactor: could not add event!\n");
+                clear_event_source_(reactor, i);
+                return -1;
+            }
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static
+int remove_event_handler_(struct reactor *self, struct event_handler *event_handler)
+{
+    struct reactor_uring *reactor;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_uring *)self;
+
+    for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
+        if (reactor->events_sources[i].active &&
+            reactor->events_sources[i].handler == event_handler) {
+
+            if (reactor->events_sources[i].ownership == REACT_OWNED)
+                free_event_source_(reactor, i);
+            else
+                clear_event_source_(reactor, i);
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static
+int set_interest_(struct reactor *self, struct event_handler *event_handler, int interest)
+{
+    struct reactor_uring *reactor;
+    struct event_source_ *event_src;
+    struct io_uring_sqe *sqe;
+
+    assert(self);
+    assert(event_handler);
+
+    reactor = (struct reactor_uring *)self;
+
+    for (int i = 0; i < MAX_EVENTS_SRCS; ++i) {
+        event_src = &reactor->events_sources[i];
+
+        if (event_src->active && event_src->handler == event_handler) {
+            event_src->poll_mask = 0;
+            if (interest & REACT_INTEREST_IN)
+                event_src->poll_mask |= POLLIN;
+            if (interest & REACT_INTEREST_OUT)
+                event_src->poll_mask |= POLLOUT;
+
+            // Not armed while being dispatched, the new mask is used when re-armed
+            if (!event_src->armed)
+                return 0;
+
+            // Otherwise replace the pending poll, its completion becomes stale
+            sqe = get_sqe_(reactor);
+            if (!sqe)
+                return -1;
+
+            sqe->opcode = IORING_OP_POLL_REMOVE;
+            sqe->fd = -1;
+            sqe->addr = source_udata_(reactor, i);
+            sqe->user_data = URING_IGNORE_UDATA;
+
+            event_src->gen++;
+
+            return arm_event_source_(reactor, i);
+        }
+    }
+
+    return -1;
+}
+
+static
+void event_loop_(struct reactor *self)
+{
+    struct reactor_uring *reactor;
+    struct event_source_ *event_src;
+    int retval;
+    unsigned int head;
+    unsigned int tail;
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+    uint32_t gen;
+    int idx;
+
+    assert(self);
+
+    reactor = (struct reactor_uring *)self;
+
+    while (1) {
+        // Submit re-arm requests and wait for at least one completion
+        retval = io_uring_enter_(reactor->ring_fd, reactor->to_submit, 1,
+                                    IORING_ENTER_GETEVENTS);
+        if (retval < 0) {
+            if (errno == EINTR)
+                continue;
+            ERROR_PRINT("fred_sys: uring reactor: io_uring_enter error %s\n",
+                        strerror(errno));
+            goto exit_clear;
+        }
+        reactor->to_submit -= retval;
+
+        reactor->wakeups++;
+
+        // Harvest the whole batch of completions
+        head = *reactor->cq_head;
+        tail = __atomic_load_n(reactor->cq_tail, __ATOMIC_ACQUIRE);
+
+        while (head != tail) {
+            user_data = reactor->cqes[head & *reactor->cq_mask].user_data;
+            res = reactor->cqes[head & *reactor->cq_mask].res;
+            flags = reactor->cqes[head & *reactor->cq_mask].flags;
+            head++;
+
+            // Release the entry before dispatching
+            __atomic_store_n(reactor->cq_head, head, __ATOMIC_RELEASE);
+
+            if (user_data == URING_IGNORE_UDATA)
+                continue;
+
+            idx = (int)(user_data & 0xffffffffU);
+            gen = (uint32_t)(user_data >> 32);
+            event_src = &reactor->events_sources[idx];
+
+            // Stale completion of a removed handler
+            if (!event_src->active || event_src->gen != gen)
+                continue;
+
+            // One-shot or terminated multishot poll
+            if (!(flags & IORING_CQE_F_MORE))
+                event_src->armed = 0;
+
+            if (res < 0) {
+                ERROR_PRINT("fred_sys: uring reactor: poll error %s\n", strerror(-res));
+                goto exit_clear;
+
+            } else if ((res & (POLLERR | POLLNVAL)) && !(res & POLLPRI)) {
+                ERROR_PRINT("fred_sys: uring reactor: poll error event\n");
+                goto exit_clear;
+            }
+
+            reactor->events++;
+
+            // Handle event, output first since it may make room for the input
+            retval = 0;
+            if (res & POLLOUT)
+                retval = event_handler_handle_output(event_src->handler);
+            if (!retval && (res & ~POLLOUT))
+                retval = event_handler_handle_event(event_src->handler);
+
+            // Single client error -> detach handler
+            if (retval > 0) {
+                free_event_source_(reactor, idx);
+                continue;
+
+            // System error -> shutdown
+            } else if (retval < 0) {
+                goto exit_clear;
+            }
+
+            // Re-arm if still registered (the handler may have removed itself)
+            if (event_src->active && event_src->gen == gen && !event_src->armed) {
+                if (arm_event_source_(reactor, idx))
+                    goto exit_clear;
+            }
+        }
+    }
+
+exit_clear:
+    ERROR_PRINT("fred_sys: uring reactor: shutting down event loop\n");
+    DBG_PRINT("fred_sys: uring reactor: %"PRIu64" wakeups, %"PRIu64" events\n",
+                reactor->wakeups, reactor->events);
+    free_all_events_source_(reactor);
+}
+
+static
+void free_(struct reactor *self)
+{
+    struct reactor_uring *reactor;
+
+    if (!self)
+        return;
+
+    reactor = (struct reactor_uring *)self;
+
+    free_all_events_source_(reactor);
+
+    if (reactor->sqes)
+        munmap(reactor->sqes, reactor->sqes_size);
+    if (reactor->cq_ptr && reactor->cq_ptr != reactor->sq_ptr)
+        munmap(reactor->cq_ptr, reactor->cq_size);
+    if (reactor->sq_ptr)
+        munmap(reactor->sq_ptr, reactor->sq_size);
+
+    close(reactor->ring_fd);
+
+    free(reactor);
+}
+
+//---------------------------------------------------------------------------------------------
+
+static
+int map_rings_(struct reactor_uring *self, const struct io_uring_params *params)
+{
+    void *ptr;
+
+    self->sq_size = params->sq_off.array + params->sq_entries * sizeof(unsigned int);
+    self->cq_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+
+    // Both rings can be mapped with a single mmap
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (self->cq_size > self->sq_size)
+            self->sq_size = self->cq_size;
+        self->cq_size = self->sq_size;
+    }
+
+    ptr = mmap(NULL, self->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                self->ring_fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED)
+        return -1;
+    self->sq_ptr = ptr;
+
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        self->cq_ptr = self->sq_ptr;
+    } else {
+        ptr = mmap(NULL, self->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    self->ring_fd, IORING_OFF_CQ_RING);
+        if (ptr == MAP_FAILED)
+            return -1;
+        self->cq_ptr = ptr;
+    }
+
+    self->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ptr = mmap(NULL, self->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                self->ring_fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED)
+        return -1;
+    self->sqes = ptr;
+
+    self->sq_head = (unsigned int *)((char *)self->sq_ptr + params->sq_off.head);
+    self->sq_tail = (unsigned int *)((char *)self->sq_ptr + params->sq_off.tail);
+    self->sq_mask = (unsigned int *)((char *)self->sq_ptr + params->sq_off.ring_mask);
+    self->sq_array = (unsigned int *)((char *)self->sq_ptr + params->sq_off.array);
+    self->sq_entries = params->sq_entries;
+
+    self->cq_head = (unsigned int *)((char *)self->cq_ptr + params->cq_off.head);
+    self->cq_tail = (unsigned int *)((char *)self->cq_ptr + params->cq_off.tail);
+    self->cq_mask = (unsigned int *)((char *)self->cq_ptr + params->cq_off.ring_mask);
+    self->cqes = (struct io_uring_cqe *)((char *)self->cq_ptr + params->cq_off.cqes);
+
+    return 0;
+}
+
+int reactor_uring_init(struct reactor **self)
+{
+    struct reactor_uring *reactor;
+    struct io_uring_params params;
+    int retval;
+
+    *self = NULL;
+
+    // Allocate and set everything to zero
+    reactor = calloc(1, sizeof(*reactor));
+    if (!reactor)
+        return -1;
+
+    memset(&params, 0, sizeof(params));
+
+    reactor->ring_fd = io_uring_setup_(URING_ENTRIES, &params);
+    if (reactor->ring_fd < 0) {
+        ERROR_PRINT("fred_sys: uring reactor: io_uring_setup error %s\n", strerror(errno));
+        free(reactor);
+        return -1;
+    }
+
+    retval = map_rings_(reactor, &params);
+    if (retval) {
+        ERROR_PRINT("fred_sys: uring reactor: unable to map rings %s\n", strerror(errno));
+        free_(&reactor->reactor);
+        return -1;
+    }
+
+    // Reactor interface
+    reactor->reactor.add_event_handler = add_event_handler_;
+    reactor->reactor.remove_event_handler = remove_event_handler_;
+    reactor->reactor.set_interest = set_interest_;
+    reactor->reactor.event_loop = event_loop_;
+    reactor->reactor.free = free_;
+
+    *self = &reactor->reactor;
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <stdlib.h>
+
+#include "req_heap.h"
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int precedes_(const struct accel_req *req, const struct accel_req *other)
+{
+    if (req->heap_key != other->heap_key)
+        return req->heap_key < other->heap_key;
+
+    return accel_req_compare_timestamps(req, other) < 0;
+}
+
+static inline
+void place_(struct req_heap *self, struct accel_req *request, int idx)
+{
+    self->reqs[idx] = request;
+    request->heap_idx = idx;
+}
+
+static
+void sift_up_(struct req_heap *self, int idx)
+{
+    struct accel_req *request;
+    int parent;
+
+    request = self->reqs[idx];
+
+    while (idx > 0) {
+        parent = (idx - 1) / 2;
+        if (!precedes_(request, self->reqs[parent]))
+            break;
+
+        place_(self, self->reqs[parent], idx);
+        idx = parent;
+    }
+
+    place_(self, request, idx);
+}
+
+static
+void sift_down_(struct req_heap *self, int idx)
+{
+    struct accel_req *request;
+    int child;
+
+    request = self->reqs[idx];
+
+    while ((child = 2 * idx + 1) < self->count) {
+        // Pick the smallest child
+        if (child + 1 < self->count && precedes_(self->reqs[child + 1], self->reqs[child]))
+            child++;
+
+        if (!precedes_(self->reqs[child], request))
+            break;
+
+        place_(self, self->reqs[child], idx);
+        idx = child;
+    }
+
+    place_(self, request, idx);
+}
+
+//---------------------------------------------------------------------------------------------
+
+int req_heap_push(struct req_heap *self, struct accel_req *request)
+{
+    struct accel_req **reqs;
+
+    assert(self);
+    assert(request);
+
+    if (self->count == self->capacity) {
+        reqs = realloc(self->reqs, 2 * self->capacity * sizeof(*reqs));
+        if (!reqs)
+            return -1;
+
+        self->reqs = reqs;
+        self->capacity *= 2;
+    }
+
+    place_(self, request, self->count++);
+    sift_up_(self, request->heap_idx);
+
+    return 0;
+}
+
+struct accel_req *req_heap_pop(struct req_heap *self)
+{
+    struct accel_req *request;
+
+    assert(self);
+
+    if (!self->count)
+        return NULL;
+
+    request = self->reqs[0];
+    req_heap_remove(self, request);
+
+    return request;
+}
+
+void req_heap_remove(struct req_heap *self, struct accel_req *request)
+{
+    struct accel_req *last;
+    int idx;
+
+    assert(self);
+    assert(request);
+
+    idx = request->heap_idx;
+
+    assert(idx >= 0 && idx < self->count);
+    assert(self->reqs[idx] == request);
+
+    request->heap_idx = -1;
+
+    // Move the last element in the hole and restore the heap property
+    last = self->reqs[--self->count];
+    if (last == request)
+        return;
+
+    place_(self, last, idx);
+
+    if (idx > 0 && precedes_(last, self->reqs[(idx - 1) / 2]))
+        sift_up_(self, idx);
+    else
+        sift_down_(self, idx);
+}
+
+struct accel_req *req_heap_pop_lookahead(struct req_heap *self, const struct hw_task *hw_task,
+                                            int window, int aging_limit)
+{
+    struct accel_req *ahead[MAX_PART_QUEUE_LOOKAHEAD];
+    struct accel_req *request;
+    struct accel_req *match = NULL;
+    int ahead_count = 0;
+
+    assert(self);
+    assert(window <= MAX_PART_QUEUE_LOOKAHEAD);
+
+    if (!hw_task || window < 2 || !self->count ||
+        accel_req_get_hw_task(self->reqs[0]) == hw_task)
+        return req_heap_pop(self);
+
+    // Scan the window in order, stopping at a request that cannot be bypassed again
+    while (ahead_count < window && self->count) {
+        request = req_heap_pop(self);
+
+        if (accel_req_get_hw_task(request) == hw_task) {
+            match = request;
+            break;
+        }
+
+        ahead[ahead_count++] = request;
+
+        if (request->bypassed >= aging_limit)
+            break;
+    }
+
+    // Put back the requests ahead, the heap does not grow
+    for (int i = 0; i < ahead_count; ++i) {
+        if (match)
+            ahead[i]->bypassed++;
+
+        req_heap_push(self, ahead[i]);
+    }
+
+    return match ? match : req_heap_pop(self);
+}
+
+int req_heap_init(struct req_heap *self, int capacity)
+{
+    assert(self);
+    assert(capacity > 0);
+
+    self->reqs = calloc(capacity, sizeof(*self->reqs));
+    if (!self->reqs)
+        return -1;
+
+    self->count = 0;
+    self->capacity = capacity;
+
+    return 0;
+}
+
+void req_heap_free(struct req_heap *self)
+{
+    if (!self)
+        return;
+
+    free(self->reqs);
+    self->reqs = NULL;
+    self->count = 0;
+    self->capacity = 0;
+}
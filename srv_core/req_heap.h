@@ -0,0 +1,90 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef REQ_HEAP_H_
+#define REQ_HEAP_H_
+
+#include <assert.h>
+#include <stddef.h>
+
+#include "accel_req.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Binary min-heap of acceleration requests ordered by heap key, ties are broken
+// by arrival time. Each request keeps its position to allow O(log n) removal.
+struct req_heap {
+    struct accel_req **reqs;
+    int count;
+    int capacity;
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int req_heap_is_empty(const struct req_heap *self)
+{
+    assert(self);
+
+    return self->count == 0;
+}
+
+static inline
+int req_heap_get_count(const struct req_heap *self)
+{
+    assert(self);
+
+    return self->count;
+}
+
+static inline
+struct accel_req *req_heap_peek(const struct req_heap *self)
+{
+    assert(self);
+
+    return self->count ? self->reqs[0] : NULL;
+}
+
+// The position kept by the request is checked against the heap,
+// the request may be in another heap (or in none)
+static inline
+int req_heap_contains(const struct req_heap *self, const struct accel_req *request)
+{
+    assert(self);
+    assert(request);
+
+    return request->heap_idx >= 0 && request->heap_idx < self->count &&
+            self->reqs[request->heap_idx] == request;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int req_heap_init(struct req_heap *self, int capacity);
+
+void req_heap_free(struct req_heap *self);
+
+// Grows the heap if necessary, returns -1 if out of memory
+int req_heap_push(struct req_heap *self, struct accel_req *request);
+
+struct accel_req *req_heap_pop(struct req_heap *self);
+
+void req_heap_remove(struct req_heap *self, struct accel_req *request);
+
+// Pop the first request for hw_task among the window heading the heap, if it can
+// be reached without bypassing a request more than aging_limit times. Otherwise,
+// or if hw_task is NULL, pop the head
+struct accel_req *req_heap_pop_lookahead(struct req_heap *self, const struct hw_task *hw_task,
+                                            int window, int aging_limit);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* REQ_HEAP_H_ */
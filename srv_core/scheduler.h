@@ -32,6 +32,10 @@ struct scheduler {
 
     int (*slot_timeout)(struct scheduler *self, struct accel_req *request);
 
+    // Drop a request not started yet, notified as cancelled (possibly later, when
+    // the scheduler gets hold of it). A request already started is completed
+    int (*cancel_accel_req)(struct scheduler *self, struct accel_req *request);
+
     void (*free)(struct scheduler *self);
 };
 
@@ -69,6 +73,14 @@ int scheduler_slot_timeout(struct scheduler *self, struct accel_req *request)
     return self->slot_timeout(self, request);
 }
 
+static inline
+int scheduler_cancel_accel_req(struct scheduler *self, struct accel_req *request)
+{
+    assert(self);
+
+    return self->cancel_accel_req(self, request);
+}
+
 static inline
 void scheduler_free(struct scheduler *self)
 {
@@ -21,6 +21,14 @@
 
 //---------------------------------------------------------------------------------------------
 
+// Initial capacity of the partition queues, they grow on demand
+#define PART_QUEUE_INIT_SIZE    16
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int start_slot_(struct scheduler_fred *self, struct accel_req *request);
+
 static inline
 int start_slot_after_rcfg_(struct scheduler_fred *self, struct accel_req *request_done);
 
@@ -31,57 +39,244 @@ static inline
 int push_req_fri_queue_(struct scheduler_fred *self, struct accel_req *request);
 
 static inline
-int pull_req_partition_queue_(struct scheduler_fred *self, struct accel_req *request_done);
+int dispatch_req_(struct scheduler_fred *self, struct accel_req *request);
+
+static inline
+int pull_req_partition_queue_(struct scheduler_fred *self, struct slot *slot,
+                                struct slot_timer *timer, struct partition *partition);
+
+static inline
+int pop_fri_queue_(struct scheduler_fred *self, struct accel_req **request);
+
+static inline
+int try_prefetch_(struct scheduler_fred *self);
+
+static inline
+int drop_reserved_req_(struct scheduler_fred *self, struct accel_req *request,
+                        enum notify_action_msg msg);
+
+static
+int sched_fred_push_accel_req_(struct scheduler *self, struct accel_req *request);
 
 //---------------------------------------------------------------------------------------------
 
 static inline
-int start_slot_after_rcfg_(struct scheduler_fred *self, struct accel_req *request_done)
+int start_slot_(struct scheduler_fred *self, struct accel_req *request)
 {
     int retval;
     struct hw_task *hw_task;
     struct slot *slot;
     struct slot_timer *timer;
-    struct accel_req *next_request;
 
-    hw_task = accel_req_get_hw_task(request_done);
-    slot = accel_req_get_slot(request_done);
-    timer = accel_req_get_timer(request_done);
+    hw_task = accel_req_get_hw_task(request);
+    slot = accel_req_get_slot(request);
+    timer = accel_req_get_timer(request);
 
     assert(hw_task);
     assert(slot);
     assert(timer);
 
+    accel_req_disarm_deadline(request);
+
+    // The previous stage of the chain is still running, hold the slot
+    if (accel_req_get_chain_wait(request)) {
+        logger_log(LOG_LEV_FULL,"\tfred_sys: slot: %d of partition: %s"
+                                " ready for hw-task: %s, waiting for the previous stage",
+                                slot_get_index(slot),
+                                partition_get_name(hw_task_get_partition(hw_task)),
+                                hw_task_get_name(hw_task));
+
+        request->chain_parked = 1;
+        return 0;
+    }
+
+    if (accel_req_get_cancelled(request))
+        return drop_reserved_req_(self, request, NOTIFY_ACTION_CANCELLED);
+
+    if (request->chain_abort)
+        return drop_reserved_req_(self, request, NOTIFY_ACTION_ABORTED);
+
     // Start the hardware accelerator
-    retval = slot_start_compute(slot, request_done);
+    retval = slot_start_compute(slot, request);
     if (retval)
         return -1;
 
     // And arm the watchdog timer
-    retval = slot_timer_arm(timer, hw_task_get_timeout_us(hw_task), request_done);
+    retval = slot_timer_arm(timer, hw_task_get_timeout_us(hw_task), request);
     if (retval)
         return -1;
 
     logger_log(LOG_LEV_FULL,"\tfred_sys: slot: %d of partition: %s"
                             " started for hw-task: %s",
                             slot_get_index(slot),
-                            partition_get_name(hw_task_get_partition(
-                                accel_req_get_hw_task(request_done))),
-                            hw_task_get_name(accel_req_get_hw_task(request_done)));
+                            partition_get_name(hw_task_get_partition(hw_task)),
+                            hw_task_get_name(hw_task));
 
-    // If the FRI queue is not empty start next reconfiguration
-    if (!TAILQ_EMPTY(&self->fri_queue_head)) {
+    // The slot of the next stage of the chain can be prepared meanwhile
+    if (accel_req_get_chain_next(request))
+        return sched_fred_push_accel_req_(&self->scheduler, accel_req_get_chain_next(request));
 
-        // Get the head request from the FRI queue
-        next_request = TAILQ_FIRST(&self->fri_queue_head);
+    return 0;
+}
 
-        // Remove the head request from the FRI queue
-        TAILQ_REMOVE(&self->fri_queue_head, next_request, queue_elem);
+// Unlink a cancelled (or aborted) request from the partition or the FRI queue, the
+// slot reserved in the latter goes to the partition queue. Elsewhere the request is
+// dropped by start_slot_() (or completed if already started)
+static inline
+int drop_queued_req_(struct scheduler_fred *self, struct accel_req *request,
+                        enum notify_action_msg msg)
+{
+    int retval;
+    struct slot *slot;
+    struct slot_timer *timer;
+    struct partition *partition;
+    struct req_heap *part_queue;
+
+    partition = hw_task_get_partition(accel_req_get_hw_task(request));
+    part_queue = &self->part_queues[partition_get_index(partition)];
+
+    accel_req_disarm_deadline(request);
+
+    if (req_heap_contains(part_queue, request)) {
+        req_heap_remove(part_queue, request);
+
+        return accel_req_notify_action(request, msg) ? -1 : 0;
+    }
+
+    if (!fri_queue_contains(&self->fri_queue, request))
+        return 0;
+
+    fri_queue_remove(&self->fri_queue, request);
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: request for hw-task: %s dropped while queued",
+                            hw_task_get_name(accel_req_get_hw_task(request)));
+
+    slot = accel_req_get_slot(request);
+    timer = accel_req_get_timer(request);
+    slot_release_reserved(slot);
+
+    // The request goes back to the client on notification
+    retval = accel_req_notify_action(request, msg);
+    if (retval)
+        return -1;
+
+    return pull_req_partition_queue_(self, slot, timer, partition);
+}
+
+// The deadline of a queued request passed
+static
+int deadline_expired_(struct wheel_timer *self)
+{
+    struct req_deadline_timer *timer;
+
+    assert(self);
+
+    timer = (struct req_deadline_timer *)self;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: request for hw-task: %s expired while queued",
+                            hw_task_get_name(accel_req_get_hw_task(timer->request)));
+
+    return drop_queued_req_(timer->owner, timer->request, NOTIFY_ACTION_EXPIRED);
+}
+
+static inline
+int arm_deadline_(struct scheduler_fred *self, struct accel_req *request)
+{
+    if (!self->timer_wheel)
+        return 0;
+
+    return accel_req_arm_deadline(request, self->timer_wheel, deadline_expired_, self);
+}
+
+// The previous stage of the chain completed or failed
+static inline
+int release_chain_next_(struct scheduler_fred *self, struct accel_req *request, int abort)
+{
+    struct partition *partition;
+
+    accel_req_release_chain_wait(request, abort);
+
+    if (!request->chain_parked) {
+        // Held until now to be notified after the previous stage
+        if (accel_req_get_cancelled(request))
+            return drop_queued_req_(self, request, NOTIFY_ACTION_CANCELLED);
+
+        // Do not let it take a slot and a reconfiguration for nothing
+        if (abort)
+            return drop_queued_req_(self, request, NOTIFY_ACTION_ABORTED);
+
+        // It can expire from now on
+        partition = hw_task_get_partition(accel_req_get_hw_task(request));
+
+        if (req_heap_contains(&self->part_queues[partition_get_index(partition)], request) ||
+            fri_queue_contains(&self->fri_queue, request))
+            return arm_deadline_(self, request);
+
+        return 0;
+    }
+
+    request->chain_parked = 0;
 
+    return start_slot_(self, request);
+}
+
+// The request got its slot but it has been cancelled, or the previous stage
+// of the chain failed
+static inline
+int drop_reserved_req_(struct scheduler_fred *self, struct accel_req *request,
+                        enum notify_action_msg msg)
+{
+    int retval;
+    struct slot *slot;
+    struct slot_timer *timer;
+    struct partition *partition;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: dropping request for hw-task: %s before start",
+                            hw_task_get_name(accel_req_get_hw_task(request)));
+
+    slot = accel_req_get_slot(request);
+    timer = accel_req_get_timer(request);
+    partition = hw_task_get_partition(accel_req_get_hw_task(request));
+
+    slot_release_reserved(slot);
+
+    // The request goes back to the client on notification
+    retval = accel_req_notify_action(request, msg);
+    if (retval)
+        return -1;
+
+    return pull_req_partition_queue_(self, slot, timer, partition);
+}
+
+static inline
+int start_slot_after_rcfg_(struct scheduler_fred *self, struct accel_req *request_done)
+{
+    int retval;
+    struct accel_req *next_request;
+
+    retval = start_slot_(self, request_done);
+    if (retval)
+        return -1;
+
+    // Starting a chain stage may have already started the next reconfiguration
+    if (!devcfg_is_idle(self->devcfg))
+        return 0;
+
+    // Get and remove the head request from the FRI queue
+    retval = pop_fri_queue_(self, &next_request);
+    if (retval)
+        return -1;
+
+    // If the FRI queue is not empty start next reconfiguration
+    if (next_request) {
         logger_log(LOG_LEV_PEDANTIC,"\tfred_sys: FRI queue not empty");
 
         // Start reconfiguration
         retval = start_rcfg_(self, next_request);
+
+    // Otherwise the devcfg is free for a speculative reconfiguration
+    } else {
+        retval = try_prefetch_(self);
     }
 
     return retval;
@@ -93,6 +288,8 @@ int start_rcfg_(struct scheduler_fred *self, struct accel_req *request)
 {
     int retval;
 
+    accel_req_disarm_deadline(request);
+
     // If the slot already contains the hw-task
     if (accel_req_get_skip_rcfg(request)) {
         logger_log(LOG_LEV_FULL,"\tfred_sys: skipping rcfg of slot: %d"
@@ -121,94 +318,362 @@ int start_rcfg_(struct scheduler_fred *self, struct accel_req *request)
     return retval;
 }
 
-static inline
-void ins_req_ordered_(struct accel_req_queue *queue_head, struct accel_req *new_request)
-{
-    struct accel_req *req = NULL;
-
-    // If queue is empty
-    if (TAILQ_EMPTY(queue_head)) {
-        TAILQ_INSERT_HEAD(queue_head, new_request, queue_elem);
-        return;
-    }
-
-    // Fri queue contains at least one element
-    TAILQ_FOREACH(req, queue_head, queue_elem) {
-        if (accel_req_compare_timestamps(req, new_request) == 1)
-            break;
-    }
-
-    // Last
-    if (req == NULL)
-        TAILQ_INSERT_TAIL(queue_head, new_request, queue_elem);
-    else
-        TAILQ_INSERT_BEFORE(req, new_request, queue_elem);
-}
-
-//TODO: integrate the function above to avoid insert and remove
 static inline
 int push_req_fri_queue_(struct scheduler_fred *self, struct accel_req *request)
 {
     int retval = 0;
 
-    // Insert the request directly into FRI queue
-    ins_req_ordered_(&self->fri_queue_head, request);
+    // Insert the request into FRI queue
+    retval = fri_queue_push(&self->fri_queue, request);
+    if (retval)
+        return -1;
 
     // If the inserted request is on top of FRI queue
     // and the DEVCFG is IDLE (not programming)
     if (devcfg_is_idle(self->devcfg) &&
-        TAILQ_FIRST(&self->fri_queue_head) == request) {
+        fri_queue_peek(&self->fri_queue) == request) {
 
         logger_log(LOG_LEV_PEDANTIC,"\tfred_sys: DevCfg idle & request on top");
 
         // Remove the head request from the FRI queue
-        TAILQ_REMOVE(&self->fri_queue_head, request, queue_elem);
+        fri_queue_pop(&self->fri_queue);
 
         // Start reconfiguration
         retval = start_rcfg_(self, request);
+
+    // Waiting for the devcfg (possibly armed in the partition queue already)
+    } else {
+        retval = arm_deadline_(self, request);
     }
 
     return retval;
 }
 
+// Hand over a request with a reserved slot. In fast skip mode, if the slot
+// already holds the hw-task, start it now instead of waiting in the FRI queue
 static inline
-int pull_req_partition_queue_(struct scheduler_fred *self, struct accel_req *request_done)
+int dispatch_req_(struct scheduler_fred *self, struct accel_req *request)
 {
-    int retval = 0;
+    if (self->mode == SCHED_FRED_FAST_SKIP && accel_req_get_skip_rcfg(request)) {
+        logger_log(LOG_LEV_FULL,"\tfred_sys: fast start on slot: %d"
+                                " of partition: %s for hw-task: %s",
+                                slot_get_index(accel_req_get_slot(request)),
+                                partition_get_name(hw_task_get_partition(
+                                        accel_req_get_hw_task(request))),
+                                hw_task_get_name(accel_req_get_hw_task(request)));
 
-    struct accel_req *request;
-    struct accel_req_queue *part_queue_head;
+        return start_slot_(self, request);
+    }
 
-    struct slot *slot;
-    struct slot_timer *timer;
-    struct partition *partition;
+    // Push request into FRI queue. If request goes on top of FRI queue
+    // and devcfg is idle start reconfiguration immediately
+    return push_req_fri_queue_(self, request);
+}
 
-    // Get the slot freed from the request that has been completed
-    slot = accel_req_get_slot(request_done);
-    timer = accel_req_get_timer(request_done);
-    partition = hw_task_get_partition(accel_req_get_hw_task(request_done));
+// The request missed its deadline while queued
+static inline
+int expire_req_(struct accel_req *request)
+{
+    accel_req_disarm_deadline(request);
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: request for hw-task: %s expired while queued",
+                            hw_task_get_name(accel_req_get_hw_task(request)));
+
+    return accel_req_notify_action(request, NOTIFY_ACTION_EXPIRED);
+}
+
+static inline
+int push_part_queue_(struct scheduler_fred *self, struct partition *partition,
+                        struct accel_req *request)
+{
+    int retval;
+
+    request->heap_key = accel_req_get_edf_key(request);
+
+    retval = req_heap_push(&self->part_queues[partition_get_index(partition)], request);
+    if (retval)
+        return -1;
+
+    return arm_deadline_(self, request);
+}
+
+// Reserve a free slot for the most urgent request in the partition queue.
+// Requests whose deadline has passed are expired on the way
+static inline
+int reserve_slot_part_queue_(struct scheduler_fred *self, struct slot *slot,
+                                struct slot_timer *timer, struct partition *partition,
+                                struct accel_req **request)
+{
+    int retval;
+    struct req_heap *part_queue;
+    struct accel_req *next_request;
+
+    *request = NULL;
+
+    part_queue = &self->part_queues[partition_get_index(partition)];
 
     // Check if there are pending requests in the partition queue (queue not empty)
-    part_queue_head = &self->part_queues_heads[partition_get_index(partition)];
-    if (!TAILQ_EMPTY(part_queue_head)) {
+    while (!req_heap_is_empty(part_queue)) {
+
+        // Get and remove the head request from the partition queue, or a request
+        // close to the head that can reuse the hw-task left in the slot
+        next_request = req_heap_pop_lookahead(part_queue, slot_get_idle_hw_task(slot),
+                                                self->lookahead, self->aging_limit);
+
+        if (accel_req_is_expired(next_request)) {
+            retval = expire_req_(next_request);
+            if (retval)
+                return -1;
 
-        // Get the head request from the partition FIFO queue
-        request = TAILQ_FIRST(part_queue_head);
+            continue;
+        }
 
-        // Remove the request from the partition FIFO queue
-        TAILQ_REMOVE(part_queue_head, request, queue_elem);
+        // The slot may still hold the hw-task
+        if (slot_match_hw_task(slot, accel_req_get_hw_task(next_request)) &&
+            self->mode != SCHED_FRED_ALWAYS_RCFG)
+            accel_req_set_skip_rcfg(next_request);
 
         // Reserve the slot for the HW-task
         slot_set_reserved(slot);
-        accel_req_set_slot(request, slot);
-        accel_req_set_timer(request, timer);
+        accel_req_set_slot(next_request, slot);
+        accel_req_set_timer(next_request, timer);
 
-        // Push request into FRI queue. If request goes on top of FRI queue
-        // and devcfg is idle start reconfiguration immediately
-        retval = push_req_fri_queue_(self, request);
+        *request = next_request;
+        break;
     }
 
-    return retval;
+    return 0;
+}
+
+// Get and remove the head request from the FRI queue. The slot reserved by an
+// expired request is handed over to its partition queue, nothing is started
+// (unless it can be started without reconfiguration, which in turn may hand a
+// chain stage to the devcfg, then no request is returned)
+static inline
+int pop_fri_queue_(struct scheduler_fred *self, struct accel_req **request)
+{
+    int retval;
+    struct accel_req *next_request;
+    struct slot *slot;
+    struct slot_timer *timer;
+    struct partition *partition;
+
+    *request = NULL;
+
+    while (devcfg_is_idle(self->devcfg) && !fri_queue_is_empty(&self->fri_queue)) {
+        next_request = fri_queue_pop(&self->fri_queue);
+
+        if (!accel_req_is_expired(next_request)) {
+            *request = next_request;
+            break;
+        }
+
+        // The request goes back to the client on notification
+        slot = accel_req_get_slot(next_request);
+        timer = accel_req_get_timer(next_request);
+        partition = hw_task_get_partition(accel_req_get_hw_task(next_request));
+
+        retval = expire_req_(next_request);
+        if (retval)
+            return -1;
+
+        slot_release_reserved(slot);
+
+        retval = reserve_slot_part_queue_(self, slot, timer, partition, &next_request);
+        if (retval)
+            return -1;
+
+        if (!next_request)
+            continue;
+
+        if (self->mode == SCHED_FRED_FAST_SKIP && accel_req_get_skip_rcfg(next_request)) {
+            retval = start_slot_(self, next_request);
+        } else {
+            retval = fri_queue_push(&self->fri_queue, next_request);
+            if (!retval)
+                retval = arm_deadline_(self, next_request);
+        }
+        if (retval)
+            return -1;
+    }
+
+    return 0;
+}
+
+// Give the slot freed by a request to the partition queue. The request is not
+// referenced: once notified it may have been released together with its client
+static inline
+int pull_req_partition_queue_(struct scheduler_fred *self, struct slot *slot,
+                                struct slot_timer *timer, struct partition *partition)
+{
+    int retval;
+    struct accel_req *request;
+
+    retval = reserve_slot_part_queue_(self, slot, timer, partition, &request);
+    if (retval)
+        return -1;
+
+    if (!request)
+        return 0;
+
+    return dispatch_req_(self, request);
+}
+
+// Speculatively configure a free slot with the hw-task most likely to be requested
+// next. Started only when the devcfg is idle and the FRI queue is empty. A request
+// arriving meanwhile either gets another free slot or takes over the prefetched one,
+// hence it waits for at most one reconfiguration before its own, as it would if
+// another request were already being reconfigured
+static inline
+int try_prefetch_(struct scheduler_fred *self)
+{
+    struct hw_task *hw_task;
+    struct partition *partition;
+    struct slot *slot;
+    struct slot_timer *timer;
+
+    if (!self->prefetch || self->spec_active)
+        return 0;
+
+    if (!devcfg_is_idle(self->devcfg) || !fri_queue_is_empty(&self->fri_queue))
+        return 0;
+
+    hw_task = prefetcher_predict(&self->prefetcher, &partition);
+    if (!hw_task)
+        return 0;
+
+    partition_search_slot(partition, &slot, &timer, hw_task);
+    if (!slot)
+        return 0;
+
+    // Reserve the slot for the speculative request
+    slot_set_reserved(slot);
+
+    accel_req_unbind(&self->spec_req);
+    accel_req_set_hw_task(&self->spec_req, hw_task);
+    accel_req_set_slot(&self->spec_req, slot);
+    accel_req_set_timer(&self->spec_req, timer);
+
+    self->spec_active = 1;
+    self->spec_claim = NULL;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: prefetch rcfg of slot: %d"
+                            " of partition: %s for hw-task: %s",
+                            slot_get_index(slot), partition_get_name(partition),
+                            hw_task_get_name(hw_task));
+
+    slot_prepare_for_rcfg(slot);
+
+    return devcfg_start_prog(self->devcfg, &self->spec_req);
+}
+
+// Give the slot being speculatively configured to a request for the same hw-task
+static inline
+int claim_prefetch_(struct scheduler_fred *self, struct accel_req *request)
+{
+    struct hw_task *hw_task;
+
+    hw_task = accel_req_get_hw_task(request);
+
+    // An idle slot already holding the hw-task is a better choice
+    if (!self->spec_active || self->spec_claim || hw_task_get_resident_mask(hw_task) ||
+        accel_req_get_hw_task(&self->spec_req) != hw_task)
+        return 0;
+
+    accel_req_set_slot(request, accel_req_get_slot(&self->spec_req));
+    accel_req_set_timer(request, accel_req_get_timer(&self->spec_req));
+    self->spec_claim = request;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: hw-task: %s claimed prefetch slot: %d",
+                            hw_task_get_name(hw_task),
+                            slot_get_index(accel_req_get_slot(request)));
+
+    return 1;
+}
+
+// A request finding no free slot in the partition takes over the slot being
+// speculatively configured, as it would have reserved it without the prefetch.
+// Its own hw-task is configured once the prefetch completes
+static inline
+int take_over_prefetch_(struct scheduler_fred *self, struct accel_req *request)
+{
+    struct hw_task *hw_task;
+
+    hw_task = accel_req_get_hw_task(request);
+
+    if (!self->spec_active || self->spec_claim ||
+        hw_task_get_partition(accel_req_get_hw_task(&self->spec_req)) !=
+        hw_task_get_partition(hw_task))
+        return 0;
+
+    accel_req_set_slot(request, accel_req_get_slot(&self->spec_req));
+    accel_req_set_timer(request, accel_req_get_timer(&self->spec_req));
+    self->spec_claim = request;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: hw-task: %s took over prefetch slot: %d",
+                            hw_task_get_name(hw_task),
+                            slot_get_index(accel_req_get_slot(request)));
+
+    return 1;
+}
+
+static inline
+int complete_prefetch_(struct scheduler_fred *self)
+{
+    int retval;
+    struct accel_req *claim;
+    struct accel_req *next_request;
+
+    claim = self->spec_claim;
+
+    self->spec_active = 0;
+    self->spec_claim = NULL;
+
+    if (claim && accel_req_is_expired(claim)) {
+        retval = expire_req_(claim);
+        if (retval)
+            return -1;
+
+        claim = NULL;
+    }
+
+    // Start the request that claimed the slot for the prefetched hw-task
+    if (claim && accel_req_get_hw_task(claim) == accel_req_get_hw_task(&self->spec_req))
+        return start_slot_after_rcfg_(self, claim);
+
+    // Nobody asked for the hw-task (yet), leave it in an idle slot
+    slot_set_idle_after_prefetch(accel_req_get_slot(&self->spec_req));
+
+    if (claim) {
+        // The request that took over the slot needs its own hw-task
+        slot_set_reserved(accel_req_get_slot(claim));
+
+        if (accel_req_get_cancelled(claim))
+            retval = drop_reserved_req_(self, claim, NOTIFY_ACTION_CANCELLED);
+        else
+            retval = dispatch_req_(self, claim);
+
+    } else {
+        // Meanwhile requests may have been queued for a slot of the partition
+        retval = pull_req_partition_queue_(self, accel_req_get_slot(&self->spec_req),
+                                            accel_req_get_timer(&self->spec_req),
+                                            hw_task_get_partition(
+                                                accel_req_get_hw_task(&self->spec_req)));
+    }
+    if (retval)
+        return -1;
+
+    if (!devcfg_is_idle(self->devcfg))
+        return 0;
+
+    retval = pop_fri_queue_(self, &next_request);
+    if (retval)
+        return -1;
+
+    if (next_request)
+        return start_rcfg_(self, next_request);
+
+    return try_prefetch_(self);
 }
 
 // ------------------------ Functions to implement scheduler interface ------------------------
@@ -233,23 +698,33 @@ int sched_fred_push_accel_req_(struct scheduler *self, struct accel_req *request
     // Set request's time stamp
     accel_req_stamp_timestamp(request);
 
-    // Search a free slot in the partition
     hw_task = accel_req_get_hw_task(request);
     partition = hw_task_get_partition(hw_task);
+
+    if (sched->prefetch) {
+        prefetcher_observe(&sched->prefetcher, hw_task);
+
+        // The hw-task is already being configured, wait for it
+        if (claim_prefetch_(sched, request))
+            return 0;
+    }
+
+    // Search a free slot in the partition
     rcfg = partition_search_slot(partition, &slot, &timer, hw_task);
 
     // If all slots in the partition are occupied
     if (!slot) {
+        // Rather than waiting for a reconfiguration that no request needed
+        if (sched->prefetch && take_over_prefetch_(sched, request))
+            return 0;
+
         logger_log(LOG_LEV_FULL,"\tfred_sys: all slots are busy for hw-task %s"
                                 ", insert into partition %s queue",
                                 hw_task_get_name(hw_task),
                                 partition_get_name(partition));
 
-        // Insert the new request into the partition FIFO queue
-        TAILQ_INSERT_TAIL(&sched->part_queues_heads[partition_get_index(partition)],
-                            request, queue_elem);
-
-        retval = 0;
+        // Insert the new request into the partition queue
+        retval = push_part_queue_(sched, partition, request);
 
     // At least one free slot in the partition
     } else {
@@ -263,14 +738,12 @@ int sched_fred_push_accel_req_(struct scheduler *self, struct accel_req *request
             accel_req_set_skip_rcfg(request);
 
         logger_log(LOG_LEV_FULL,"\tfred_sys: hw-task: %s got slot: %d of"
-                                " its partition: %s, inserted in fri queue",
+                                " its partition: %s",
                                 hw_task_get_name(hw_task),
                                 slot_get_index(slot),
                                 partition_get_name(partition));
 
-        // Push request into FRI queue. If request goes on top of FRI queue
-        // and devcfg is idle start reconfiguration immediately
-        retval = push_req_fri_queue_(sched, request);
+        retval = dispatch_req_(sched, request);
     }
 
     return retval;
@@ -306,6 +779,8 @@ int sched_fred_rcfg_complete_(struct scheduler *self, struct accel_req *request_
                             hw_task_get_name(accel_req_get_hw_task(request_done)),
                             rcfg_time_us);
 
+    hw_task_update_rcfg_est(accel_req_get_hw_task(request_done), rcfg_time_us);
+
     // Re-enable slot after it has been reconfigured
     slot_reinit_after_rcfg(slot);
 
@@ -324,6 +799,10 @@ int sched_fred_rcfg_complete_(struct scheduler *self, struct accel_req *request_
     }
 #endif
 
+    // Speculative reconfiguration, the slot may have been claimed meanwhile
+    if (request_done == &sched->spec_req)
+        return complete_prefetch_(sched);
+
     // Start the hardware accelerator
     return start_slot_after_rcfg_(sched, request_done);
 }
@@ -338,6 +817,7 @@ int sched_fred_slot_complete_(struct scheduler *self, struct accel_req *request_
     struct slot *slot;
     struct slot_timer *timer;
     struct partition *partition;
+    struct accel_req *chain_next;
 
     assert(self);
     assert(request_done);
@@ -347,6 +827,7 @@ int sched_fred_slot_complete_(struct scheduler *self, struct accel_req *request_
     slot = accel_req_get_slot(request_done);
     timer = accel_req_get_timer(request_done);
     partition = hw_task_get_partition(accel_req_get_hw_task(request_done));
+    chain_next = accel_req_get_chain_next(request_done);
 
     assert(slot);
     assert(timer);
@@ -360,6 +841,8 @@ int sched_fred_slot_complete_(struct scheduler *self, struct accel_req *request_
     // Clear slot device
     slot_clear_after_compute(slot);
 
+    hw_task_update_exec_est(accel_req_get_hw_task(request_done), exec_time_us);
+
     logger_log(LOG_LEV_FULL,"\tfred_sys: slot: %d of partition: %s"
                             " completed execution of hw-task: %s in %"PRIu64" us",
                             slot_get_index(slot), partition_get_name(partition),
@@ -372,9 +855,19 @@ int sched_fred_slot_complete_(struct scheduler *self, struct accel_req *request_
         return -1;
 
     // Pull requests from the partition queue
-    retval = pull_req_partition_queue_(sched, request_done);
+    retval = pull_req_partition_queue_(sched, slot, timer, partition);
+    if (retval)
+        return -1;
 
-    return retval;
+    // The next stage of the chain can start
+    if (chain_next) {
+        retval = release_chain_next_(sched, chain_next, 0);
+        if (retval)
+            return -1;
+    }
+
+    // The slot may be free for a speculative reconfiguration
+    return try_prefetch_(sched);
 }
 
 // Hardware task timeout
@@ -384,7 +877,9 @@ int sched_fred_slot_timeout_(struct scheduler *self, struct accel_req *request_d
     int retval;
     struct scheduler_fred *sched;
     struct slot *slot;
+    struct slot_timer *timer;
     struct partition *partition;
+    struct accel_req *chain_next;
 
     assert(self);
     assert(request_done);
@@ -392,7 +887,9 @@ int sched_fred_slot_timeout_(struct scheduler *self, struct accel_req *request_d
     sched = (struct scheduler_fred *)self;
 
     slot = accel_req_get_slot(request_done);
+    timer = accel_req_get_timer(request_done);
     partition = hw_task_get_partition(accel_req_get_hw_task(request_done));
+    chain_next = accel_req_get_chain_next(request_done);
 
     assert(slot);
     assert(partition);
@@ -413,10 +910,37 @@ int sched_fred_slot_timeout_(struct scheduler *self, struct accel_req *request_d
     if (retval)
         return -1;
 
+    // The next stage of the chain would get a broken input, drop it
+    // before it gets the freed slot
+    if (chain_next) {
+        retval = release_chain_next_(sched, chain_next, 1);
+        if (retval)
+            return -1;
+    }
+
     // Pull requests from the partition queue
-    retval = pull_req_partition_queue_(sched, request_done);
+    return pull_req_partition_queue_(sched, slot, timer, partition);
+}
 
-    return retval;
+// Request cancelled by the client
+static
+int sched_fred_cancel_accel_req_(struct scheduler *self, struct accel_req *request)
+{
+    struct scheduler_fred *sched;
+
+    assert(self);
+    assert(request);
+
+    sched = (struct scheduler_fred *)self;
+
+    accel_req_set_cancelled(request);
+
+    // The stages of a chain are notified in order, a stage waiting
+    // for the previous one is dropped when that one is over
+    if (accel_req_get_chain_wait(request))
+        return 0;
+
+    return drop_queued_req_(sched, request, NOTIFY_ACTION_CANCELLED);
 }
 
 static
@@ -426,16 +950,25 @@ void sched_fred_free_(struct scheduler *self)
 
     sched = (struct scheduler_fred *)self;
 
-    if(sched)
-        free(sched);
+    if (!sched)
+        return;
+
+    for (int i = 0; i < MAX_PARTITIONS; ++i)
+        req_heap_free(&sched->part_queues[i]);
+
+    fri_queue_free(&sched->fri_queue);
+    free(sched);
 }
 
 //---------------------------------------------------------------------------------------------
 
-int sched_fred_init(struct scheduler **self, enum sched_fred_mode mode, struct devcfg *devcfg)
+int sched_fred_init(struct scheduler **self, const struct sched_fred_params *params,
+                    struct devcfg *devcfg)
 {
+    int retval;
     struct scheduler_fred *sched;
 
+    assert(params);
     assert(devcfg);
 
     *self = NULL;
@@ -446,24 +979,60 @@ int sched_fred_init(struct scheduler **self, enum sched_fred_mode mode, struct d
         return -1;
 
     // Set properties and methods
-    sched->mode = mode;
+    sched->mode = params->mode;
     sched->devcfg = devcfg;
+    sched->prefetch = params->prefetch;
+    sched->lookahead = params->lookahead;
+    sched->aging_limit = params->aging_limit;
+
+    prefetcher_init(&sched->prefetcher);
 
     // Scheduler interface
     sched->scheduler.push_accel_req = sched_fred_push_accel_req_;
     sched->scheduler.rcfg_complete = sched_fred_rcfg_complete_;
     sched->scheduler.slot_complete = sched_fred_slot_complete_;
     sched->scheduler.slot_timeout = sched_fred_slot_timeout_;
+    sched->scheduler.cancel_accel_req = sched_fred_cancel_accel_req_;
     sched->scheduler.free = sched_fred_free_;
 
-    // Initialize partition queues heads
-    for (int i = 0; i < MAX_PARTITIONS; ++i)
-        TAILQ_INIT(&(sched->part_queues_heads[i]));
+    // Initialize partition queues
+    for (int i = 0; i < MAX_PARTITIONS; ++i) {
+        retval = req_heap_init(&sched->part_queues[i], PART_QUEUE_INIT_SIZE);
+        if (retval)
+            goto error_clean;
+    }
+
+    // And fri queue
+    retval = fri_queue_init(&sched->fri_queue, params->fri_order);
+    if (retval)
+        goto error_clean;
 
-    // And fri queue head
-    TAILQ_INIT(&sched->fri_queue_head);
+    DBG_PRINT("fred_sys: FRI queue ordering: %s\n", fri_order_get_name(params->fri_order));
+    if (sched->mode == SCHED_FRED_FAST_SKIP)
+        DBG_PRINT("fred_sys: fast start for requests without rcfg\n");
+    if (sched->lookahead)
+        DBG_PRINT("fred_sys: partition queues look-ahead: %d, aging limit: %d\n",
+                    sched->lookahead, sched->aging_limit);
+    if (sched->prefetch)
+        DBG_PRINT("fred_sys: speculative reconfiguration enabled\n");
 
     *self = &sched->scheduler;
 
     return 0;
+
+error_clean:
+    sched_fred_free_(&sched->scheduler);
+    return -1;
+}
+
+void sched_fred_attach_timer_wheel(struct scheduler *self, struct timer_wheel *wheel)
+{
+    struct scheduler_fred *sched;
+
+    assert(self);
+    assert(wheel);
+
+    sched = (struct scheduler_fred *)self;
+
+    sched->timer_wheel = wheel;
 }
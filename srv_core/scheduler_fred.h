@@ -18,12 +18,31 @@
 #include "../parameters.h"
 #include "accel_req.h"
 #include "devcfg.h"
+#include "fri_queue.h"
+#include "prefetcher.h"
+#include "req_heap.h"
 #include "scheduler.h"
+#include "timer_wheel.h"
 
 
+// In fast skip mode a request whose slot already holds its hw-task starts as soon
+// as the slot is reserved, without going through the FRI queue. Its response time
+// no longer includes the FRI blocking term (up to one reconfiguration per request
+// ahead in the queue) and reduces to its execution time. The bound of requests
+// needing a reconfiguration is unchanged, since the skipped requests never hold
+// the devcfg
 enum sched_fred_mode {
     SCHED_FRED_NORMAL,
-    SCHED_FRED_ALWAYS_RCFG
+    SCHED_FRED_ALWAYS_RCFG,
+    SCHED_FRED_FAST_SKIP
+};
+
+struct sched_fred_params {
+    enum sched_fred_mode mode;
+    enum fri_order fri_order;       // Reconfiguration queue ordering
+    int prefetch;                   // Speculatively configure idle slots
+    int lookahead;                  // Partition queue requests scanned to reuse a slot
+    int aging_limit;                // Max times a queued request can be bypassed
 };
 
 //---------------------------------------------------------------------------------------------
@@ -35,21 +54,38 @@ struct scheduler_fred {
 
     enum sched_fred_mode mode;
 
-    // Partitions queues heads
-    struct accel_req_queue part_queues_heads[MAX_PARTITIONS];
+    // Partitions queues (earliest deadline first, with bounded look-ahead)
+    struct req_heap part_queues[MAX_PARTITIONS];
+    int lookahead;
+    int aging_limit;
 
     // Reconfiguration device queue
-    // Partition queue head
-    struct accel_req_queue fri_queue_head;
+    struct fri_queue fri_queue;
 
     // Reconfiguration device
     struct devcfg *devcfg;
+
+    // Deadline timers of the queued requests (main loop wheel, if attached)
+    struct timer_wheel *timer_wheel;
+
+    // Speculative reconfiguration, at most one at a time. The request that
+    // claims (or takes over) the slot while it is being configured gets it when done
+    int prefetch;
+    struct prefetcher prefetcher;
+    struct accel_req spec_req;
+    int spec_active;
+    struct accel_req *spec_claim;
 };
 
 
 //---------------------------------------------------------------------------------------------
 
-int sched_fred_init(struct scheduler **self, enum sched_fred_mode mode, struct devcfg *devcfg);
+int sched_fred_init(struct scheduler **self, const struct sched_fred_params *params,
+                    struct devcfg *devcfg);
+
+// Drop queued requests as soon as their deadline passes, otherwise they are
+// only checked when they leave the queues
+void sched_fred_attach_timer_wheel(struct scheduler *self, struct timer_wheel *wheel);
 
 //---------------------------------------------------------------------------------------------
 
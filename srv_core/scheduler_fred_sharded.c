@@ -0,0 +1,1141 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/eventfd.h>
+
+#include "slot.h"
+#include "slot_timer.h"
+#include "partition.h"
+#include "devcfg.h"
+#include "../utils/logger.h"
+#include "../utils/dbg_print.h"
+#include "scheduler_fred_sharded.h"
+
+//---------------------------------------------------------------------------------------------
+
+// Initial capacity of the partition queues, they grow on demand
+#define PART_QUEUE_INIT_SIZE    16
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+int start_slot_(struct scheduler_fred_sharded *self, struct accel_req *request);
+
+static inline
+int start_rcfg_(struct scheduler_fred_sharded *self, struct accel_req *request);
+
+static inline
+int push_req_fri_queue_(struct scheduler_fred_sharded *self, struct accel_req *request);
+
+static
+int shard_start_slot_(struct scheduler *self, struct accel_req *request);
+
+//--- Doorbells -------------------------------------------------------------------------------
+
+static inline
+int ring_doorbell_(int efd)
+{
+    uint64_t value = 1;
+
+    if (write(efd, &value, sizeof(value)) != sizeof(value)) {
+        ERROR_PRINT("fred_sys: shard: doorbell write error %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static inline
+int clear_doorbell_(int efd)
+{
+    uint64_t value;
+
+    if (read(efd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        ERROR_PRINT("fred_sys: shard: doorbell read error %s\n", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+// From the shard thread to the arbiter
+static inline
+int shard_post_(struct sched_shard *shard, enum shard_msg_type type,
+                struct accel_req *request)
+{
+    if (spsc_queue_push(&shard->out_queue, type, request)) {
+        ERROR_PRINT("fred_sys: shard %s: arbiter queue full\n",
+                    partition_get_name(shard->partition));
+        return -1;
+    }
+
+    return ring_doorbell_(shard->out_port.efd);
+}
+
+// From the arbiter to the shard thread
+static inline
+int arbiter_post_(struct sched_shard *shard, enum shard_msg_type type,
+                    struct accel_req *request)
+{
+    if (spsc_queue_push(&shard->in_queue, type, request)) {
+        ERROR_PRINT("fred_sys: shard %s: shard queue full\n",
+                    partition_get_name(shard->partition));
+        return -1;
+    }
+
+    return ring_doorbell_(shard->in_port.efd);
+}
+
+static inline
+struct sched_shard *get_req_shard_(struct scheduler_fred_sharded *self,
+                                    const struct accel_req *request)
+{
+    struct partition *partition;
+
+    partition = hw_task_get_partition(accel_req_get_hw_task(request));
+
+    return self->shards[partition_get_index(partition)];
+}
+
+//--- Shard side (runs on the shard thread) ---------------------------------------------------
+
+// Hand over a request with a reserved slot to the arbiter. In fast skip mode,
+// if the slot already holds the hw-task, start it here without a round trip
+static inline
+int shard_dispatch_(struct sched_shard *shard, struct accel_req *request)
+{
+    if (shard->arbiter->mode == SCHED_FRED_FAST_SKIP && accel_req_get_skip_rcfg(request))
+        return shard_start_slot_(&shard->scheduler, request);
+
+    return shard_post_(shard, SHARD_MSG_FRI, request);
+}
+
+static inline
+int shard_pull_part_queue_(struct sched_shard *shard, struct slot *slot,
+                            struct slot_timer *timer)
+{
+    int retval;
+    struct accel_req *request;
+
+    while (!req_heap_is_empty(&shard->part_queue)) {
+
+        // Get the most urgent request from the partition queue, or a request
+        // close to the head that can reuse the hw-task left in the slot
+        request = req_heap_pop_lookahead(&shard->part_queue, slot_get_idle_hw_task(slot),
+                                            shard->arbiter->lookahead,
+                                            shard->arbiter->aging_limit);
+
+        accel_req_disarm_deadline(request);
+
+        // The arbiter notifies the client
+        if (accel_req_is_expired(request)) {
+            retval = shard_post_(shard, SHARD_MSG_EXPIRED, request);
+            if (retval)
+                return -1;
+
+            continue;
+        }
+
+        // The slot may still hold the hw-task
+        if (slot_match_hw_task(slot, accel_req_get_hw_task(request)) &&
+            shard->arbiter->mode != SCHED_FRED_ALWAYS_RCFG)
+            accel_req_set_skip_rcfg(request);
+
+        // Reserve the slot for the HW-task
+        slot_set_reserved(slot);
+        accel_req_set_slot(request, slot);
+        accel_req_set_timer(request, timer);
+
+        return shard_dispatch_(shard, request);
+    }
+
+    return 0;
+}
+
+// Request expired in the FRI queue (or cancelled), give its slot to the partition queue
+static
+int shard_release_slot_(struct sched_shard *shard, struct accel_req *request)
+{
+    int retval;
+    struct slot *slot;
+    struct slot_timer *timer;
+
+    slot = accel_req_get_slot(request);
+    timer = accel_req_get_timer(request);
+
+    assert(slot);
+    assert(timer);
+
+    slot_release_reserved(slot);
+
+    // From now on the request belongs to the arbiter
+    retval = shard_post_(shard, SHARD_MSG_EXPIRED, request);
+    if (retval)
+        return -1;
+
+    return shard_pull_part_queue_(shard, slot, timer);
+}
+
+// Request cancelled while it may be in the partition queue. If it has already
+// left, the arbiter drops it (the messages of each direction are in order)
+static
+int shard_cancel_(struct sched_shard *shard, struct accel_req *request)
+{
+    if (!req_heap_contains(&shard->part_queue, request))
+        return 0;
+
+    accel_req_disarm_deadline(request);
+    req_heap_remove(&shard->part_queue, request);
+
+    return shard_post_(shard, SHARD_MSG_CANCELLED, request);
+}
+
+// The deadline of a request in the partition queue passed, the arbiter notifies it
+static
+int shard_deadline_expired_(struct wheel_timer *self)
+{
+    struct req_deadline_timer *timer;
+    struct sched_shard *shard;
+
+    assert(self);
+
+    timer = (struct req_deadline_timer *)self;
+    shard = timer->owner;
+
+    req_heap_remove(&shard->part_queue, timer->request);
+
+    return shard_post_(shard, SHARD_MSG_EXPIRED, timer->request);
+}
+
+// New request for the partition
+static
+int shard_push_accel_req_(struct scheduler *self, struct accel_req *request)
+{
+    int retval;
+    int rcfg;
+    struct sched_shard *shard;
+    struct hw_task *hw_task;
+    struct slot *slot;
+    struct slot_timer *timer;
+
+    assert(self);
+    assert(request);
+
+    shard = (struct sched_shard *)self;
+    hw_task = accel_req_get_hw_task(request);
+
+    // The arbiter only moves slots between the reserved states (RSRV, RCFG,
+    // READY), hence it never changes the availability seen by the shard
+    rcfg = partition_search_slot(shard->partition, &slot, &timer, hw_task);
+
+    // If all slots in the partition are occupied
+    if (!slot) {
+        logger_log(LOG_LEV_FULL,"\tfred_sys: all slots are busy for hw-task %s"
+                                ", insert into partition %s queue",
+                                hw_task_get_name(hw_task),
+                                partition_get_name(shard->partition));
+
+        request->heap_key = accel_req_get_edf_key(request);
+
+        retval = req_heap_push(&shard->part_queue, request);
+        if (retval)
+            return -1;
+
+        return accel_req_arm_deadline(request, shard->timer_wheel,
+                                        shard_deadline_expired_, shard);
+    }
+
+    // Reserve the slot for the HW-task
+    slot_set_reserved(slot);
+    accel_req_set_slot(request, slot);
+    accel_req_set_timer(request, timer);
+
+    // If possible, set for skipping rcfg
+    if (!rcfg && shard->arbiter->mode != SCHED_FRED_ALWAYS_RCFG)
+        accel_req_set_skip_rcfg(request);
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: hw-task: %s got slot: %d of"
+                            " its partition: %s",
+                            hw_task_get_name(hw_task),
+                            slot_get_index(slot),
+                            partition_get_name(shard->partition));
+
+    return shard_dispatch_(shard, request);
+}
+
+// Slot ready (reconfigured or reconfiguration skipped), start the hw-task
+static
+int shard_start_slot_(struct scheduler *self, struct accel_req *request)
+{
+    int retval;
+    struct sched_shard *shard;
+    struct hw_task *hw_task;
+    struct slot *slot;
+    struct slot_timer *timer;
+
+    assert(self);
+    assert(request);
+
+    shard = (struct sched_shard *)self;
+
+    hw_task = accel_req_get_hw_task(request);
+    slot = accel_req_get_slot(request);
+    timer = accel_req_get_timer(request);
+
+    assert(hw_task);
+    assert(slot);
+    assert(timer);
+
+    // Start the hardware accelerator
+    retval = slot_start_compute(slot, request);
+    if (retval)
+        return -1;
+
+    // And arm the watchdog timer
+    retval = slot_timer_arm(timer, hw_task_get_timeout_us(hw_task), request);
+    if (retval)
+        return -1;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: slot: %d of partition: %s"
+                            " started for hw-task: %s",
+                            slot_get_index(slot),
+                            partition_get_name(shard->partition),
+                            hw_task_get_name(hw_task));
+
+    return 0;
+}
+
+static
+int shard_slot_complete_(struct scheduler *self, struct accel_req *request_done)
+{
+    int retval;
+    uint64_t exec_time_us;
+    struct sched_shard *shard;
+    struct slot *slot;
+    struct slot_timer *timer;
+
+    assert(self);
+    assert(request_done);
+
+    shard = (struct sched_shard *)self;
+
+    slot = accel_req_get_slot(request_done);
+    timer = accel_req_get_timer(request_done);
+
+    assert(slot);
+    assert(timer);
+
+    // Get execution time (upper bound) and disarm the timer
+    retval = slot_timer_disarm(timer, &exec_time_us);
+    if (retval)
+        return -1;
+
+    // Clear slot device
+    slot_clear_after_compute(slot);
+
+    // Estimates are owned by the arbiter, hand over the measure
+    accel_req_set_exec_time_us(request_done, exec_time_us);
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: slot: %d of partition: %s"
+                            " completed execution of hw-task: %s in %"PRIu64" us",
+                            slot_get_index(slot), partition_get_name(shard->partition),
+                            hw_task_get_name(accel_req_get_hw_task(request_done)),
+                            exec_time_us);
+
+    // From now on the request belongs to the arbiter
+    retval = shard_post_(shard, SHARD_MSG_DONE, request_done);
+    if (retval)
+        return -1;
+
+    // Pull requests from the partition queue
+    return shard_pull_part_queue_(shard, slot, timer);
+}
+
+static
+int shard_slot_timeout_(struct scheduler *self, struct accel_req *request_done)
+{
+    int retval;
+    struct sched_shard *shard;
+    struct slot *slot;
+    struct slot_timer *timer;
+
+    assert(self);
+    assert(request_done);
+
+    shard = (struct sched_shard *)self;
+
+    slot = accel_req_get_slot(request_done);
+    timer = accel_req_get_timer(request_done);
+
+    assert(slot);
+    assert(timer);
+
+    // Disable the slot until the next reconfiguration
+    slot_disable_after_timeout(slot);
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: Warning! slot: %d of partition: %s"
+                            " overrun! Permanently disabling offending hw-task: %s",
+                            slot_get_index(slot), partition_get_name(shard->partition),
+                            hw_task_get_name(accel_req_get_hw_task(request_done)));
+
+    // The arbiter bans the hw-task and notifies the client
+    retval = shard_post_(shard, SHARD_MSG_OVERRUN, request_done);
+    if (retval)
+        return -1;
+
+    // Pull requests from the partition queue
+    return shard_pull_part_queue_(shard, slot, timer);
+}
+
+//--- Shard ports event handlers --------------------------------------------------------------
+
+static
+int port_get_fd_handle_(const struct event_handler *self)
+{
+    assert(self);
+
+    return ((const struct shard_port *)self)->efd;
+}
+
+static
+void port_get_name_(const struct event_handler *self, char *msg, int msg_size)
+{
+    const struct shard_port *port;
+
+    assert(self);
+
+    port = (const struct shard_port *)self;
+    snprintf(msg, msg_size, "shard %s port on fd: %d",
+                partition_get_name(port->shard->partition), port->efd);
+}
+
+static
+void port_free_(struct event_handler *self)
+{
+    // Embedded in the shard, released together with it
+}
+
+// Arbiter to shard messages, runs on the shard thread
+static
+int in_port_handle_event_(struct event_handler *self)
+{
+    int retval;
+    int type;
+    void *data;
+    struct shard_port *port;
+    struct sched_shard *shard;
+
+    assert(self);
+
+    port = (struct shard_port *)self;
+    shard = port->shard;
+
+    retval = clear_doorbell_(port->efd);
+    if (retval)
+        return -1;
+
+    // Drain all messages behind this doorbell
+    while (!spsc_queue_pop(&shard->in_queue, &type, &data)) {
+        switch (type) {
+            case SHARD_MSG_PUSH:
+                retval = scheduler_push_accel_req(&shard->scheduler, data);
+                break;
+            case SHARD_MSG_START:
+                retval = scheduler_rcfg_complete(&shard->scheduler, data);
+                break;
+            case SHARD_MSG_RELEASE:
+                retval = shard_release_slot_(shard, data);
+                break;
+            case SHARD_MSG_CANCEL:
+                retval = shard_cancel_(shard, data);
+                break;
+            case SHARD_MSG_STOP:
+                shard->stopping = 1;
+                return -1;
+            default:
+                retval = -1;
+                break;
+        }
+
+        if (retval)
+            return -1;
+    }
+
+    return 0;
+}
+
+// Chains are followed by the arbiter: the next stage is pushed (and its slot
+// prepared) only when the previous one has completed
+static inline
+int push_chain_next_(struct scheduler_fred_sharded *self, struct accel_req *request)
+{
+    accel_req_release_chain_wait(request, 0);
+
+    // Cancelled while waiting for the previous stage
+    if (accel_req_get_cancelled(request))
+        return accel_req_notify_action(request, NOTIFY_ACTION_CANCELLED);
+
+    return scheduler_push_accel_req(&self->scheduler, request);
+}
+
+// Shard to arbiter messages, runs on the main event loop
+static
+int out_port_handle_event_(struct event_handler *self)
+{
+    int retval;
+    int type;
+    void *data;
+    struct shard_port *port;
+    struct scheduler_fred_sharded *sched;
+    struct accel_req *chain_next;
+
+    assert(self);
+
+    port = (struct shard_port *)self;
+    sched = port->shard->arbiter;
+
+    retval = clear_doorbell_(port->efd);
+    if (retval)
+        return -1;
+
+    while (!spsc_queue_pop(&port->shard->out_queue, &type, &data)) {
+        switch (type) {
+            case SHARD_MSG_FRI:
+                // Cancelled meanwhile, the shard releases the slot
+                if (accel_req_get_cancelled(data)) {
+                    retval = arbiter_post_(port->shard, SHARD_MSG_RELEASE, data);
+                    break;
+                }
+
+                // If request goes on top of FRI queue and devcfg is idle
+                // start reconfiguration immediately
+                retval = push_req_fri_queue_(sched, data);
+                break;
+            case SHARD_MSG_DONE:
+                hw_task_update_exec_est(accel_req_get_hw_task(data),
+                                        accel_req_get_exec_time_us(data));
+                chain_next = accel_req_get_chain_next(data);
+                retval = accel_req_notify_action(data, NOTIFY_ACTION_DONE);
+                if (!retval && chain_next)
+                    retval = push_chain_next_(sched, chain_next);
+                break;
+            case SHARD_MSG_OVERRUN:
+                hw_task_set_banned(accel_req_get_hw_task(data));
+                chain_next = accel_req_get_chain_next(data);
+                retval = accel_req_notify_action(data, NOTIFY_ACTION_OVERRUN);
+                if (!retval && chain_next)
+                    retval = accel_req_notify_action(chain_next, NOTIFY_ACTION_ABORTED);
+                break;
+            case SHARD_MSG_EXPIRED:
+                // Slot released on cancel
+                if (accel_req_get_cancelled(data)) {
+                    retval = accel_req_notify_action(data, NOTIFY_ACTION_CANCELLED);
+                    break;
+                }
+
+                logger_log(LOG_LEV_FULL,"\tfred_sys: request for hw-task: %s"
+                                        " expired while queued",
+                                        hw_task_get_name(accel_req_get_hw_task(data)));
+                retval = accel_req_notify_action(data, NOTIFY_ACTION_EXPIRED);
+                break;
+            case SHARD_MSG_CANCELLED:
+                retval = accel_req_notify_action(data, NOTIFY_ACTION_CANCELLED);
+                break;
+            case SHARD_MSG_EXIT:
+            default:
+                ERROR_PRINT("fred_sys: shard %s terminated\n",
+                            partition_get_name(port->shard->partition));
+                retval = -1;
+                break;
+        }
+
+        if (retval)
+            return -1;
+    }
+
+    return 0;
+}
+
+//--- Shard life cycle ------------------------------------------------------------------------
+
+static
+void *shard_thread_(void *arg)
+{
+    struct sched_shard *shard;
+
+    shard = (struct sched_shard *)arg;
+
+    reactor_event_loop(shard->reactor);
+
+    // Terminated on error, shut down the whole system
+    if (!shard->stopping)
+        shard_post_(shard, SHARD_MSG_EXIT, NULL);
+
+    return NULL;
+}
+
+static
+int shard_start_thread_(struct sched_shard *shard)
+{
+    int retval;
+    long cpus_count;
+    cpu_set_t cpu_set;
+    pthread_attr_t attr;
+
+    retval = pthread_attr_init(&attr);
+    if (retval)
+        return -1;
+
+    // Pin the shard, leave the first CPU to the main loop when possible
+    cpus_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus_count > 0) {
+        CPU_ZERO(&cpu_set);
+        CPU_SET((partition_get_index(shard->partition) + 1) % cpus_count, &cpu_set);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpu_set), &cpu_set);
+    }
+
+    retval = pthread_create(&shard->thread, &attr, shard_thread_, shard);
+    pthread_attr_destroy(&attr);
+    if (retval) {
+        ERROR_PRINT("fred_sys: shard %s: unable to create thread: %s\n",
+                    partition_get_name(shard->partition), strerror(retval));
+        return -1;
+    }
+
+    shard->started = 1;
+
+    return 0;
+}
+
+static
+void shard_stop_thread_(struct sched_shard *shard)
+{
+    if (!shard->started)
+        return;
+
+    // If the queue is full the thread is already on its way out
+    arbiter_post_(shard, SHARD_MSG_STOP, NULL);
+    pthread_join(shard->thread, NULL);
+
+    shard->started = 0;
+}
+
+static
+void shard_free_(struct scheduler *self)
+{
+    struct sched_shard *shard;
+
+    if (!self)
+        return;
+
+    shard = (struct sched_shard *)self;
+
+    shard_stop_thread_(shard);
+
+    reactor_free(shard->reactor);
+
+    if (shard->timer_wheel)
+        event_handler_free(timer_wheel_get_event_handler(shard->timer_wheel));
+
+    req_heap_free(&shard->part_queue);
+
+    spsc_queue_free(&shard->in_queue);
+    spsc_queue_free(&shard->out_queue);
+
+    if (shard->in_port.efd >= 0)
+        close(shard->in_port.efd);
+    if (shard->out_port.efd >= 0)
+        close(shard->out_port.efd);
+
+    free(shard);
+}
+
+static
+void shard_init_port_(struct shard_port *port, struct sched_shard *shard,
+                        int (*handle_event)(struct event_handler *self))
+{
+    port->shard = shard;
+
+    event_handler_assign_id(&port->handler);
+    port->handler.handle_event = handle_event;
+    port->handler.get_fd_handle = port_get_fd_handle_;
+    port->handler.get_name = port_get_name_;
+    port->handler.free = port_free_;
+}
+
+static
+int shard_init_(struct sched_shard **self, struct scheduler_fred_sharded *arbiter,
+                struct partition *partition, enum reactor_type reactor_type)
+{
+    int retval;
+    struct sched_shard *shard;
+
+    *self = NULL;
+
+    // Allocate and set everything to 0
+    shard = calloc(1, sizeof(*shard));
+    if (!shard)
+        return -1;
+
+    shard->arbiter = arbiter;
+    shard->partition = partition;
+
+    retval = req_heap_init(&shard->part_queue, PART_QUEUE_INIT_SIZE);
+    if (retval) {
+        free(shard);
+        return -1;
+    }
+
+    // Partition-level scheduler interface for slots and timers
+    shard->scheduler.push_accel_req = shard_push_accel_req_;
+    shard->scheduler.rcfg_complete = shard_start_slot_;
+    shard->scheduler.slot_complete = shard_slot_complete_;
+    shard->scheduler.slot_timeout = shard_slot_timeout_;
+    shard->scheduler.free = shard_free_;
+
+    shard_init_port_(&shard->in_port, shard, in_port_handle_event_);
+    shard_init_port_(&shard->out_port, shard, out_port_handle_event_);
+
+    shard->in_port.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    shard->out_port.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (shard->in_port.efd < 0 || shard->out_port.efd < 0)
+        goto error_clean;
+
+    retval = spsc_queue_init(&shard->in_queue, SHARD_QUEUE_SIZE);
+    if (retval)
+        goto error_clean;
+
+    retval = spsc_queue_init(&shard->out_queue, SHARD_QUEUE_SIZE);
+    if (retval)
+        goto error_clean;
+
+    // Private reactor, same backend of the main loop
+    retval = reactor_init(&shard->reactor, reactor_type);
+    if (retval)
+        goto error_clean;
+
+    retval = reactor_add_event_handler(shard->reactor, &shard->in_port.handler,
+                                        REACT_NORMAL_HANDLER, REACT_NOT_OWNED);
+    if (retval)
+        goto error_clean;
+
+    retval = timer_wheel_init(&shard->timer_wheel);
+    if (retval)
+        goto error_clean;
+
+    retval = reactor_add_event_handler(shard->reactor,
+                                        timer_wheel_get_event_handler(shard->timer_wheel),
+                                        REACT_HW_HANDLER, REACT_NOT_OWNED);
+    if (retval)
+        goto error_clean;
+
+    // Move the partition slots and timers to the shard
+    retval = partiton_register_slots(partition, shard->reactor);
+    if (retval)
+        goto error_clean;
+
+    partition_attach_scheduler(partition, &shard->scheduler);
+    partition_attach_timer_wheel(partition, shard->timer_wheel);
+
+    *self = shard;
+
+    return 0;
+
+error_clean:
+    ERROR_PRINT("fred_sys: unable to initialize shard for partition %s\n",
+                partition_get_name(partition));
+    shard_free_(&shard->scheduler);
+    return -1;
+}
+
+//--- Arbiter side (runs on the main event loop) ----------------------------------------------
+
+// Get and remove the head request from the FRI queue. Expired requests
+// go back to their shards to release the reserved slots
+static inline
+int pop_fri_queue_(struct scheduler_fred_sharded *self, struct accel_req **request)
+{
+    int retval;
+    struct accel_req *next_request;
+
+    *request = NULL;
+
+    while (!fri_queue_is_empty(&self->fri_queue)) {
+        next_request = fri_queue_pop(&self->fri_queue);
+        accel_req_disarm_deadline(next_request);
+
+        if (!accel_req_is_expired(next_request)) {
+            *request = next_request;
+            break;
+        }
+
+        retval = arbiter_post_(get_req_shard_(self, next_request), SHARD_MSG_RELEASE,
+                                next_request);
+        if (retval)
+            return -1;
+    }
+
+    return 0;
+}
+
+// The deadline of a request in the FRI queue passed, its shard releases the slot
+static
+int arbiter_deadline_expired_(struct wheel_timer *self)
+{
+    struct req_deadline_timer *timer;
+    struct scheduler_fred_sharded *sched;
+
+    assert(self);
+
+    timer = (struct req_deadline_timer *)self;
+    sched = timer->owner;
+
+    fri_queue_remove(&sched->fri_queue, timer->request);
+
+    return arbiter_post_(get_req_shard_(sched, timer->request), SHARD_MSG_RELEASE,
+                            timer->request);
+}
+
+static inline
+int start_slot_(struct scheduler_fred_sharded *self, struct accel_req *request)
+{
+    int retval;
+    struct accel_req *next_request;
+
+    // Hand over to the shard, the request belongs to the shard from now on.
+    // If cancelled meanwhile the slot is released instead
+    retval = arbiter_post_(get_req_shard_(self, request),
+                            accel_req_get_cancelled(request) ?
+                                SHARD_MSG_RELEASE : SHARD_MSG_START, request);
+    if (retval)
+        return -1;
+
+    // Get and remove the head request from the FRI queue
+    retval = pop_fri_queue_(self, &next_request);
+    if (retval)
+        return -1;
+
+    // If the FRI queue is not empty start next reconfiguration
+    if (next_request) {
+        logger_log(LOG_LEV_PEDANTIC,"\tfred_sys: FRI queue not empty");
+
+        // Start reconfiguration
+        retval = start_rcfg_(self, next_request);
+    }
+
+    return retval;
+}
+
+static inline
+int start_rcfg_(struct scheduler_fred_sharded *self, struct accel_req *request)
+{
+    int retval;
+
+    // If the slot already contains the hw-task
+    if (accel_req_get_skip_rcfg(request)) {
+        logger_log(LOG_LEV_FULL,"\tfred_sys: skipping rcfg of slot: %d"
+                                " of partition: %s for hw-task: %s",
+                                slot_get_index(accel_req_get_slot(request)),
+                                partition_get_name(hw_task_get_partition(
+                                        accel_req_get_hw_task(request))),
+                                hw_task_get_name(accel_req_get_hw_task(request)));
+
+        // Start the slot immediately
+        retval = start_slot_(self, request);
+
+    } else {
+        logger_log(LOG_LEV_FULL,"\tfred_sys: start rcfg of slot: %d"
+                                " of partition: %s for hw-task: %s",
+                                slot_get_index(accel_req_get_slot(request)),
+                                partition_get_name(hw_task_get_partition(
+                                        accel_req_get_hw_task(request))),
+                                hw_task_get_name(accel_req_get_hw_task(request)));
+
+        // Start FPGA reconfiguration and bind hw-task to the slot
+        slot_prepare_for_rcfg(accel_req_get_slot(request));
+        retval = devcfg_start_prog(self->devcfg, request);
+    }
+
+    return retval;
+}
+
+static inline
+int push_req_fri_queue_(struct scheduler_fred_sharded *self, struct accel_req *request)
+{
+    int retval = 0;
+
+    retval = fri_queue_push(&self->fri_queue, request);
+    if (retval)
+        return -1;
+
+    // If the inserted request is on top of FRI queue
+    // and the DEVCFG is IDLE (not programming)
+    if (devcfg_is_idle(self->devcfg) &&
+        fri_queue_peek(&self->fri_queue) == request) {
+
+        logger_log(LOG_LEV_PEDANTIC,"\tfred_sys: DevCfg idle & request on top");
+
+        fri_queue_pop(&self->fri_queue);
+
+        retval = start_rcfg_(self, request);
+
+    // Waiting for the devcfg
+    } else if (self->timer_wheel) {
+        retval = accel_req_arm_deadline(request, self->timer_wheel,
+                                        arbiter_deadline_expired_, self);
+    }
+
+    return retval;
+}
+
+// ------------------------ Functions to implement scheduler interface ------------------------
+
+// Acceleration request from software tasks
+static
+int sched_fred_sharded_push_accel_req_(struct scheduler *self, struct accel_req *request)
+{
+    struct scheduler_fred_sharded *sched;
+
+    assert(self);
+    assert(request);
+
+    sched = (struct scheduler_fred_sharded *)self;
+
+    // Set request's time stamp
+    accel_req_stamp_timestamp(request);
+
+    // Search for a slot on the partition shard
+    return arbiter_post_(get_req_shard_(sched, request), SHARD_MSG_PUSH, request);
+}
+
+// Reconfiguration done
+static
+int sched_fred_sharded_rcfg_complete_(struct scheduler *self, struct accel_req *request_done)
+{
+    struct scheduler_fred_sharded *sched;
+    struct slot *slot;
+    int rcfg_time_us;
+
+    assert(self);
+    assert(request_done);
+
+    sched = (struct scheduler_fred_sharded *)self;
+
+    // Get the slot that has been reconfigured
+    slot = accel_req_get_slot(request_done);
+    assert(slot);
+
+    // Clear devcfg event
+    rcfg_time_us = (int)devcfg_clear_evt(sched->devcfg);
+    if (rcfg_time_us <= 0)
+        return -1;
+
+    logger_log(LOG_LEV_FULL,"\tfred_sys: devcfg, slot: %d of partition: %s"
+                            " rcfg completed for hw-task: %s in %d us",
+                            slot_get_index(slot),
+                            partition_get_name(hw_task_get_partition(
+                                accel_req_get_hw_task(request_done))),
+                            hw_task_get_name(accel_req_get_hw_task(request_done)),
+                            rcfg_time_us);
+
+    hw_task_update_rcfg_est(accel_req_get_hw_task(request_done), rcfg_time_us);
+
+    // Re-enable slot after it has been reconfigured
+    slot_reinit_after_rcfg(slot);
+
+#ifdef RCFG_CHECK
+    // Only for testing
+    // Check if the right hw-task has been reconfigured
+    if (!slot_check_hw_task_consistency(slot)) {
+        ERROR_PRINT("\tfred_sys: critical error: mismatch on slot %d"
+                    " of partition %s for hw-task %s",
+                    slot_get_index(slot),
+                    partition_get_name(hw_task_get_partition(
+                        accel_req_get_hw_task(request_done))),
+                    hw_task_get_name(accel_req_get_hw_task(request_done)));
+
+        return -1;
+    }
+#endif
+
+    // Start the hardware accelerator on its shard
+    return start_slot_(sched, request_done);
+}
+
+// Request cancelled by the client
+static
+int sched_fred_sharded_cancel_accel_req_(struct scheduler *self, struct accel_req *request)
+{
+    struct scheduler_fred_sharded *sched;
+
+    assert(self);
+    assert(request);
+
+    sched = (struct scheduler_fred_sharded *)self;
+
+    accel_req_set_cancelled(request);
+
+    // Not pushed yet, dropped when the previous stage is over
+    if (accel_req_get_chain_wait(request))
+        return 0;
+
+    if (fri_queue_contains(&sched->fri_queue, request)) {
+        accel_req_disarm_deadline(request);
+        fri_queue_remove(&sched->fri_queue, request);
+
+        return arbiter_post_(get_req_shard_(sched, request), SHARD_MSG_RELEASE, request);
+    }
+
+    // Elsewhere the request comes back to the arbiter, unless started by the shard
+    return arbiter_post_(get_req_shard_(sched, request), SHARD_MSG_CANCEL, request);
+}
+
+// Slots events are served by the shards
+static
+int sched_fred_sharded_slot_event_(struct scheduler *self, struct accel_req *request_done)
+{
+    ERROR_PRINT("fred_sys: critical error: slot event on the arbiter\n");
+
+    return -1;
+}
+
+static
+void sched_fred_sharded_free_(struct scheduler *self)
+{
+    struct scheduler_fred_sharded *sched;
+
+    sched = (struct scheduler_fred_sharded *)self;
+
+    if (!sched)
+        return;
+
+    // Stops the shards threads
+    for (int i = 0; i < sched->shards_count; ++i)
+        shard_free_(&sched->shards[i]->scheduler);
+
+    fri_queue_free(&sched->fri_queue);
+    free(sched);
+}
+
+//---------------------------------------------------------------------------------------------
+
+int sched_fred_sharded_start(struct scheduler *self, struct sys_layout *layout,
+                                struct reactor *reactor, enum reactor_type reactor_type)
+{
+    int retval;
+    struct scheduler_fred_sharded *sched;
+    struct sched_shard *shard;
+
+    assert(self);
+    assert(layout);
+    assert(reactor);
+
+    sched = (struct scheduler_fred_sharded *)self;
+
+    // The slots timers move to the shards, the layout wheel serves the FRI queue
+    retval = reactor_add_event_handler(reactor,
+                                        timer_wheel_get_event_handler(layout->timer_wheel),
+                                        REACT_HW_HANDLER, REACT_NOT_OWNED);
+    if (retval)
+        return -1;
+
+    sched->timer_wheel = layout->timer_wheel;
+
+    for (int p = 0; p < layout->partitions_count; ++p) {
+        retval = shard_init_(&shard, sched, layout->partitions[p], reactor_type);
+        if (retval)
+            return -1;
+
+        sched->shards[p] = shard;
+        sched->shards_count++;
+
+        // Completions from the shard are served by the main loop, as hardware events
+        retval = reactor_add_event_handler(reactor, &shard->out_port.handler,
+                                            REACT_HW_HANDLER, REACT_NOT_OWNED);
+        if (retval)
+            return -1;
+    }
+
+    for (int p = 0; p < sched->shards_count; ++p) {
+        retval = shard_start_thread_(sched->shards[p]);
+        if (retval)
+            goto error_stop;
+
+        DBG_PRINT("fred_sys: started shard for partition %s\n",
+                    partition_get_name(sched->shards[p]->partition));
+    }
+
+    return 0;
+
+error_stop:
+    // Slots may be released before the scheduler
+    for (int p = 0; p < sched->shards_count; ++p)
+        shard_stop_thread_(sched->shards[p]);
+
+    return -1;
+}
+
+int sched_fred_sharded_init(struct scheduler **self, const struct sched_fred_params *params,
+                            struct devcfg *devcfg)
+{
+    int retval;
+    struct scheduler_fred_sharded *sched;
+
+    assert(params);
+    assert(devcfg);
+
+    *self = NULL;
+
+    // Allocate and set everything to 0
+    sched = calloc(1, sizeof(*sched));
+    if (!sched)
+        return -1;
+
+    // Set properties and methods
+    sched->mode = params->mode;
+    sched->devcfg = devcfg;
+    sched->lookahead = params->lookahead;
+    sched->aging_limit = params->aging_limit;
+
+    // Scheduler interface
+    sched->scheduler.push_accel_req = sched_fred_sharded_push_accel_req_;
+    sched->scheduler.rcfg_complete = sched_fred_sharded_rcfg_complete_;
+    sched->scheduler.slot_complete = sched_fred_sharded_slot_event_;
+    sched->scheduler.slot_timeout = sched_fred_sharded_slot_event_;
+    sched->scheduler.cancel_accel_req = sched_fred_sharded_cancel_accel_req_;
+    sched->scheduler.free = sched_fred_sharded_free_;
+
+    retval = fri_queue_init(&sched->fri_queue, params->fri_order);
+    if (retval) {
+        free(sched);
+        return -1;
+    }
+
+    DBG_PRINT("fred_sys: FRI queue ordering: %s\n", fri_order_get_name(params->fri_order));
+    if (sched->mode == SCHED_FRED_FAST_SKIP)
+        DBG_PRINT("fred_sys: fast start for requests without rcfg\n");
+    if (sched->lookahead)
+        DBG_PRINT("fred_sys: partition queues look-ahead: %d, aging limit: %d\n",
+                    sched->lookahead, sched->aging_limit);
+
+    *self = &sched->scheduler;
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef SCHEDULER_FRED_SHARDED_H_
+#define SCHEDULER_FRED_SHARDED_H_
+
+#include <pthread.h>
+#include <sys/queue.h>
+
+#include "../parameters.h"
+#include "../utils/spsc_queue.h"
+#include "accel_req.h"
+#include "devcfg.h"
+#include "fri_queue.h"
+#include "reactor.h"
+#include "req_heap.h"
+#include "scheduler.h"
+#include "scheduler_fred.h"
+#include "sys_layout.h"
+#include "timer_wheel.h"
+
+//---------------------------------------------------------------------------------------------
+//
+// Sharded variant of the FRED scheduler. Each partition runs on its own shard
+// thread with a private reactor and timer wheel serving its slots and timers, and
+// its own partition queue. The arbiter runs on the main event loop together with the
+// clients and owns the reconfiguration device and the FRI queue. Requests move between
+// the arbiter and the shards through lock-free SPSC queues paired with an eventfd
+// doorbell.
+//
+//   arbiter --(PUSH)--> shard: search slot, or enqueue into the partition queue
+//   shard --(FRI)--> arbiter: slot reserved, insert request into the FRI queue
+//   arbiter --(START)--> shard: slot reconfigured (or rcfg skipped), start hw-task
+//   shard --(DONE/OVERRUN)--> arbiter: notify the client
+//
+// In fast skip mode a request whose slot already holds its hw-task is started by
+// the shard right away, skipping the FRI and START messages.
+//
+// The next stage of a chain is pushed by the arbiter on DONE, its slot is not
+// prepared in advance as in the single loop scheduler.
+//
+// A request expired in the FRI queue goes back to its shard to release the reserved
+// slot (RELEASE), then to the arbiter to notify the client (EXPIRED). Requests expired
+// in the partition queue are notified directly (EXPIRED).
+//
+// A cancelled request is flagged by the arbiter, which drops it instead of queuing it
+// into the FRI queue or starting it (RELEASE, then EXPIRED notified as cancelled). If it
+// may be in the partition queue its shard is asked to unlink it (CANCEL, CANCELLED).
+//
+//---------------------------------------------------------------------------------------------
+
+enum shard_msg_type {
+    // Arbiter to shard
+    SHARD_MSG_PUSH,                 // New request for the partition
+    SHARD_MSG_START,                // Slot ready, start the hw-task
+    SHARD_MSG_RELEASE,              // Expired or cancelled, release the slot
+    SHARD_MSG_CANCEL,               // Cancelled, unlink it from the partition queue
+    SHARD_MSG_STOP,                 // Terminate the shard thread
+
+    // Shard to arbiter
+    SHARD_MSG_FRI,                  // Slot reserved, insert into the FRI queue
+    SHARD_MSG_DONE,                 // Execution completed
+    SHARD_MSG_OVERRUN,              // Execution timeout
+    SHARD_MSG_EXPIRED,              // Deadline passed while queued (or slot released)
+    SHARD_MSG_CANCELLED,            // Unlinked from the partition queue
+    SHARD_MSG_EXIT                  // Shard event loop terminated on error
+};
+
+struct sched_shard;
+
+// Doorbell endpoint of a shard queue
+struct shard_port {
+    // ------------------------//
+    struct event_handler handler;   // Handler interface
+    // ------------------------//
+
+    int efd;
+    struct sched_shard *shard;
+};
+
+struct sched_shard {
+    // ------------------------//
+    struct scheduler scheduler;     // Partition-level scheduler (slots and timers)
+    // ------------------------//
+
+    struct partition *partition;
+
+    struct scheduler_fred_sharded *arbiter;
+
+    // Partition queue (earliest deadline first), accessed only by the shard thread
+    struct req_heap part_queue;
+
+    struct reactor *reactor;
+    struct timer_wheel *timer_wheel;
+    pthread_t thread;
+    int started;
+    int stopping;
+
+    // Arbiter to shard (consumed on the shard reactor)
+    struct spsc_queue in_queue;
+    struct shard_port in_port;
+
+    // Shard to arbiter (consumed on the main reactor)
+    struct spsc_queue out_queue;
+    struct shard_port out_port;
+};
+
+struct scheduler_fred_sharded {
+    // ------------------------//
+    struct scheduler scheduler;
+    // ------------------------//
+
+    enum sched_fred_mode mode;
+
+    // Partition queues look-ahead, read by the shards
+    int lookahead;
+    int aging_limit;
+
+    // Reconfiguration device queue
+    struct fri_queue fri_queue;
+
+    // Deadline timers of the requests in the FRI queue (main loop wheel)
+    struct timer_wheel *timer_wheel;
+
+    // Reconfiguration device
+    struct devcfg *devcfg;
+
+    // One shard for each partition
+    struct sched_shard *shards[MAX_PARTITIONS];
+    int shards_count;
+};
+
+//---------------------------------------------------------------------------------------------
+
+int sched_fred_sharded_init(struct scheduler **self, const struct sched_fred_params *params,
+                            struct devcfg *devcfg);
+
+// Create one pinned shard thread for each partition of the layout. Slots and timers
+// are moved to the shards reactors (they must not be registered on the main reactor)
+int sched_fred_sharded_start(struct scheduler *self, struct sys_layout *layout,
+                                struct reactor *reactor, enum reactor_type reactor_type);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* SCHEDULER_FRED_SHARDED_H_ */
@@ -17,6 +17,7 @@
 #include <stdint.h>
 
 #include "event_handler.h"
+#include "reactor.h"
 #include "accel_req.h"
 #include "hw_task.h"
 #include "scheduler.h"
@@ -34,6 +35,10 @@
 //                  ^                                                     |
 //                  |-----------------------------------------------------|
 //
+// Available slots (SLOT_BLANK and SLOT_IDLE) are tracked in the partition mask, idle
+// slots also in the residency mask of their hw-task. In sharded mode the masks are
+// updated only by the shard: the arbiter never changes the availability of a slot.
+//
 //---------------------------------------------------------------------------------------------
 
 struct slot {
@@ -58,7 +63,9 @@ struct slot {
 
     int index;
 
+    struct partition *partition;
     struct scheduler *scheduler;
+    struct reactor *reactor;        // Serving the slot, to post polled completions
 
     // Holds the request associated to the
     // current executing hw-task
@@ -71,6 +78,23 @@ struct slot {
 
 //---------------------------------------------------------------------------------------------
 
+// In sharded mode the arbiter moves the slot between the reserved states while
+// the shard checks its availability. Other fields are handed over through the
+// shard queues, the state only needs to be read and written atomically.
+static inline
+enum slot_state slot_get_state_(const struct slot *self)
+{
+    return __atomic_load_n(&self->state, __ATOMIC_RELAXED);
+}
+
+static inline
+void slot_set_state_(struct slot *self, enum slot_state state)
+{
+    __atomic_store_n(&self->state, state, __ATOMIC_RELAXED);
+}
+
+//---------------------------------------------------------------------------------------------
+
 static inline
 struct event_handler *slot_get_event_handler(struct slot *self)
 {
@@ -91,10 +115,22 @@ int slot_get_index(const struct slot *self)
 
 static inline
 int slot_is_available(const struct slot *self)
+{
+    enum slot_state state;
+
+    assert(self);
+
+    state = slot_get_state_(self);
+
+    return state == SLOT_IDLE || state == SLOT_BLANK;
+}
+
+static inline
+int slot_is_blank(const struct slot *self)
 {
     assert(self);
 
-    return self->state == SLOT_IDLE || self->state == SLOT_BLANK;
+    return slot_get_state_(self) == SLOT_BLANK;
 }
 
 static inline
@@ -102,18 +138,57 @@ int slot_match_hw_task(const struct slot *self, const struct hw_task *hw_task)
 {
     assert(self);
 
-    if (self->state != SLOT_IDLE)
+    if (slot_get_state_(self) != SLOT_IDLE)
         return 0;
 
     return hw_task_get_id(self->hw_task) == hw_task_get_id(hw_task);
 }
 
+// Hw-task left in the slot if idle, NULL otherwise
+static inline
+struct hw_task *slot_get_idle_hw_task(const struct slot *self)
+{
+    assert(self);
+
+    if (slot_get_state_(self) != SLOT_IDLE)
+        return NULL;
+
+    return self->hw_task;
+}
+
+static inline
+void slot_attach_scheduler(struct slot *self, struct scheduler *scheduler)
+{
+    assert(self);
+    assert(scheduler);
+
+    self->scheduler = scheduler;
+}
+
+static inline
+void slot_attach_reactor(struct slot *self, struct reactor *reactor)
+{
+    assert(self);
+    assert(reactor);
+
+    self->reactor = reactor;
+}
+
+static inline
+void slot_attach_partition(struct slot *self, struct partition *partition)
+{
+    assert(self);
+    assert(partition);
+
+    self->partition = partition;
+}
+
 static inline
 void slot_set_hw_task(struct slot *self, struct hw_task *hw_task)
 {
     assert(self);
     assert(hw_task);
-    assert(self->state == SLOT_RCFG);
+    assert(slot_get_state_(self) == SLOT_RCFG);
 
     self->hw_task = hw_task;
 }
@@ -133,75 +208,133 @@ static inline
 void slot_set_reserved(struct slot *self)
 {
     assert(self);
-    assert(self->state == SLOT_IDLE || self->state == SLOT_BLANK);
+    assert(slot_get_state_(self) == SLOT_IDLE || slot_get_state_(self) == SLOT_BLANK);
+
+    if (slot_get_state_(self) == SLOT_IDLE)
+        hw_task_clear_resident(self->hw_task, self->index);
 
-    self->state = SLOT_RSRV;
+    partition_clear_slot_avail(self->partition, self->index);
+    slot_set_state_(self, SLOT_RSRV);
+}
+
+// Give back a reserved (possibly already reconfigured) slot that will not be used
+static inline
+void slot_release_reserved(struct slot *self)
+{
+    assert(self);
+    assert(slot_get_state_(self) == SLOT_RSRV || slot_get_state_(self) == SLOT_READY);
+
+    if (self->hw_task) {
+        hw_task_set_resident(self->hw_task, self->index);
+        slot_set_state_(self, SLOT_IDLE);
+        partition_set_slot_avail(self->partition, self->index);
+    } else {
+        slot_set_state_(self, SLOT_BLANK);
+        partition_set_slot_blank(self->partition, self->index);
+    }
 }
 
 static inline
 void slot_prepare_for_rcfg(struct slot *self)
 {
     assert(self);
-    assert(self->state == SLOT_RSRV);
+    assert(slot_get_state_(self) == SLOT_RSRV);
 
     decoup_drv_decouple(self->dec_dev);
-    self->state = SLOT_RCFG;
+    slot_set_state_(self, SLOT_RCFG);
 }
 
 static inline
 void slot_reinit_after_rcfg(struct slot *self)
 {
     assert(self);
-    assert(self->state == SLOT_RCFG);
+    assert(slot_get_state_(self) == SLOT_RCFG);
 
-    self->state = SLOT_READY;
+    slot_set_state_(self, SLOT_READY);
     decoup_drv_couple(self->dec_dev);
     slot_drv_after_rcfg(self->slot_dev);
 }
 
+// Speculative reconfiguration completed and no request claimed the slot
+static inline
+void slot_set_idle_after_prefetch(struct slot *self)
+{
+    assert(self);
+    assert(slot_get_state_(self) == SLOT_READY);
+
+    slot_set_state_(self, SLOT_IDLE);
+    hw_task_set_resident(self->hw_task, self->index);
+    partition_set_slot_avail(self->partition, self->index);
+    partition_note_slot_load(self->partition, self->index,
+                                hw_task_get_reload_cost(self->hw_task, self->index));
+}
+
+// Short hw-tasks completion is busy waited for a while, the completion is then served
+// in the next round of the event loop, as signalled by the interrupt (that is
+// masked meanwhile). If it takes longer the interrupt is back in charge
 static inline
 int slot_start_compute(struct slot *self, struct accel_req *exec_req)
 {
     int retval;
+    int polled;
+    uint64_t spin_us;
 
     assert(self);
     assert(exec_req);
-    assert(self->state == SLOT_READY || self->state == SLOT_RSRV);
+    assert(slot_get_state_(self) == SLOT_READY || slot_get_state_(self) == SLOT_RSRV);
+
+    partition_note_slot_start(self->partition, self->index,
+                                slot_get_state_(self) == SLOT_RSRV);
 
     // Bind request to the slot
     self->exec_req = exec_req;
-    self->state = SLOT_EXEC;
+    slot_set_state_(self, SLOT_EXEC);
+
+    spin_us = hw_task_get_spin_us(accel_req_get_hw_task(exec_req));
+    polled = spin_us && self->reactor && reactor_can_post(self->reactor);
+    slot_drv_set_polled(self->slot_dev, polled);
 
     // And start
     retval = slot_drv_start_compute(self->slot_dev,
                                     accel_req_get_args(exec_req),
                                     accel_req_get_args_size(exec_req));
+    if (retval || !polled)
+        return retval;
+
+    if (slot_drv_wait_for_compl(self->slot_dev, spin_us))
+        return reactor_post_event(self->reactor, &self->handler);
 
-    return retval;
+    return 0;
 }
 
 static inline
 void slot_disable_after_timeout(struct slot *self)
 {
     assert(self);
-    assert(self->state == SLOT_EXEC);
+    assert(slot_get_state_(self) == SLOT_EXEC);
 
     // Suspend the slot until the next reconfiguration
     decoup_drv_decouple(self->dec_dev);
 
     // Set blank to avoid reuse and force a new reconfiguration
-    self->state = SLOT_BLANK;
+    self->hw_task = NULL;
+    slot_set_state_(self, SLOT_BLANK);
+    partition_set_slot_blank(self->partition, self->index);
 }
 
 static inline
 void slot_clear_after_compute(struct slot *self)
 {
     assert(self);
-    assert(self->state == SLOT_EXEC);
+    assert(slot_get_state_(self) == SLOT_EXEC);
 
     slot_drv_after_compute(self->slot_dev);
 
-    self->state = SLOT_IDLE;
+    slot_set_state_(self, SLOT_IDLE);
+    hw_task_set_resident(self->hw_task, self->index);
+    partition_set_slot_avail(self->partition, self->index);
+    partition_note_slot_use(self->partition, self->index,
+                            hw_task_get_reload_cost(self->hw_task, self->index));
 }
 
 //---------------------------------------------------------------------------------------------
@@ -16,20 +16,18 @@
 #include <assert.h>
 #include <stdint.h>
 
-#include "event_handler.h"
 #include "accel_req.h"
-#include "fd_timer.h"
+#include "timer_wheel.h"
 #include "scheduler.h"
-#include "accel_req.h"
 
 //---------------------------------------------------------------------------------------------
 
 struct slot_timer {
     // ------------------------//
-    struct event_handler handler;   // Handler interface
+    struct wheel_timer wheel_timer; // Timer wheel entry
     // ------------------------//
 
-    struct fd_timer fd_timer;       // Handle
+    struct timer_wheel *wheel;
 
     // Current executing request
     struct accel_req *exec_req;
@@ -40,14 +38,24 @@ struct slot_timer {
 //---------------------------------------------------------------------------------------------
 
 static inline
-struct event_handler *slot_timer_get_event_handler(struct slot_timer *self)
+void slot_timer_attach_scheduler(struct slot_timer *self, struct scheduler *scheduler)
 {
     assert(self);
+    assert(scheduler);
 
-    return &self->handler;
+    self->scheduler = scheduler;
 }
 
-//---------------------------------------------------------------------------------------------
+// Move to the timer wheel of another event loop (timer must be disarmed)
+static inline
+void slot_timer_attach_wheel(struct slot_timer *self, struct timer_wheel *wheel)
+{
+    assert(self);
+    assert(wheel);
+    assert(!wheel_timer_is_armed(&self->wheel_timer));
+
+    self->wheel = wheel;
+}
 
 static inline
 int slot_timer_arm(struct slot_timer *self, uint64_t duration_us, struct accel_req *exec_req)
@@ -57,33 +65,28 @@ int slot_timer_arm(struct slot_timer *self, uint64_t duration_us, struct accel_r
 
     self->exec_req = exec_req;
 
-    return fd_timer_arm(&self->fd_timer, duration_us);
+    return timer_wheel_arm(self->wheel, &self->wheel_timer, duration_us);
 }
 
 static inline
 int slot_timer_disarm(struct slot_timer *self, uint64_t *elapsed_us)
 {
-    int retval;
-
     assert(self);
     assert(elapsed_us);
 
     self->exec_req = NULL;
 
-    retval = fd_timer_get_elapsed_us(&self->fd_timer, elapsed_us);
-    if (retval)
-        return -1;
-
-    retval = fd_timer_disarm(&self->fd_timer);
-    if (retval)
-        return -1;
+    *elapsed_us = timer_wheel_disarm(self->wheel, &self->wheel_timer);
 
     return 0;
 }
 
 //---------------------------------------------------------------------------------------------
 
-int slot_timer_init(struct slot_timer **self, struct scheduler *scheduler);
+int slot_timer_init(struct slot_timer **self, struct scheduler *scheduler,
+                    struct timer_wheel *wheel);
+
+void slot_timer_free(struct slot_timer *self);
 
 //---------------------------------------------------------------------------------------------
 
@@ -15,11 +15,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 #include "sw_task_client.h"
@@ -65,35 +67,693 @@ void free_all_data_buff_(struct sw_task_client *self)
     }
 }
 
+// The data buffers are released with the client, once no request can reference them
+static
+void release_(struct sw_task_client *self)
+{
+    free_all_data_buff_(self);
+    free(self);
+}
+
+// Client level errors: hang up the connection, the client
+// will be detached through the socket handler
 static inline
-int write_to_client_(int socket, const void *data, unsigned int data_len)
+void hang_up_(struct sw_task_client *self)
+{
+    self->hung_up = 1;
+    shutdown(self->conn_sock, SHUT_RDWR);
+}
+
+// Ask the reactor for output readiness only while replies are queued,
+// and for input readiness only while the client is not throttled
+static
+int update_interest_(struct sw_task_client *self)
 {
     int retval;
+    int interest = 0;
+
+    if (!self->throttled)
+        interest |= REACT_INTEREST_IN;
+    if (!out_queue_is_empty(&self->out_queue))
+        interest |= REACT_INTEREST_OUT;
+
+    if (interest == self->interest)
+        return 0;
+
+    retval = reactor_set_interest(self->reactor, &self->handler, interest);
+    if (retval)
+        return 1;
+
+    self->interest = interest;
+
+    return 0;
+}
+
+// Replies the socket cannot take are queued. A client that cannot
+// keep up with its replies (queue full) is hung up
+static
+int send_to_client_(struct sw_task_client *self, const struct iovec *iov, int iovcnt,
+                    const int *fds, int fds_count)
+{
+    int retval;
+
+    // The connection is gone, the requests are only given back to the pool
+    if (self->detached)
+        return 0;
+
+    retval = out_queue_send(&self->out_queue, self->conn_sock, iov, iovcnt, fds, fds_count);
+    if (retval > 0) {
+        ERROR_PRINT("fred_sys: client not reading its replies: hanging up client\n");
+        hang_up_(self);
+        return 1;
 
-    retval = write(socket, data, data_len);
-    if (retval != data_len) {
+    } else if (retval < 0) {
         ERROR_PRINT("fred_sys: unable to reach client. Error: %s\n", strerror(errno));
+        hang_up_(self);
+        return 1;
+    }
+
+    if (!self->throttled && out_queue_get_len(&self->out_queue) > self->out_high_water) {
+        DBG_PRINT("fred_sys: client on fd: %d throttled\n", self->conn_sock);
+        self->throttled = 1;
+    }
+
+    retval = update_interest_(self);
+    if (retval) {
+        hang_up_(self);
         return 1;
     }
 
     return 0;
 }
 
+// A message and its payload in a single write (a single packet if sequenced)
 static inline
-int send_fred_message_(int socket, int head, uint32_t arg)
+int send_fred_message_payload_(struct sw_task_client *self, int head, uint32_t arg,
+                                uint32_t req_id, const void *payload, size_t payload_len)
 {
     struct fred_msg msg;
+    struct iovec iov[2];
 
     msg.head = head;
     msg.arg = arg;
+    msg.req_id = req_id;
+    msg.deadline_us = 0;
+
+    iov[0].iov_base = &msg;
+    iov[0].iov_len = sizeof(msg);
+    iov[1].iov_base = (void *)payload;
+    iov[1].iov_len = payload_len;
+
+    return send_to_client_(self, iov, payload_len ? 2 : 1, NULL, 0);
+}
+
+static inline
+int send_fred_message_(struct sw_task_client *self, int head, uint32_t arg, uint32_t req_id)
+{
+    return send_fred_message_payload_(self, head, arg, req_id, NULL, 0);
+}
+
+// Get a request from the pool, NULL if all requests are outstanding
+static inline
+struct accel_req *get_free_req_(struct sw_task_client *self)
+{
+    struct accel_req *request;
+
+    if (TAILQ_EMPTY(&self->free_reqs))
+        return NULL;
+
+    request = TAILQ_FIRST(&self->free_reqs);
+    TAILQ_REMOVE(&self->free_reqs, request, queue_elem);
+    self->req_pending[request - self->accel_reqs] = 1;
+    self->pending_reqs++;
+
+    return request;
+}
+
+static inline
+void put_free_req_(struct sw_task_client *self, struct accel_req *request)
+{
+    TAILQ_INSERT_TAIL(&self->free_reqs, request, queue_elem);
+    self->req_pending[request - self->accel_reqs] = 0;
+    self->pending_reqs--;
+}
+
+// Index of a hw-task among the client's ones
+static inline
+int get_task_idx_(const struct sw_task_client *self, const struct hw_task *hw_task)
+{
+    for (int i = 0; i < self->hw_tasks_count; ++i) {
+        if (self->hw_tasks[i] == hw_task)
+            return i;
+    }
 
-    return write_to_client_(socket, &msg, sizeof(msg));
+    return -1;
 }
 
+// Build an acceleration request for one of the client's hw-tasks.
+// Returns 1 if the request cannot be accepted
 static
-int send_user_data_buffs_(struct sw_task_client *self, int task_idx)
+int build_run_req_(struct sw_task_client *self, uint32_t hw_task_id, uint32_t req_id,
+                    uint32_t deadline_us, struct accel_req **request)
+{
+    int idx = -1;
+    int data_buffs_count;
+
+    // Find requested hw-task
+    for (int i = 0; i < self->hw_tasks_count; ++i) {
+        if (hw_task_get_id(self->hw_tasks[i]) == hw_task_id) {
+            idx = i;
+            break;
+        }
+    }
+
+    // If the requested hw-task is not associated with this sw-task
+    if (idx < 0)
+        return 1;
+
+    // If the hw-task exist but it has been already disable due to an overrun
+    if (hw_task_get_banned(self->hw_tasks[idx]))
+        return 1;
+
+    // Too many outstanding requests
+    *request = get_free_req_(self);
+    if (!(*request))
+        return 1;
+
+    // The hw-task exist: build the acceleration request
+    accel_req_unbind(*request);
+    accel_req_set_req_id(*request, req_id);
+    accel_req_set_rel_deadline_us(*request, deadline_us);
+    accel_req_set_hw_task(*request, self->hw_tasks[idx]);
+    // Set hardware arguments (memory buffer pointers)
+    data_buffs_count = hw_task_get_data_buffs_count(self->hw_tasks[idx]);
+    accel_req_set_args_size(*request, data_buffs_count);
+    for (int j = 0; j < data_buffs_count; ++j) {
+        accel_req_set_args(*request, j,
+            fred_buff_if_get_phy_addr(self->data_buffs_ifs[idx][j]));
+    }
+
+    return 0;
+}
+
+static
+int send_batch_reply_(struct sw_task_client *self, const struct client_batch *batch)
+{
+    // Followed by the outcome of each job
+    return send_fred_message_payload_(self, FRED_MSG_BATCH_DONE, batch->finished,
+                                        batch->batch_id, batch->heads,
+                                        sizeof(batch->heads[0]) * batch->jobs_count);
+}
+
+// Record the outcome of a job of a batch. The client gets a reply
+// when the threshold is reached and when the last job finishes
+static
+int finish_batch_job_(struct sw_task_client *self, struct client_batch *batch, int job,
+                        uint32_t head)
+{
+    int retval = 0;
+
+    batch->heads[job] = head;
+    batch->finished++;
+
+    if (batch->finished == batch->threshold || batch->finished == batch->jobs_count)
+        retval = send_batch_reply_(self, batch);
+
+    if (batch->finished == batch->jobs_count)
+        batch->in_use = 0;
+
+    return retval;
+}
+
+// Build all the jobs of the batch, then push them into the scheduler
+// Return values as process_msg_()
+static
+int run_batch_(struct sw_task_client *self, const struct fred_msg *msg, const void *payload)
+{
+    int retval;
+    int idx;
+    int jobs_count;
+    int threshold;
+    uint32_t batch_id;
+    struct client_batch *batch = NULL;
+    struct fred_batch_job jobs[FRED_BATCH_MAX_JOBS];
+    struct accel_req *requests[FRED_BATCH_MAX_JOBS];
+
+    batch_id = fred_msg_get_req_id(msg);
+    jobs_count = fred_msg_get_batch_jobs(msg);
+    threshold = fred_msg_get_batch_threshold(msg);
+
+    // The jobs follow the message (length checked by the framing)
+    memcpy(jobs, payload, sizeof(jobs[0]) * jobs_count);
+
+    // Clients using the rings must submit through the rings
+    if (self->state != CLIENT_READY || self->ring || !jobs_count)
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, batch_id);
+
+    for (int i = 0; i < MAX_CLIENT_REQS; ++i) {
+        if (!self->batches[i].in_use) {
+            batch = &self->batches[i];
+            break;
+        }
+    }
+
+    // Each batch holds at least one request of the pool
+    if (!batch)
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, batch_id);
+
+    batch->in_use = 1;
+    batch->is_chain = 0;
+    batch->batch_id = batch_id;
+    batch->jobs_count = jobs_count;
+    batch->threshold = (threshold && threshold < jobs_count) ? threshold : jobs_count;
+    batch->finished = 0;
+    memset(batch->heads, 0, sizeof(batch->heads));
+
+    // Jobs that cannot be accepted are reported in the batch reply
+    for (int i = 0; i < jobs_count; ++i) {
+        retval = build_run_req_(self, jobs[i].hw_task_id, i, jobs[i].deadline_us,
+                                &requests[i]);
+        if (retval) {
+            requests[i] = NULL;
+            retval = finish_batch_job_(self, batch, i, FRED_MSG_ERROR);
+            if (retval) {
+                // The jobs built so far were never passed to the scheduler
+                for (int j = 0; j < i; ++j) {
+                    if (!requests[j])
+                        continue;
+
+                    self->req_batches[requests[j] - self->accel_reqs] = NULL;
+                    put_free_req_(self, requests[j]);
+                }
+                batch->in_use = 0;
+
+                return retval;
+            }
+            continue;
+        }
+
+        idx = requests[i] - self->accel_reqs;
+        self->req_batches[idx] = batch;
+        self->req_jobs[idx] = i;
+    }
+
+    // Pass all acceleration requests to the scheduler
+    for (int i = 0; i < jobs_count; ++i) {
+        if (!requests[i])
+            continue;
+
+        retval = scheduler_push_accel_req(self->scheduler, requests[i]);
+        if (retval)
+            return retval;
+    }
+
+    return 0;
+}
+
+// Set the arguments registers from the client descriptors. The buffers of the
+// stages preceding the request in a chain can be referenced (stages may be NULL).
+// Returns 1 if an argument is not valid
+static
+int set_run_args_(struct sw_task_client *self, struct accel_req *request,
+                    const struct fred_arg *args, int args_count,
+                    struct accel_req *const *stages, int stages_count)
+{
+    int task_idx;
+    uint32_t buff_idx;
+    struct fred_buff_if *buff_if;
+    uint64_t buff_len;
+
+    for (int i = 0; i < args_count; ++i) {
+        task_idx = get_task_idx_(self, accel_req_get_hw_task(request));
+        buff_idx = args[i].buff_idx;
+
+        switch (args[i].type) {
+        case FRED_ARG_SCALAR:
+#if UINTPTR_MAX < UINT64_MAX
+            // Would be truncated by the slot registers
+            if (args[i].value > UINTPTR_MAX)
+                return 1;
+#endif
+            accel_req_set_args(request, i, (uintptr_t)args[i].value);
+            break;
+
+        case FRED_ARG_STAGE_BUFF:
+            if (buff_idx >> 16 >= (uint32_t)stages_count)
+                return 1;
+
+            task_idx = get_task_idx_(self, accel_req_get_hw_task(stages[buff_idx >> 16]));
+            buff_idx &= 0xffff;
+            // Fall through
+
+        case FRED_ARG_BUFF:
+            assert(task_idx >= 0);
+
+            if (buff_idx >= (uint32_t)hw_task_get_data_buffs_count(self->hw_tasks[task_idx]))
+                return 1;
+
+            // The window must lie within the buffer
+            buff_if = self->data_buffs_ifs[task_idx][buff_idx];
+            buff_len = fred_buff_if_get_lenght(buff_if);
+            if (args[i].value > buff_len || args[i].length > buff_len - args[i].value)
+                return 1;
+
+            accel_req_set_args(request, i,
+                                fred_buff_if_get_phy_addr(buff_if) + args[i].value);
+            break;
+
+        default:
+            return 1;
+        }
+    }
+
+    accel_req_set_args_size(request, args_count);
+
+    return 0;
+}
+
+// Return values as process_msg_()
+static
+int run_args_(struct sw_task_client *self, const struct fred_msg *msg, const void *payload)
+{
+    int retval;
+    uint32_t req_id;
+    uint32_t args_count;
+    struct fred_arg args[FRED_RUN_MAX_ARGS];
+    struct accel_req *request;
+
+    req_id = fred_msg_get_req_id(msg);
+
+    // The arguments follow the message (length checked by the framing)
+    memcpy(&args_count, payload, sizeof(args_count));
+    memcpy(args, (const char *)payload + sizeof(args_count), sizeof(args[0]) * args_count);
+
+    // Clients using the rings must submit through the rings
+    if (self->state != CLIENT_READY || self->ring || args_count > HW_OP_ARGS_SIZE)
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, req_id);
+
+    retval = build_run_req_(self, fred_msg_get_arg(msg), req_id,
+                            fred_msg_get_deadline_us(msg), &request);
+    if (retval)
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, req_id);
+
+    retval = set_run_args_(self, request, args, args_count, NULL, 0);
+    if (retval) {
+        put_free_req_(self, request);
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, req_id);
+    }
+
+    // Pass acceleration request to the scheduler
+    return scheduler_push_accel_req(self->scheduler, request);
+}
+
+static
+int send_chain_reply_(struct sw_task_client *self, const struct client_batch *chain)
+{
+    // Followed by the outcome of each stage
+    return send_fred_message_payload_(self, FRED_MSG_CHAIN_DONE, chain->finished,
+                                        chain->batch_id, chain->heads,
+                                        sizeof(chain->heads[0]) * chain->jobs_count);
+}
+
+// Record the outcome of a stage of a chain. The stages are notified in order: the
+// following one has been (or will be) passed to the scheduler only if the stage was
+// started. Otherwise the chain is over and the remaining stages go back to the pool
+static
+int finish_chain_stage_(struct sw_task_client *self, struct client_batch *chain, int stage,
+                        enum notify_action_msg msg, uint32_t head)
+{
+    int idx;
+
+    chain->reqs[stage] = NULL;
+
+    if (msg == NOTIFY_ACTION_DONE) {
+        chain->heads[stage] = head;
+        chain->finished++;
+    } else if (msg != NOTIFY_ACTION_ABORTED) {
+        chain->heads[stage] = head;
+    }
+
+    if (stage < chain->jobs_count - 1 &&
+        (msg == NOTIFY_ACTION_DONE || msg == NOTIFY_ACTION_OVERRUN))
+        return 0;
+
+    for (int i = stage + 1; i < chain->jobs_count; ++i) {
+        if (chain->reqs[i]) {
+            idx = chain->reqs[i] - self->accel_reqs;
+            self->req_batches[idx] = NULL;
+            put_free_req_(self, chain->reqs[i]);
+            chain->reqs[i] = NULL;
+        }
+    }
+
+    chain->in_use = 0;
+
+    return send_chain_reply_(self, chain);
+}
+
+// Build all the stages of the chain, then push the first one into the scheduler,
+// which passes on each following stage when the previous one is started
+// Return values as process_msg_()
+static
+int run_chain_(struct sw_task_client *self, const struct fred_msg *msg, const void *payload)
+{
+    int retval;
+    int idx;
+    int stages_count;
+    uint32_t chain_id;
+    struct client_batch *chain = NULL;
+    struct fred_chain_stage stages[FRED_CHAIN_MAX_STAGES];
+    struct accel_req *requests[FRED_CHAIN_MAX_STAGES];
+
+    chain_id = fred_msg_get_req_id(msg);
+    stages_count = fred_msg_get_arg(msg);
+
+    // The stages follow the message (length checked by the framing)
+    memcpy(stages, payload, sizeof(stages[0]) * stages_count);
+
+    // Clients using the rings must submit through the rings
+    if (self->state != CLIENT_READY || self->ring || !stages_count)
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, chain_id);
+
+    for (int i = 0; i < MAX_CLIENT_REQS; ++i) {
+        if (!self->batches[i].in_use) {
+            chain = &self->batches[i];
+            break;
+        }
+    }
+
+    if (!chain)
+        return send_fred_message_(self, FRED_MSG_ERROR, 0, chain_id);
+
+    // The chain is accepted only if all its stages are valid
+    for (int i = 0; i < stages_count; ++i) {
+        retval = build_run_req_(self, stages[i].hw_task_id, i, stages[i].deadline_us,
+                                &requests[i]);
+
+        // No arguments means the base addresses of the data buffers
+        if (!retval && stages[i].args_count) {
+            if (stages[i].args_count > FRED_RUN_MAX_ARGS ||
+                stages[i].args_count > HW_OP_ARGS_SIZE)
+                retval = 1;
+            else
+                retval = set_run_args_(self, requests[i], stages[i].args,
+                                        stages[i].args_count, requests, i);
+            if (retval)
+                put_free_req_(self, requests[i]);
+        }
+
+        if (retval) {
+            for (int j = 0; j < i; ++j)
+                put_free_req_(self, requests[j]);
+
+            return send_fred_message_(self, FRED_MSG_ERROR, 0, chain_id);
+        }
+    }
+
+    chain->in_use = 1;
+    chain->is_chain = 1;
+    chain->batch_id = chain_id;
+    chain->jobs_count = stages_count;
+    chain->threshold = stages_count;
+    chain->finished = 0;
+    memset(chain->heads, 0, sizeof(chain->heads));
+
+    for (int i = 0; i < stages_count; ++i) {
+        if (i < stages_count - 1)
+            accel_req_set_chain_next(requests[i], requests[i + 1]);
+
+        chain->reqs[i] = requests[i];
+        idx = requests[i] - self->accel_reqs;
+        self->req_batches[idx] = chain;
+        self->req_jobs[idx] = i;
+    }
+
+    // Pass the first stage to the scheduler
+    return scheduler_push_accel_req(self->scheduler, requests[0]);
+}
+
+// Cancel the outstanding requests matching req_id: a job submitted alone, or all the
+// jobs of a batch (or stages of a chain). Each request is notified as usual, possibly
+// right away. Returns -1 on scheduler error
+static
+int cancel_reqs_(struct sw_task_client *self, uint32_t req_id, int all)
+{
+    int retval;
+    struct client_batch *batch;
+    struct accel_req *request;
+
+    // Notifications may give back other requests meanwhile (stages of a chain)
+    for (int i = 0; i < MAX_CLIENT_REQS; ++i) {
+        if (!self->req_pending[i])
+            continue;
+
+        request = &self->accel_reqs[i];
+        batch = self->req_batches[i];
+
+        if (!all && (batch ? batch->batch_id : accel_req_get_req_id(request)) != req_id)
+            continue;
+
+        if (accel_req_get_cancelled(request))
+            continue;
+
+        retval = scheduler_cancel_accel_req(self->scheduler, request);
+        if (retval)
+            return -1;
+    }
+
+    return 0;
+}
+
+// The client is about to be detached by the reactor. Nothing is sent from now on, the
+// requests not started yet are dropped. Return values as the event handler methods
+static
+int detach_(struct sw_task_client *self)
+{
+    int retval;
+
+    self->detached = 1;
+
+    retval = cancel_reqs_(self, 0, 1);
+    if (retval) {
+        ERROR_PRINT("fred_sys: critical error while cancelling client requests\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+// Client level errors on the ring
+static inline
+void hang_up_ring_(struct sw_task_client *self)
+{
+    ERROR_PRINT("fred_sys: ring error: hanging up client\n");
+    hang_up_(self);
+}
+
+// The acknowledge carries the other options granted
+static
+int init_ring_(struct sw_task_client *self, uint32_t granted)
 {
     int retval;
+    int fds[3];
+    struct fred_msg msg;
+    struct iovec iov;
+
+    // Fall back to the socket protocol if the rings are not available
+    retval = sw_task_ring_init(&self->ring, self);
+    if (retval)
+        return send_fred_message_(self, FRED_MSG_ACK, granted, 0);
+
+    retval = reactor_add_event_handler(self->reactor,
+                                        sw_task_ring_get_event_handler(self->ring),
+                                        REACT_NORMAL_HANDLER, REACT_NOT_OWNED);
+    if (retval) {
+        event_handler_free(sw_task_ring_get_event_handler(self->ring));
+        self->ring = NULL;
+        return send_fred_message_(self, FRED_MSG_ACK, granted, 0);
+    }
+
+    // Acknowledge and pass the rings file descriptors
+    fred_msg_set_head(&msg, FRED_MSG_ACK);
+    fred_msg_set_arg(&msg, granted | FRED_INIT_RING);
+    fred_msg_set_req_id(&msg, 0);
+    fred_msg_set_deadline_us(&msg, 0);
+    sw_task_ring_get_fds(self->ring, fds);
+
+    iov.iov_base = &msg;
+    iov.iov_len = sizeof(msg);
+
+    retval = send_to_client_(self, &iov, 1, fds, 3);
+    if (retval)
+        return 1;
+
+    DBG_PRINT("fred_sys: client on fd: %d using shared memory rings\n", self->conn_sock);
+
+    return 0;
+}
+
+// Open the data buffers and pass them to the client, the
+// client gets its own references, ours are closed afterwards
+static
+int send_data_buffs_fds_(struct sw_task_client *self, int task_idx)
+{
+    int retval = 0;
+    int data_buffs_count;
+    int fds[MAX_DATA_BUFFS];
+    int fds_count = 0;
+    char dev_name[MAX_PATH];
+    struct fred_msg msg;
+    char data[sizeof(msg) + sizeof(uint64_t) * MAX_DATA_BUFFS];
+    uint64_t length;
+    struct iovec iov;
+
+    data_buffs_count = hw_task_get_data_buffs_count(self->hw_tasks[task_idx]);
+
+    fred_msg_set_head(&msg, FRED_MSG_BUFFS);
+    fred_msg_set_arg(&msg, data_buffs_count);
+    fred_msg_set_req_id(&msg, 0);
+    fred_msg_set_deadline_us(&msg, 0);
+    memcpy(data, &msg, sizeof(msg));
+
+    iov.iov_base = data;
+    iov.iov_len = sizeof(msg) + sizeof(length) * data_buffs_count;
+
+    if (!data_buffs_count)
+        return send_to_client_(self, &iov, 1, NULL, 0);
+
+    for (int i = 0; i < data_buffs_count; ++i) {
+        // Convert device name (from kernel mod) into user form
+        // es: "fred!buffN" -> "/dev/fred/buffN"
+        snprintf(dev_name, MAX_PATH, "/dev/%s", self->data_buffs_ifs[task_idx][i]->dev_name);
+        dev_name[strcspn(dev_name, "!")] = '/';
+
+        fds[i] = open(dev_name, O_RDWR | O_CLOEXEC);
+        if (fds[i] < 0) {
+            ERROR_PRINT("fred_sys: unable to open data buffer %s. Error: %s\n",
+                        dev_name, strerror(errno));
+            retval = 1;
+            goto out_close;
+        }
+        fds_count++;
+
+        length = fred_buff_if_get_lenght(self->data_buffs_ifs[task_idx][i]);
+        memcpy(data + sizeof(msg) + sizeof(length) * i, &length, sizeof(length));
+    }
+
+    // Queued fds are duplicated
+    retval = send_to_client_(self, &iov, 1, fds, data_buffs_count);
+
+out_close:
+    for (int i = 0; i < fds_count; ++i)
+        close(fds[i]);
+
+    return retval;
+}
+
+static
+int send_user_data_buffs_(struct sw_task_client *self, int task_idx)
+{
     int data_buffs_count;
     const unsigned int *data_buffs_sizes;
     char usr_dev_name[MAX_PATH];
@@ -120,58 +780,54 @@ int send_user_data_buffs_(struct sw_task_client *self, int task_idx)
                 sizeof(user_buffs[i].dev_name) -1);
     }
 
-    // Send to the client the number of data buffers
-    retval = send_fred_message_(self->conn_sock, FRED_MSG_BUFFS, data_buffs_count);
-    if (retval)
-        return 1;
-
-    // Send to the client the buffers representations
-    retval = write_to_client_(self->conn_sock, user_buffs,
-                                sizeof(user_buffs[0]) * data_buffs_count);
-    if (retval)
-        return 1;
-
-    return 0;
+    // Send to the client the number of data buffers and their representations
+    return send_fred_message_payload_(self, FRED_MSG_BUFFS, data_buffs_count, 0,
+                                        user_buffs, sizeof(user_buffs[0]) * data_buffs_count);
 }
 
 // Return values:
 //  1) communication or allocation error (single sw-task issue)
 // -1) system error
 static inline
-int process_msg_(struct sw_task_client *self, const struct fred_msg *msg)
+int process_msg_(struct sw_task_client *self, const struct fred_msg *msg, const void *payload)
 {
     uint32_t arg;
-    int idx;
+    uint32_t req_id;
     int retval;
     struct hw_task *hw_task = NULL;
-    int data_buffs_count;
+    struct accel_req *request;
 
     switch (fred_msg_get_head(msg)) {
     case FRED_MSG_INIT:
         if (self->state != CLIENT_EMPTY) {
-            retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+            retval = send_fred_message_(self, FRED_MSG_ERROR, 0, 0);
         } else {
             self->state = CLIENT_READY;
-            retval = send_fred_message_(self->conn_sock, FRED_MSG_ACK, 0);
+            self->buff_fds = !!(fred_msg_get_arg(msg) & FRED_INIT_BUFF_FDS);
+            arg = self->buff_fds ? FRED_INIT_BUFF_FDS : 0;
+            if (fred_msg_get_arg(msg) & FRED_INIT_RING)
+                retval = init_ring_(self, arg);
+            else
+                retval = send_fred_message_(self, FRED_MSG_ACK, arg, 0);
         }
         break;
 
     case FRED_MSG_BIND:
         if (self->state != CLIENT_READY) {
-            retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+            retval = send_fred_message_(self, FRED_MSG_ERROR, 0, 0);
         } else {
             // Get hw-task id from request
             arg = fred_msg_get_arg(msg);
             hw_task = sys_layout_get_hw_task(self->sys, arg);
             if (!hw_task) {
                 ERROR_PRINT("fred_sys: unable to find hw-task id: %u\n", arg);
-                retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+                retval = send_fred_message_(self, FRED_MSG_ERROR, 0, 0);
                 break;
 
             } else {
                 // If the hw-task has been already disable due to an overrun
                 if (hw_task_get_banned(hw_task)) {
-                    retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+                    retval = send_fred_message_(self, FRED_MSG_ERROR, 0, 0);
                     break;
                 }
 
@@ -179,7 +835,7 @@ int process_msg_(struct sw_task_client *self, const struct fred_msg *msg)
                 if (self->hw_tasks_count >= MAX_HW_TASKS - 1) {
                     ERROR_PRINT("fred_sys: critical: maximum number of hw-tasks"
                                 " exceeded: detaching client\n");
-                    retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+                    retval = send_fred_message_(self, FRED_MSG_ERROR, 0, 0);
                     break;
                 }
 
@@ -196,7 +852,10 @@ int process_msg_(struct sw_task_client *self, const struct fred_msg *msg)
                 }
 
                 // Send buffer to the client
-                retval = send_user_data_buffs_(self, self->hw_tasks_count);
+                if (self->buff_fds)
+                    retval = send_data_buffs_fds_(self, self->hw_tasks_count);
+                else
+                    retval = send_user_data_buffs_(self, self->hw_tasks_count);
                 if (retval) {
                     ERROR_PRINT("fred_sys: critical: communication error while"
                                 "binding data buffers: detaching client\n");
@@ -210,49 +869,43 @@ int process_msg_(struct sw_task_client *self, const struct fred_msg *msg)
         break;
 
     case FRED_MSG_RUN:
-        if (self->state != CLIENT_READY) {
-            retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+        req_id = fred_msg_get_req_id(msg);
+        // Clients using the rings must submit through the rings
+        if (self->state != CLIENT_READY || self->ring) {
+            retval = send_fred_message_(self, FRED_MSG_ERROR, 0, req_id);
         } else {
-            // Get hw-task id from request
-            arg = fred_msg_get_arg(msg);
-            idx = -1;
-            // Find requested hw-task
-            for (int i = 0; i < self->hw_tasks_count; ++i) {
-                if (hw_task_get_id(self->hw_tasks[i]) == arg) {
-                    idx = i;
-                    break;
-                }
-            }
-
-            // If the requested hw-task is not associated with this sw-task
-            if (idx < 0) {
-                retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
-                break;
-            }
-
-            // If the hw-task exist but it has been already disable due to an overrun
-            if (hw_task_get_banned(self->hw_tasks[idx])) {
-                retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+            // Get hw-task id from request and build the acceleration request
+            retval = build_run_req_(self, fred_msg_get_arg(msg), req_id,
+                                    fred_msg_get_deadline_us(msg), &request);
+            if (retval) {
+                retval = send_fred_message_(self, FRED_MSG_ERROR, 0, req_id);
                 break;
             }
 
-            // The hw-task exist: build and fire acceleration request
-            accel_req_unbind(&self->accel_req);
-            accel_req_set_hw_task(&self->accel_req, self->hw_tasks[idx]);
-            // Set hardware arguments (memory buffer pointers)
-            data_buffs_count = hw_task_get_data_buffs_count(self->hw_tasks[idx]);
-            accel_req_set_args_size(&self->accel_req, data_buffs_count);
-            for (int j = 0; j < data_buffs_count; ++j) {
-                accel_req_set_args(&self->accel_req, j,
-                    fred_buff_if_get_phy_addr(self->data_buffs_ifs[idx][j]));
-            }
             // Pass acceleration request to the scheduler
-            retval = scheduler_push_accel_req(self->scheduler, &self->accel_req);
+            retval = scheduler_push_accel_req(self->scheduler, request);
         }
         break;
 
+    case FRED_MSG_RUN_BATCH:
+        retval = run_batch_(self, msg, payload);
+        break;
+
+    case FRED_MSG_RUN_ARGS:
+        retval = run_args_(self, msg, payload);
+        break;
+
+    case FRED_MSG_RUN_CHAIN:
+        retval = run_chain_(self, msg, payload);
+        break;
+
+    // No reply, the cancelled requests are answered as usual
+    case FRED_MSG_CANCEL:
+        retval = cancel_reqs_(self, fred_msg_get_req_id(msg), 0);
+        break;
+
     default:
-        retval = send_fred_message_(self->conn_sock, FRED_MSG_ERROR, 0);
+        retval = send_fred_message_(self, FRED_MSG_ERROR, 0, 0);
         break;
     }
 
@@ -274,28 +927,148 @@ int process_msg_(struct sw_task_client *self, const struct fred_msg *msg)
 //---------------------------------------------------------------------------------------------
 
 static
-int sw_task_client_notify_action_(void *notifier, enum notify_action_msg msg)
+int sw_task_client_notify_action_(void *notifier, struct accel_req *request,
+                                    enum notify_action_msg msg)
 {
     struct sw_task_client *self;
+    struct client_batch *batch;
+    uint32_t req_id;
+    int head;
     int retval;
+    int idx;
 
     assert(notifier);
+    assert(request);
 
     self = (struct sw_task_client *)notifier;
 
+    idx = request - self->accel_reqs;
+    batch = self->req_batches[idx];
+    self->req_batches[idx] = NULL;
+
+    // The request goes back to the pool (and the whole client may be released
+    // below): callers must not touch the request after notifying it
+    req_id = accel_req_get_req_id(request);
+    put_free_req_(self, request);
+
+    // Serve the submissions left on the ring on the next event
+    if (self->ring_starved && !self->detached) {
+        self->ring_starved = 0;
+
+        if (sw_task_ring_kick(self->ring))
+            hang_up_ring_(self);
+    }
+
     switch (msg) {
         case NOTIFY_ACTION_DONE:
             // Notify the client that his acceleration request has been completed
-            retval = send_fred_message_(self->conn_sock, FRED_MSG_DONE, 0);
+            head = FRED_MSG_DONE;
+            break;
+        case NOTIFY_ACTION_EXPIRED:
+            // Notify the client that the request missed its deadline before starting
+            head = FRED_MSG_EXPIRED;
+            break;
+        case NOTIFY_ACTION_ABORTED:
+            // Only chain stages are aborted
+            head = FRED_MSG_ERROR;
+            break;
+        case NOTIFY_ACTION_CANCELLED:
+            // Dropped on the client request (or on detach) before starting
+            head = FRED_MSG_CANCELLED;
             break;
         case NOTIFY_ACTION_OVERRUN:
         default:
             // Notify the client that the hw-task overrun and will be disabled
-            retval = send_fred_message_(self->conn_sock, FRED_MSG_OVERRUN, 0);
+            head = FRED_MSG_OVERRUN;
             break;
     }
 
-    return retval;
+    // Jobs of a batch (and stages of a chain) are answered together
+    if (batch && batch->is_chain) {
+        retval = finish_chain_stage_(self, batch, self->req_jobs[idx], msg, head);
+
+    } else if (batch) {
+        retval = finish_batch_job_(self, batch, self->req_jobs[idx], head);
+
+    // Completions are posted on the ring without touching the socket
+    } else if (self->ring && !self->detached) {
+        retval = sw_task_ring_post_cqe(self->ring, head, req_id);
+        if (retval)
+            hang_up_ring_(self);
+
+        return 0;
+
+    } else {
+        retval = send_fred_message_(self, head, 0, req_id);
+    }
+
+    if (self->zombie && !self->pending_reqs) {
+        release_(self);
+        return 0;
+    }
+
+    // A client unable to take its notification has been hung
+    // up, that is not an error for the scheduler
+    return retval < 0 ? retval : 0;
+}
+
+int sw_task_client_drain_ring(struct sw_task_client *self)
+{
+    int retval;
+    int cq_space;
+    struct fred_ring_sqe sqe;
+    struct accel_req *request;
+
+    assert(self);
+    assert(self->ring);
+
+    for (;;) {
+        cq_space = sw_task_ring_cq_space(self->ring);
+        if (cq_space < 0) {
+            hang_up_ring_(self);
+            return 0;
+        }
+
+        // Each accepted submission will post exactly one completion.
+        // Stop consuming when the completion ring could overflow
+        if (self->pending_reqs >= cq_space)
+            break;
+
+        // The remaining submissions are left on the ring as backpressure,
+        // they are served again when a request goes back to the pool
+        if (TAILQ_EMPTY(&self->free_reqs)) {
+            self->ring_starved = !sw_task_ring_sq_empty(self->ring);
+            break;
+        }
+
+        retval = sw_task_ring_pop_sqe(self->ring, &sqe);
+        if (retval < 0) {
+            hang_up_ring_(self);
+            return 0;
+        }
+
+        if (!retval)
+            break;
+
+        retval = build_run_req_(self, sqe.hw_task_id, sqe.req_id, sqe.deadline_us, &request);
+        if (retval) {
+            retval = sw_task_ring_post_cqe(self->ring, FRED_MSG_ERROR, sqe.req_id);
+            if (retval) {
+                hang_up_ring_(self);
+                return 0;
+            }
+            continue;
+        }
+
+        // Pass acceleration request to the scheduler
+        retval = scheduler_push_accel_req(self->scheduler, request);
+        if (retval) {
+            ERROR_PRINT("fred_sys: critical error while processing ring submission\n");
+            return -1;
+        }
+    }
+
+    return 0;
 }
 
 // ---------------------- Functions to implement event_handler interface ----------------------
@@ -323,19 +1096,96 @@ void get_name_(const struct event_handler *self, char *msg, int msg_size)
     snprintf(msg, msg_size, "sw-task client on fd: %d", cp->conn_sock);
 }
 
+// Process all the complete requests received, the remainder is kept at the head
+// of the receive buffer (as the requests received while the client is throttled)
 static
-int handle_event_(struct event_handler *self)
+int process_rx_buff_(struct sw_task_client *self)
 {
-    struct sw_task_client *cp;
-
+    int retval = 0;
+    size_t offset = 0;
+    size_t req_len;
     struct fred_msg msg;
-    ssize_t nread;
 
-    assert(self);
+    while (!self->throttled) {
+        // Unable to take the replies
+        if (self->hung_up)
+            return 1;
 
-    cp = (struct sw_task_client *)self;
-    nread = read(cp->conn_sock, &msg, sizeof(msg));
-    if (nread < 0) {
+        retval = fred_msg_get_req_len(self->rx_buff + offset, self->rx_len - offset, &req_len);
+        if (retval <= 0)
+            break;
+
+        memcpy(&msg, self->rx_buff + offset, sizeof(msg));
+
+        retval = process_msg_(self, &msg, self->rx_buff + offset + sizeof(msg));
+        if (retval)
+            return retval;
+
+        offset += req_len;
+        self->rx_reqs++;
+    }
+
+    // The stream cannot be resynchronized
+    if (retval < 0) {
+        ERROR_PRINT("fred_sys: malformed request from client: detaching client\n");
+        return 1;
+    }
+
+    self->rx_len -= offset;
+    memmove(self->rx_buff, self->rx_buff + offset, self->rx_len);
+
+    return 0;
+}
+
+static
+int flush_replies_(struct sw_task_client *cp)
+{
+    int retval;
+
+    if (cp->hung_up)
+        return 1;
+
+    retval = out_queue_flush(&cp->out_queue, cp->conn_sock);
+    if (retval) {
+        DBG_PRINT("fred_sys: unable to reach client: detaching client\n");
+        return 1;
+    }
+
+    // Drained enough, the requests already received go first
+    if (cp->throttled && out_queue_get_len(&cp->out_queue) <= cp->out_high_water / 2) {
+        DBG_PRINT("fred_sys: client on fd: %d unthrottled\n", cp->conn_sock);
+        cp->throttled = 0;
+
+        retval = process_rx_buff_(cp);
+        if (retval)
+            return retval;
+    }
+
+    return update_interest_(cp);
+}
+
+// Read what the socket holds, as much as the receive buffer takes, and process
+// the complete requests. Drained is set when there is nothing left to read
+static
+int recv_requests_(struct sw_task_client *cp, int *drained)
+{
+    ssize_t nread;
+    struct msghdr msg;
+    struct iovec iov;
+
+    iov.iov_base = cp->rx_buff + cp->rx_len;
+    iov.iov_len = sizeof(cp->rx_buff) - cp->rx_len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    nread = recvmsg(cp->conn_sock, &msg, 0);
+    if (nread < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // Spurious wakeup, or drained
+        *drained = 1;
+        return 0;
+
+    } else if (nread < 0) {
         ERROR_PRINT("fred_sys: error reading client message from socket: %s\n",
                     strerror(errno));
         return -1;
@@ -344,9 +1194,86 @@ int handle_event_(struct event_handler *self)
         // Client has closed the connection
         DBG_PRINT("fred_sys: client disconnected\n");
         return 1;
+
+    // A message packet larger than the free space is truncated
+    } else if (msg.msg_flags & MSG_TRUNC) {
+        ERROR_PRINT("fred_sys: oversized packet from client: detaching client\n");
+        return 1;
     }
 
-    return process_msg_(cp, &msg);
+    cp->rx_len += nread;
+    *drained = 0;
+
+    return process_rx_buff_(cp);
+}
+
+static
+int read_requests_(struct sw_task_client *cp)
+{
+    int retval;
+    int drained;
+
+    if (cp->hung_up)
+        return 1;
+
+    // Requests are not read while throttled, the event is
+    // stale or a hang up (that the flush will report)
+    if (cp->throttled)
+        return flush_replies_(cp);
+
+    // Level-triggered, the reactor calls again while there is something to read
+    if (!cp->drain_budget)
+        return recv_requests_(cp, &drained);
+
+    // Edge-triggered, read until the socket is drained or the budget is spent.
+    // Throttling stops the reading, the input interest set again on release
+    // re-arms the edge
+    cp->rx_reqs = 0;
+    do {
+        retval = recv_requests_(cp, &drained);
+        if (retval)
+            return retval;
+    } while (!drained && !cp->throttled && cp->rx_reqs < cp->drain_budget);
+
+    if (drained || cp->throttled)
+        return 0;
+
+    // Still something to read, let the other clients go first
+    retval = reactor_set_interest(cp->reactor, &cp->handler, cp->interest);
+    if (retval)
+        return 1;
+
+    return 0;
+}
+
+static
+int handle_output_(struct event_handler *self)
+{
+    struct sw_task_client *cp;
+    int retval;
+
+    assert(self);
+
+    cp = (struct sw_task_client *)self;
+
+    retval = flush_replies_(cp);
+
+    return retval > 0 ? detach_(cp) : retval;
+}
+
+static
+int handle_event_(struct event_handler *self)
+{
+    struct sw_task_client *cp;
+    int retval;
+
+    assert(self);
+
+    cp = (struct sw_task_client *)self;
+
+    retval = read_requests_(cp);
+
+    return retval > 0 ? detach_(cp) : retval;
 }
 
 static
@@ -358,17 +1285,34 @@ void free_(struct event_handler *self)
 
     cp = (struct sw_task_client *)self;
 
-    free_all_data_buff_(cp);
+    out_queue_free(&cp->out_queue);
+
+    // Deregister and release the rings
+    if (cp->ring) {
+        reactor_remove_event_handler(cp->reactor, sw_task_ring_get_event_handler(cp->ring));
+        event_handler_free(sw_task_ring_get_event_handler(cp->ring));
+        cp->ring = NULL;
+    }
 
     close(cp->conn_sock);
-    free(cp);
+
+    // Requests cancelled on detach but already running still write into the data
+    // buffers, the client is released when the scheduler gives back the last one
+    if (cp->detached && cp->pending_reqs) {
+        DBG_PRINT("fred_sys: client detached with %d requests running\n", cp->pending_reqs);
+        cp->zombie = 1;
+        return;
+    }
+
+    release_(cp);
 }
 
 //---------------------------------------------------------------------------------------------
 
 
 int sw_task_client_init(struct event_handler **self, int list_sock, struct sys_layout *sys,
-                        struct scheduler *scheduler, buffctl_ft *buffctl)
+                        struct scheduler *scheduler, buffctl_ft *buffctl,
+                        struct reactor *reactor, const struct sw_client_params *params)
 {
     struct sw_task_client *client;
     int retval;
@@ -378,6 +1322,8 @@ int sw_task_client_init(struct event_handler **self, int list_sock, struct sys_l
     assert(sys);
     assert(scheduler);
     assert(buffctl);
+    assert(reactor);
+    assert(params);
 
     *self = NULL;
 
@@ -400,6 +1346,15 @@ int sw_task_client_init(struct event_handler **self, int list_sock, struct sys_l
 
     retval = fd_utils_set_fd_nonblock(client->conn_sock);
     if (retval) {
+        close(client->conn_sock);
+        free(client);
+        return -1;
+    }
+
+    retval = out_queue_init(&client->out_queue, CLIENT_OUT_BUFF_SIZE, CLIENT_OUT_RECS,
+                            params->seqpacket);
+    if (retval) {
+        close(client->conn_sock);
         free(client);
         return -1;
     }
@@ -408,16 +1363,25 @@ int sw_task_client_init(struct event_handler **self, int list_sock, struct sys_l
     client->sys = sys;
     client->scheduler = scheduler;
     client->buffctl = buffctl;
+    client->reactor = reactor;
     client->state = CLIENT_EMPTY;
+    client->out_high_water = params->out_high_water;
+    client->drain_budget = params->drain_budget;
+    client->interest = REACT_INTEREST_IN;
 
     // Event handler interface
     client->handler.handle_event = handle_event_;
+    client->handler.handle_output = handle_output_;
     client->handler.get_fd_handle = get_fd_handle_;
     client->handler.get_name = get_name_;
     client->handler.free = free_;
 
-    // Link notify action
-    accel_req_set_notifier(&client->accel_req, sw_task_client_notify_action_, client);
+    // Link notify action and fill the requests pool
+    TAILQ_INIT(&client->free_reqs);
+    for (int i = 0; i < MAX_CLIENT_REQS; ++i) {
+        accel_req_set_notifier(&client->accel_reqs[i], sw_task_client_notify_action_, client);
+        TAILQ_INSERT_TAIL(&client->free_reqs, &client->accel_reqs[i], queue_elem);
+    }
 
     *self = &client->handler;
 
@@ -19,9 +19,32 @@
 #include "hw_task.h"
 #include "../srv_support/buffctl.h"
 #include "scheduler.h"
+#include "reactor.h"
+#include "sw_task_ring.h"
+#include "out_queue.h"
+#include "../shared_user/fred_msg.h"
 
 //---------------------------------------------------------------------------------------------
 
+// Jobs of a FRED_MSG_RUN_BATCH (or stages of a FRED_MSG_RUN_CHAIN), answered together
+struct client_batch {
+    int in_use;
+    int is_chain;
+    uint32_t batch_id;
+    int jobs_count;
+    int threshold;
+    int finished;
+    uint32_t heads[FRED_BATCH_MAX_JOBS];
+    struct accel_req *reqs[FRED_CHAIN_MAX_STAGES];  // Chains only
+};
+
+// Connection options, set by the listener
+struct sw_client_params {
+    int seqpacket;                  // Sequenced packets socket
+    size_t out_high_water;          // Output queue length throttling the requests
+    int drain_budget;               // Requests read for each event (0 level-triggered)
+};
+
 struct sw_task_client {
     // ------------------------//
     struct event_handler handler;               // Handler interface
@@ -45,15 +68,56 @@ struct sw_task_client {
     struct sys_layout *sys;                     // System layout
 
     buffctl_ft *buffctl;                        // To allocate buffers (not owning)
+    struct reactor *reactor;                    // To register the ring doorbell
+
+    struct sw_task_ring *ring;                  // Shared memory rings (optional)
+    int ring_starved;                           // Submissions left for lack of requests
+    int buff_fds;                               // Data buffers passed as fds
+
+    // Requests are processed once complete, a partial one waits here
+    char rx_buff[FRED_MSG_MAX_REQ_LEN * 2];
+    size_t rx_len;
 
-    struct accel_req accel_req;                 // Max *one* request at time no
-                                                // need to allocate dynamically
+    // Edge-triggered, the socket is drained up to a budget of requests for each
+    // event, then the client is requeued behind the others (0 one read per event)
+    int drain_budget;
+    int rx_reqs;                                // Requests processed in this event
+
+    // Replies the socket cannot take yet. Above the high-water mark the
+    // requests are no longer read, until the queue drains to half of it
+    struct out_queue out_queue;
+    size_t out_high_water;
+    int throttled;
+    int hung_up;                                // Detached on the next event
+    int interest;                               // Readiness asked to the reactor
+
+    // Once detached nothing is sent, the requests not started yet are cancelled.
+    // If some are still running the client is kept (zombie) until they complete
+    int detached;
+    int zombie;
+
+    // Acceleration requests pool (statically allocated)
+    // Free requests are linked using their queue element
+    struct accel_req accel_reqs[MAX_CLIENT_REQS];
+    struct accel_req_queue free_reqs;
+    int pending_reqs;
+    int req_pending[MAX_CLIENT_REQS];           // Taken from the pool
+
+    // Batches in flight, each request of the pool knows
+    // its batch (NULL if submitted alone) and its job index
+    struct client_batch batches[MAX_CLIENT_REQS];
+    struct client_batch *req_batches[MAX_CLIENT_REQS];
+    int req_jobs[MAX_CLIENT_REQS];
 };
 
 //---------------------------------------------------------------------------------------------
 
 int sw_task_client_init(struct event_handler **self, int list_sock, struct sys_layout *sys,
-                        struct scheduler *scheduler, buffctl_ft *buffctl);
+                        struct scheduler *scheduler, buffctl_ft *buffctl,
+                        struct reactor *reactor, const struct sw_client_params *params);
+
+// Consume the submissions posted on the shared memory ring
+int sw_task_client_drain_ring(struct sw_task_client *self);
 
 //---------------------------------------------------------------------------------------------
 
@@ -0,0 +1,222 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+// for memfd_create
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include "sw_task_ring.h"
+#include "sw_task_client.h"
+#include "../utils/dbg_print.h"
+
+//---------------------------------------------------------------------------------------------
+
+int sw_task_ring_post_cqe(struct sw_task_ring *self, int head, uint32_t req_id)
+{
+    int retval;
+    int space;
+    uint32_t tail;
+    uint64_t wakeup = 1;
+
+    assert(self);
+
+    space = sw_task_ring_cq_space(self);
+    if (space < 0) {
+        ERROR_PRINT("fred_sys: sw-task ring: invalid completion ring head\n");
+        return 1;
+    }
+
+    // Must be guaranteed by the submission side
+    if (space == 0) {
+        ERROR_PRINT("fred_sys: sw-task ring: completion ring overflow\n");
+        return 1;
+    }
+
+    tail = self->cq_tail;
+    self->ring->cqes[tail & FRED_RING_CQ_MASK].head = head;
+    self->ring->cqes[tail & FRED_RING_CQ_MASK].req_id = req_id;
+    self->cq_tail = tail + 1;
+
+    // Publish the entry and then check if the client is waiting.
+    // Pairs with the client setting the flag and then checking the tail
+    __atomic_store_n(&self->ring->cq_tail, self->cq_tail, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&self->ring->flags, __ATOMIC_SEQ_CST) & FRED_RING_CQ_NEED_WAKEUP) {
+        retval = write(self->cq_efd, &wakeup, sizeof(wakeup));
+        if (retval != sizeof(wakeup)) {
+            ERROR_PRINT("fred_sys: sw-task ring: unable to wake up client."
+                        " Error: %s\n", strerror(errno));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int sw_task_ring_kick(struct sw_task_ring *self)
+{
+    int retval;
+    uint64_t kick = 1;
+
+    assert(self);
+
+    retval = write(self->sq_efd, &kick, sizeof(kick));
+    if (retval != sizeof(kick)) {
+        ERROR_PRINT("fred_sys: sw-task ring: unable to kick doorbell."
+                    " Error: %s\n", strerror(errno));
+        return 1;
+    }
+
+    return 0;
+}
+
+// ---------------------- Functions to implement event_handler interface ----------------------
+
+static
+int get_fd_handle_(const struct event_handler *self)
+{
+    struct sw_task_ring *ring;
+
+    assert(self);
+
+    ring = (struct sw_task_ring *)self;
+    return ring->sq_efd;
+}
+
+static
+int handle_event_(struct event_handler *self)
+{
+    struct sw_task_ring *ring;
+    uint64_t kicks;
+    ssize_t nread;
+
+    assert(self);
+
+    ring = (struct sw_task_ring *)self;
+
+    // Consume all doorbell kicks at once
+    nread = read(ring->sq_efd, &kicks, sizeof(kicks));
+    if (nread < 0 && errno != EAGAIN) {
+        ERROR_PRINT("fred_sys: sw-task ring: error reading doorbell: %s\n",
+                    strerror(errno));
+        return -1;
+    }
+
+    // Drain all pending submissions
+    return sw_task_client_drain_ring(ring->client);
+}
+
+static
+void get_name_(const struct event_handler *self, char *msg, int msg_size)
+{
+    struct sw_task_ring *ring;
+
+    assert(self);
+    assert(msg);
+
+    ring = (struct sw_task_ring *)self;
+    snprintf(msg, msg_size, "sw-task ring doorbell on fd: %d", ring->sq_efd);
+}
+
+static
+void free_(struct event_handler *self)
+{
+    struct sw_task_ring *ring;
+
+    if (!self)
+        return;
+
+    ring = (struct sw_task_ring *)self;
+
+    if (ring->ring)
+        munmap(ring->ring, sizeof(*ring->ring));
+
+    close(ring->mem_fd);
+    close(ring->sq_efd);
+    close(ring->cq_efd);
+
+    free(ring);
+}
+
+//---------------------------------------------------------------------------------------------
+
+int sw_task_ring_init(struct sw_task_ring **self, struct sw_task_client *client)
+{
+    struct sw_task_ring *ring;
+    int retval;
+
+    assert(client);
+
+    *self = NULL;
+
+    // Allocate and set everything to 0
+    ring = calloc(1, sizeof(*ring));
+    if (!ring)
+        return -1;
+
+    event_handler_assign_id(&ring->handler);
+
+    ring->client = client;
+    ring->sq_efd = -1;
+    ring->cq_efd = -1;
+
+    // Anonymous shared memory for the rings
+    ring->mem_fd = memfd_create("fred_ring", MFD_CLOEXEC);
+    if (ring->mem_fd < 0) {
+        ERROR_PRINT("fred_sys: sw-task ring: memfd_create error: %s\n", strerror(errno));
+        goto error_clean;
+    }
+
+    retval = ftruncate(ring->mem_fd, sizeof(*ring->ring));
+    if (retval) {
+        ERROR_PRINT("fred_sys: sw-task ring: ftruncate error: %s\n", strerror(errno));
+        goto error_clean;
+    }
+
+    ring->ring = mmap(NULL, sizeof(*ring->ring), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, ring->mem_fd, 0);
+    if (ring->ring == MAP_FAILED) {
+        ERROR_PRINT("fred_sys: sw-task ring: mmap error: %s\n", strerror(errno));
+        ring->ring = NULL;
+        goto error_clean;
+    }
+
+    // Doorbells
+    ring->sq_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ring->cq_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ring->sq_efd < 0 || ring->cq_efd < 0) {
+        ERROR_PRINT("fred_sys: sw-task ring: eventfd error: %s\n", strerror(errno));
+        goto error_clean;
+    }
+
+    // Event handler interface
+    ring->handler.handle_event = handle_event_;
+    ring->handler.get_fd_handle = get_fd_handle_;
+    ring->handler.get_name = get_name_;
+    ring->handler.free = free_;
+
+    *self = ring;
+
+    return 0;
+
+error_clean:
+    free_(&ring->handler);
+    return -1;
+}
@@ -0,0 +1,134 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef SW_TASK_RING_H_
+#define SW_TASK_RING_H_
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "event_handler.h"
+#include "../shared_user/fred_ring.h"
+
+//---------------------------------------------------------------------------------------------
+
+struct sw_task_client;
+
+//---------------------------------------------------------------------------------------------
+
+// Server side of the shared memory rings of a sw-task client.
+// The event handler serves the submission doorbell.
+struct sw_task_ring {
+    // ------------------------//
+    struct event_handler handler;   // Handler interface
+    // ------------------------//
+
+    int sq_efd;                     // Handle (submission doorbell)
+    int cq_efd;                     // Completion doorbell
+    int mem_fd;                     // Shared memory holding the rings
+
+    struct fred_ring *ring;
+
+    // Private copies of the indexes produced by the server,
+    // the shared ones may be overwritten by the client
+    uint32_t sq_head;
+    uint32_t cq_tail;
+
+    struct sw_task_client *client;  // Owner (not owning)
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+struct event_handler *sw_task_ring_get_event_handler(struct sw_task_ring *self)
+{
+    assert(self);
+
+    return &self->handler;
+}
+
+// Fds to be sent to the client: shared memory, submission and completion doorbells
+static inline
+void sw_task_ring_get_fds(const struct sw_task_ring *self, int fds[3])
+{
+    assert(self);
+
+    fds[0] = self->mem_fd;
+    fds[1] = self->sq_efd;
+    fds[2] = self->cq_efd;
+}
+
+// Returns 1 if a submission has been consumed, 0 if the ring is empty,
+// -1 if the client has set a tail beyond the ring size
+static inline
+int sw_task_ring_pop_sqe(struct sw_task_ring *self, struct fred_ring_sqe *sqe)
+{
+    uint32_t head;
+    uint32_t tail;
+
+    assert(self);
+    assert(sqe);
+
+    head = self->sq_head;
+    tail = __atomic_load_n(&self->ring->sq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+        return 0;
+
+    if (tail - head > FRED_RING_SQ_ENTRIES)
+        return -1;
+
+    *sqe = self->ring->sqes[head & FRED_RING_SQ_MASK];
+    self->sq_head = head + 1;
+    __atomic_store_n(&self->ring->sq_head, self->sq_head, __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+static inline
+int sw_task_ring_sq_empty(const struct sw_task_ring *self)
+{
+    assert(self);
+
+    return self->sq_head == __atomic_load_n(&self->ring->sq_tail, __ATOMIC_ACQUIRE);
+}
+
+// Free entries in the completion ring,
+// -1 if the client has set a head beyond the ring size
+static inline
+int sw_task_ring_cq_space(const struct sw_task_ring *self)
+{
+    uint32_t head;
+    uint32_t used;
+
+    assert(self);
+
+    head = __atomic_load_n(&self->ring->cq_head, __ATOMIC_ACQUIRE);
+    used = self->cq_tail - head;
+
+    if (used > FRED_RING_CQ_ENTRIES)
+        return -1;
+
+    return FRED_RING_CQ_ENTRIES - used;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int sw_task_ring_init(struct sw_task_ring **self, struct sw_task_client *client);
+
+int sw_task_ring_post_cqe(struct sw_task_ring *self, int head, uint32_t req_id);
+
+// Serve the submissions again on the next event, as if the client rang the doorbell
+int sw_task_ring_kick(struct sw_task_ring *self);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* SW_TASK_RING_H_ */
@@ -50,10 +50,15 @@ int handle_event_(struct event_handler *self)
 
     // New connection request from a SW task
     // Create a sw_task_client object
-    sw_task_client_init(&cp, lp->list_sock, lp->sys, lp->scheduler, lp->buffctl);
+    retval = sw_task_client_init(&cp, lp->list_sock, lp->sys, lp->scheduler, lp->buffctl,
+                                    lp->reactor, &lp->client_params);
+    if (retval)
+        return 0;
 
     // And register to the reactor
-    retval = reactor_add_event_handler(lp->reactor, cp, REACT_NORMAL_HANDLER, REACT_OWNED);
+    retval = reactor_add_event_handler(lp->reactor, cp, lp->client_params.drain_budget ?
+                                        REACT_EDGE_HANDLER : REACT_NORMAL_HANDLER,
+                                        REACT_OWNED);
 
     return retval;
 }
@@ -89,15 +94,17 @@ void free_(struct event_handler *self)
 
 //---------------------------------------------------------------------------------------------
 
-int open_listening_socket_()
+int open_listening_socket_(int seqpacket)
 {
     int retval;
     int listen_sock;
+    int type;
     struct sockaddr_un serv_addr;
     size_t addr_len;
 
-    // Listening socket
-    listen_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    // Listening socket (sequenced packets keep the messages boundaries)
+    type = seqpacket ? SOCK_SEQPACKET : SOCK_STREAM;
+    listen_sock = socket(AF_UNIX, type | SOCK_NONBLOCK, 0);
     if (listen_sock < 0) {
         ERROR_PRINT("fred_sys: error on opening socket");
         return -1;
@@ -133,7 +140,7 @@ int open_listening_socket_()
 
 int sw_tasks_listener_init(struct event_handler **self, struct sys_layout *sys,
                             struct reactor *reactor, struct scheduler *scheduler,
-                            buffctl_ft *buffctl)
+                            buffctl_ft *buffctl, const struct sw_client_params *params)
 {
     struct sw_tasks_listener *listener;
 
@@ -141,6 +148,7 @@ int sw_tasks_listener_init(struct event_handler **self, struct sys_layout *sys,
     assert(reactor);
     assert(scheduler);
     assert(buffctl);
+    assert(params);
 
     *self = NULL;
 
@@ -151,7 +159,7 @@ int sw_tasks_listener_init(struct event_handler **self, struct sys_layout *sys,
     event_handler_assign_id(&listener->handler);
 
     // Open socket
-    listener->list_sock = open_listening_socket_();
+    listener->list_sock = open_listening_socket_(params->seqpacket);
     if (listener->list_sock < 0) {
         ERROR_PRINT("fredsys: software tasks listener: unable to open listening socket\n");
         free(listener);
@@ -163,6 +171,7 @@ int sw_tasks_listener_init(struct event_handler **self, struct sys_layout *sys,
     listener->reactor = reactor;
     listener->scheduler = scheduler;
     listener->buffctl = buffctl;
+    listener->client_params = *params;
 
     // Event handler interface
     listener->handler.handle_event = handle_event_;
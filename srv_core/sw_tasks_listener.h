@@ -19,6 +19,7 @@
 #include "reactor.h"
 #include "../srv_support/buffctl.h"
 #include "scheduler.h"
+#include "sw_task_client.h"
 
 
 //---------------------------------------------------------------------------------------------
@@ -35,13 +36,14 @@ struct sw_tasks_listener {
     struct scheduler *scheduler;    // To be passed to the client
     struct sys_layout *sys;
     buffctl_ft *buffctl;
+    struct sw_client_params client_params;
 };
 
 //---------------------------------------------------------------------------------------------
 
 int sw_tasks_listener_init(struct event_handler **self, struct sys_layout *sys,
                             struct reactor *reactor, struct scheduler *scheduler,
-                            buffctl_ft *buffctl);
+                            buffctl_ft *buffctl, const struct sw_client_params *params);
 
 //---------------------------------------------------------------------------------------------
 
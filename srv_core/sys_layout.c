@@ -41,6 +41,9 @@ static inline uint32_t str_to_uint32_(const char *string)
     return (uint32_t)strtol(string, (char **)NULL, 10);
 }
 
+// Optional hw-task settings, among the buffers sizes
+#define HW_TASK_SPIN_OPT        "spin="
+
 //---------------------------------------------------------------------------------------------
 
 static
@@ -109,7 +112,7 @@ int build_partitions_(struct sys_layout *self, const struct sys_hw_config *hw_co
             }
 
             // Create e new slot timer
-            retval = slot_timer_init(&timer, scheduler);
+            retval = slot_timer_init(&timer, scheduler, self->timer_wheel);
             if (retval) {
                 ERROR_PRINT("fred_sys: error: unable to initialize slot timer %u of "
                             "partition %s\n", s, part_name);
@@ -140,6 +143,8 @@ static int build_hw_tasks_(struct sys_layout *self, const char *hw_tasks_file)
     const char *bits_path = NULL;
     int data_buffs_count;
     unsigned int data_buff_size;
+    const char *opt;
+    uint32_t spin_us;
 
     DBG_PRINT("fred_sys: building hw-tasks\n");
 
@@ -204,7 +209,22 @@ static int build_hw_tasks_(struct sys_layout *self, const char *hw_tasks_file)
         // The reminder tokens (after fourth initial tokens) define the buffers
         data_buffs_count = pars_get_num_tokens(tokens, i) - 5;
         for (int b = 0; b < data_buffs_count; ++b) {
-            data_buff_size = str_to_size_(pars_get_token(tokens, i, b + 5));
+            opt = pars_get_token(tokens, i, b + 5);
+
+            // Completion busy wait budget in microseconds
+            if (!strncmp(opt, HW_TASK_SPIN_OPT, strlen(HW_TASK_SPIN_OPT))) {
+                spin_us = str_to_uint32_(opt + strlen(HW_TASK_SPIN_OPT));
+                if (spin_us > MAX_HW_TASK_SPIN_US) {
+                    ERROR_PRINT("fred_sys: error: spin budget of HW-task %s exceeds %d us\n",
+                                hw_task_name, MAX_HW_TASK_SPIN_US);
+                    pars_free_tokens(tokens);
+                    return -1;
+                }
+                hw_task_set_spin_us(self->hw_tasks[i], spin_us);
+                continue;
+            }
+
+            data_buff_size = str_to_size_(opt);
             retval = hw_task_add_buffer(self->hw_tasks[i], data_buff_size);
             if (retval)
                 return -1;
@@ -252,9 +272,26 @@ int sys_layout_register_slots(struct sys_layout *self, struct reactor *reactor)
             return -1;
     }
 
+    // And the timer wheel serving the slots timers
+    retval = reactor_add_event_handler( reactor,
+                                        timer_wheel_get_event_handler(self->timer_wheel),
+                                        REACT_HW_HANDLER, REACT_NOT_OWNED);
+    if (retval)
+        return -1;
+
     return 0;
 }
 
+void sys_layout_set_slot_evict(struct sys_layout *self, enum slot_evict evict)
+{
+    assert(self);
+
+    for (int i = 0; i < self->partitions_count; ++i)
+        partition_set_slot_evict(self->partitions[i], evict);
+
+    DBG_PRINT("fred_sys: slot eviction policy: %s\n", slot_evict_get_name(evict));
+}
+
 void sys_layout_print(const struct sys_layout *self)
 {
     char name[MAX_NAMES];
@@ -299,6 +336,12 @@ int sys_layout_init(struct sys_layout **self, const struct sys_hw_config *hw_con
 
     (*self)->buffctl = buffctl;
 
+    retval = timer_wheel_init(&(*self)->timer_wheel);
+    if (retval) {
+        ERROR_PRINT("fred_sys: error while initializing timer wheel\n");
+        goto error_clean;
+    }
+
     retval = build_partitions_(*self, hw_config, arch_file, scheduler);
     if (retval) {
         ERROR_PRINT("fred_sys: error while building partitions\n");
@@ -333,5 +376,8 @@ void sys_layout_free(struct sys_layout *self)
             hw_task_free(self->hw_tasks[i], self->buffctl);
     }
 
+    if (self->timer_wheel)
+        event_handler_free(timer_wheel_get_event_handler(self->timer_wheel));
+
     free(self);
 }
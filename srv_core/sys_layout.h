@@ -19,6 +19,7 @@
 #include "../srv_support/buffctl.h"
 #include "../hw_support/sys_hw_config.h"
 #include "scheduler.h"
+#include "timer_wheel.h"
 
 //---------------------------------------------------------------------------------------------
 
@@ -30,6 +31,9 @@ struct sys_layout {
     int hw_tasks_count;
 
     buffctl_ft *buffctl;
+
+    // Watchdog for all slots timers
+    struct timer_wheel *timer_wheel;
 };
 
 //---------------------------------------------------------------------------------------------
@@ -47,6 +51,8 @@ int sys_layout_get_hw_tasks(const struct sys_layout *self, struct hw_task **hw_t
 
 int sys_layout_register_slots(struct sys_layout *self, struct reactor *reactor);
 
+void sys_layout_set_slot_evict(struct sys_layout *self, enum slot_evict evict);
+
 void sys_layout_print(const struct sys_layout *self);
 
 //---------------------------------------------------------------------------------------------
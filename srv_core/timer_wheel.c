@@ -0,0 +1,397 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+#include "timer_wheel.h"
+#include "../utils/dbg_print.h"
+
+//---------------------------------------------------------------------------------------------
+
+#define TICK_NS     ((uint64_t)TIMER_WHEEL_TICK_US * 1000)
+
+//---------------------------------------------------------------------------------------------
+
+// Served by the vDSO, no system call
+static inline
+uint64_t now_ns_(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline
+uint64_t now_tick_(const struct timer_wheel *self)
+{
+    return (now_ns_() - self->origin_ns) / TICK_NS;
+}
+
+static inline
+uint64_t rotate_right_(uint64_t value, unsigned int shift)
+{
+    shift &= 63;
+
+    return shift ? (value >> shift) | (value << (64 - shift)) : value;
+}
+
+static inline
+int level_shift_(int level)
+{
+    return level * TIMER_WHEEL_BITS;
+}
+
+//---------------------------------------------------------------------------------------------
+
+static
+void insert_(struct timer_wheel *self, struct wheel_timer *timer)
+{
+    uint64_t delta;
+    int level;
+    int index;
+
+    // Expired timers (put back on errors) go in the current bucket
+    delta = timer->expires > self->cursor ? timer->expires - self->cursor : 0;
+
+    // Find the level whose span contains the expiration
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; ++level) {
+        if (delta < (1ULL << level_shift_(level + 1)))
+            break;
+    }
+
+    index = (timer->expires >> level_shift_(level)) & TIMER_WHEEL_MASK;
+
+    timer->level = level;
+    timer->index = index;
+
+    LIST_INSERT_HEAD(&self->buckets[level][index], timer, elem);
+    self->occupied[level] |= 1ULL << index;
+}
+
+static
+void remove_(struct timer_wheel *self, struct wheel_timer *timer)
+{
+    LIST_REMOVE(timer, elem);
+
+    if (LIST_EMPTY(&self->buckets[timer->level][timer->index]))
+        self->occupied[timer->level] &= ~(1ULL << timer->index);
+}
+
+// Move all the timers of a bucket to an empty list
+static
+void detach_bucket_(struct timer_wheel *self, int level, int index,
+                    struct wheel_bucket *bucket)
+{
+    bucket->lh_first = self->buckets[level][index].lh_first;
+    if (bucket->lh_first)
+        bucket->lh_first->elem.le_prev = &bucket->lh_first;
+
+    LIST_INIT(&self->buckets[level][index]);
+    self->occupied[level] &= ~(1ULL << index);
+}
+
+// Next tick requiring either a cascade or a bucket to be fired
+static
+uint64_t next_tick_(const struct timer_wheel *self)
+{
+    uint64_t next = UINT64_MAX;
+    uint64_t block;
+    uint64_t rotated;
+    uint64_t tick;
+
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; ++level) {
+        if (!self->occupied[level])
+            continue;
+
+        // Occupied buckets starting from the one after the current block
+        block = self->cursor >> level_shift_(level);
+        rotated = rotate_right_(self->occupied[level], (block + 1) & TIMER_WHEEL_MASK);
+
+        tick = (block + 1 + __builtin_ctzll(rotated)) << level_shift_(level);
+        if (tick < next)
+            next = tick;
+    }
+
+    return next;
+}
+
+static
+int program_(struct timer_wheel *self)
+{
+    int retval;
+    uint64_t next;
+    uint64_t expire_ns;
+    struct itimerspec timer_spec;
+
+    if (!self->pending)
+        return 0;
+
+    next = next_tick_(self);
+
+    // Already programmed early enough
+    if (self->programmed && self->programmed <= next)
+        return 0;
+
+    expire_ns = self->origin_ns + next * TICK_NS;
+
+    timer_spec.it_value.tv_sec = expire_ns / 1000000000;
+    timer_spec.it_value.tv_nsec = expire_ns % 1000000000;
+    timer_spec.it_interval.tv_sec = 0;
+    timer_spec.it_interval.tv_nsec = 0;
+
+    retval = timerfd_settime(self->fd, TFD_TIMER_ABSTIME, &timer_spec, NULL);
+    if (retval) {
+        ERROR_PRINT("fred_sys: unable to arm timerfd. Error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    self->programmed = next;
+
+    return 0;
+}
+
+static
+void cascade_(struct timer_wheel *self, int level, int index)
+{
+    struct wheel_bucket bucket;
+    struct wheel_timer *timer;
+
+    detach_bucket_(self, level, index, &bucket);
+
+    // Redistribute timers on the lower levels
+    while (!LIST_EMPTY(&bucket)) {
+        timer = LIST_FIRST(&bucket);
+        LIST_REMOVE(timer, elem);
+        insert_(self, timer);
+    }
+}
+
+static
+int fire_(struct timer_wheel *self, int index)
+{
+    int retval;
+    struct wheel_bucket bucket;
+    struct wheel_timer *timer;
+
+    // Detach the bucket, callbacks may arm or disarm other timers
+    detach_bucket_(self, 0, index, &bucket);
+
+    while (!LIST_EMPTY(&bucket)) {
+        timer = LIST_FIRST(&bucket);
+        LIST_REMOVE(timer, elem);
+
+        timer->armed = 0;
+        self->pending--;
+
+        retval = timer->expired(timer);
+        if (retval)
+            goto error_restore;
+    }
+
+    return 0;
+
+error_restore:
+    // Keep the remaining timers on the wheel, they can still be disarmed
+    while (!LIST_EMPTY(&bucket)) {
+        timer = LIST_FIRST(&bucket);
+        LIST_REMOVE(timer, elem);
+        insert_(self, timer);
+    }
+
+    return -1;
+}
+
+static
+int advance_(struct timer_wheel *self, uint64_t target)
+{
+    int retval;
+    uint64_t next;
+
+    while (self->pending) {
+        // Skip empty ticks
+        next = next_tick_(self);
+        if (next > target)
+            break;
+
+        self->cursor = next;
+
+        // Cascade upper levels when lower levels wrap around
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; ++level) {
+            if (self->cursor & ((1ULL << level_shift_(level)) - 1))
+                break;
+
+            cascade_(self, level, (self->cursor >> level_shift_(level)) & TIMER_WHEEL_MASK);
+        }
+
+        retval = fire_(self, self->cursor & TIMER_WHEEL_MASK);
+        if (retval)
+            return -1;
+    }
+
+    if (self->cursor < target)
+        self->cursor = target;
+
+    return 0;
+}
+
+// ---------------------- Functions to implement event_handler interface ----------------------
+
+static
+int get_fd_handle_(const struct event_handler *self)
+{
+    assert(self);
+
+    return ((const struct timer_wheel *)self)->fd;
+}
+
+static
+int handle_event_(struct event_handler *self)
+{
+    struct timer_wheel *wheel;
+    uint64_t num_expired;
+    int retval;
+
+    assert(self);
+
+    wheel = (struct timer_wheel *)self;
+
+    // Consume the event from the fd
+    retval = read(wheel->fd, &num_expired, sizeof(num_expired));
+    if (retval < 0 && errno != EAGAIN) {
+        ERROR_PRINT("fred_sys: unable to read timerfd. Error: %s\n", strerror(errno));
+        return -1;
+    }
+
+    wheel->programmed = 0;
+
+    retval = advance_(wheel, now_tick_(wheel));
+    if (retval)
+        return -1;
+
+    return program_(wheel);
+}
+
+static
+void get_name_(const struct event_handler *self, char *msg, int msg_size)
+{
+    assert(self);
+
+    snprintf(msg, msg_size, "timer wheel on fd: %d", ((const struct timer_wheel *)self)->fd);
+}
+
+static
+void free_(struct event_handler *self)
+{
+    struct timer_wheel *wheel;
+
+    if (!self)
+        return;
+
+    wheel = (struct timer_wheel *)self;
+
+    close(wheel->fd);
+    free(wheel);
+}
+
+//---------------------------------------------------------------------------------------------
+
+int timer_wheel_arm(struct timer_wheel *self, struct wheel_timer *timer, uint64_t duration_us)
+{
+    uint64_t now_ns;
+    uint64_t ticks;
+    uint64_t base;
+
+    assert(self);
+    assert(timer);
+    assert(!timer->armed);
+
+    now_ns = now_ns_();
+    timer->start_ns = now_ns;
+
+    // Idle wheel, catch up with the current time
+    if (!self->pending)
+        self->cursor = (now_ns - self->origin_ns) / TICK_NS;
+
+    // Round up, a timer never expires early
+    ticks = (now_ns - self->origin_ns + duration_us * 1000 + TICK_NS - 1) / TICK_NS;
+
+    base = self->cursor + 1;
+    if (ticks < base)
+        ticks = base;
+    if (ticks - self->cursor > TIMER_WHEEL_MAX_TICKS)
+        ticks = self->cursor + TIMER_WHEEL_MAX_TICKS;
+
+    timer->expires = ticks;
+    timer->armed = 1;
+
+    insert_(self, timer);
+    self->pending++;
+
+    // System call only if the wheel was idle or the timer is the earliest
+    if (!self->programmed || timer->expires < self->programmed)
+        return program_(self);
+
+    return 0;
+}
+
+uint64_t timer_wheel_disarm(struct timer_wheel *self, struct wheel_timer *timer)
+{
+    assert(self);
+    assert(timer);
+
+    if (timer->armed) {
+        remove_(self, timer);
+        timer->armed = 0;
+        self->pending--;
+    }
+
+    // The timerfd is not touched, a spurious wake up is cheaper than a system call
+    return (now_ns_() - timer->start_ns) / 1000;
+}
+
+int timer_wheel_init(struct timer_wheel **self)
+{
+    *self = calloc(1, sizeof(**self));
+    if (!(*self))
+        return -1;
+
+    (*self)->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if ((*self)->fd < 0) {
+        ERROR_PRINT("fred_sys: unable to create timerfd. Error: %s\n", strerror(errno));
+        free(*self);
+        return -1;
+    }
+
+    (*self)->origin_ns = now_ns_();
+
+    for (int l = 0; l < TIMER_WHEEL_LEVELS; ++l) {
+        for (int i = 0; i < TIMER_WHEEL_SIZE; ++i)
+            LIST_INIT(&(*self)->buckets[l][i]);
+    }
+
+    // Event handler interface
+    event_handler_assign_id(&(*self)->handler);
+    (*self)->handler.handle_event = handle_event_;
+    (*self)->handler.get_fd_handle = get_fd_handle_;
+    (*self)->handler.get_name = get_name_;
+    (*self)->handler.free = free_;
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef TIMER_WHEEL_H_
+#define TIMER_WHEEL_H_
+
+#include <assert.h>
+#include <stdint.h>
+#include <sys/queue.h>
+
+#include "event_handler.h"
+#include "../parameters.h"
+
+//---------------------------------------------------------------------------------------------
+//
+// Hierarchical timer wheel driven by a single timerfd (one wheel for each event loop).
+// Level L holds the timers expiring within 64^(L+1) ticks, level 0 buckets are fired
+// as the cursor passes over them while higher levels are cascaded down when the lower
+// level wraps around. Arm and disarm are in-memory list operations, the timerfd is
+// only reprogrammed when the wheel goes from idle to busy and on its own wake ups.
+//
+//---------------------------------------------------------------------------------------------
+
+#define TIMER_WHEEL_BITS        6
+#define TIMER_WHEEL_SIZE        (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK        (TIMER_WHEEL_SIZE - 1)
+#define TIMER_WHEEL_LEVELS      4
+
+// Longest timeout (about 4.6 hours with 1 ms ticks), longer ones are clamped
+#define TIMER_WHEEL_MAX_TICKS   ((1ULL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+//---------------------------------------------------------------------------------------------
+
+struct wheel_timer {
+    LIST_ENTRY(wheel_timer) elem;
+
+    uint64_t expires;               // Expiration tick
+    uint64_t start_ns;              // Arm time
+    int armed;
+
+    // Current bucket
+    int level;
+    int index;
+
+    // Called on expiration, non zero stops the event loop
+    int (*expired)(struct wheel_timer *self);
+};
+
+LIST_HEAD(wheel_bucket, wheel_timer);
+
+struct timer_wheel {
+    // ------------------------//
+    struct event_handler handler;   // Handler interface
+    // ------------------------//
+
+    int fd;
+
+    uint64_t origin_ns;             // Tick zero
+    uint64_t cursor;                // Last processed tick
+    uint64_t programmed;            // Tick programmed on the timerfd, 0 if disarmed
+    int pending;
+
+    // One occupancy bit for each bucket
+    uint64_t occupied[TIMER_WHEEL_LEVELS];
+    struct wheel_bucket buckets[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+};
+
+//---------------------------------------------------------------------------------------------
+
+static inline
+struct event_handler *timer_wheel_get_event_handler(struct timer_wheel *self)
+{
+    assert(self);
+
+    return &self->handler;
+}
+
+static inline
+void wheel_timer_init(struct wheel_timer *self, int (*expired)(struct wheel_timer *self))
+{
+    assert(self);
+    assert(expired);
+
+    self->armed = 0;
+    self->expired = expired;
+}
+
+static inline
+int wheel_timer_is_armed(const struct wheel_timer *self)
+{
+    assert(self);
+
+    return self->armed;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int timer_wheel_init(struct timer_wheel **self);
+
+int timer_wheel_arm(struct timer_wheel *self, struct wheel_timer *timer, uint64_t duration_us);
+
+// Returns the time elapsed since the timer has been armed
+uint64_t timer_wheel_disarm(struct timer_wheel *self, struct wheel_timer *timer);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* TIMER_WHEEL_H_ */
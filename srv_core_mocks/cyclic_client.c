@@ -106,7 +106,8 @@ void build_accel_request_(struct cyclic_sw_tasks_client *self, int hw_task_idx)
 //---------------------------------------------------------------------------------------------
 
 static
-int cyclic_client_notify_action_(void *notifier, enum notify_action_msg msg)
+int cyclic_client_notify_action_(void *notifier, struct accel_req *request,
+                                    enum notify_action_msg msg)
 {
     int retval;
     struct cyclic_sw_tasks_client *cp;
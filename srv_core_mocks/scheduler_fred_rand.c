@@ -29,8 +29,8 @@ static inline
 int push_req_fri_queue_(struct scheduler_fred_rand *self, struct accel_req *request);
 
 static inline
-int pull_req_partition_queue_(struct scheduler_fred_rand *self,
-                                struct accel_req *request_done);
+int pull_req_partition_queue_(struct scheduler_fred_rand *self, struct slot *slot,
+                                struct slot_timer *timer, struct partition *partition);
 
 //---------------------------------------------------------------------------------------------
 
@@ -170,23 +170,16 @@ int push_req_fri_queue_(struct scheduler_fred_rand *self, struct accel_req *requ
     return retval;
 }
 
+// The request that freed the slot may have been released on notification
 static inline
-int pull_req_partition_queue_(struct scheduler_fred_rand *self, struct accel_req *request_done)
+int pull_req_partition_queue_(struct scheduler_fred_rand *self, struct slot *slot,
+                                struct slot_timer *timer, struct partition *partition)
 {
     int retval = 0;
 
     struct accel_req *request;
     struct accel_req_queue *part_queue_head;
 
-    struct slot *slot;
-    struct slot_timer *timer;
-    struct partition *partition;
-
-    // Get the slot freed from the request that has been completed
-    slot = accel_req_get_slot(request_done);
-    timer = accel_req_get_timer(request_done);
-    partition = hw_task_get_partition(accel_req_get_hw_task(request_done));
-
     // Check if there are pending requests in the partition queue (queue not empty)
     part_queue_head = &self->part_queues_heads[partition_get_index(partition)];
     if (!TAILQ_EMPTY(part_queue_head)) {
@@ -366,7 +359,7 @@ int sched_fred_rand_slot_complete_(struct scheduler *self, struct accel_req *req
         return -1;
 
     // Pull requests from the partition queue
-    retval = pull_req_partition_queue_(sched, request_done);
+    retval = pull_req_partition_queue_(sched, slot, timer, partition);
 
     return retval;
 }
@@ -378,6 +371,7 @@ int sched_fred_rand_slot_timeout_(struct scheduler *self, struct accel_req *requ
     int retval;
     struct scheduler_fred_rand *sched;
     struct slot *slot;
+    struct slot_timer *timer;
     struct partition *partition;
 
     assert(self);
@@ -386,6 +380,7 @@ int sched_fred_rand_slot_timeout_(struct scheduler *self, struct accel_req *requ
     sched = (struct scheduler_fred_rand *)self;
 
     slot = accel_req_get_slot(request_done);
+    timer = accel_req_get_timer(request_done);
     partition = hw_task_get_partition(accel_req_get_hw_task(request_done));
 
     assert(slot);
@@ -408,11 +403,67 @@ int sched_fred_rand_slot_timeout_(struct scheduler *self, struct accel_req *requ
         return -1;
 
     // Pull requests from the partition queue
-    retval = pull_req_partition_queue_(sched, request_done);
+    retval = pull_req_partition_queue_(sched, slot, timer, partition);
 
     return retval;
 }
 
+static inline
+int queue_contains_(const struct accel_req_queue *queue_head, const struct accel_req *request)
+{
+    struct accel_req *req;
+
+    TAILQ_FOREACH(req, queue_head, queue_elem) {
+        if (req == request)
+            return 1;
+    }
+
+    return 0;
+}
+
+// Only queued requests are dropped, the others are completed
+static
+int sched_fred_rand_cancel_accel_req_(struct scheduler *self, struct accel_req *request)
+{
+    struct scheduler_fred_rand *sched;
+    struct accel_req_queue *part_queue_head;
+    struct slot *slot;
+    struct slot_timer *timer;
+    struct partition *partition;
+
+    assert(self);
+    assert(request);
+
+    sched = (struct scheduler_fred_rand *)self;
+
+    accel_req_set_cancelled(request);
+
+    // Chains are not supported
+    partition = hw_task_get_partition(accel_req_get_hw_task(request));
+    part_queue_head = &sched->part_queues_heads[partition_get_index(partition)];
+
+    if (queue_contains_(part_queue_head, request)) {
+        TAILQ_REMOVE(part_queue_head, request, queue_elem);
+
+        return accel_req_notify_action(request, NOTIFY_ACTION_CANCELLED) ? -1 : 0;
+    }
+
+    if (queue_contains_(&sched->fri_queue_head, request)) {
+        TAILQ_REMOVE(&sched->fri_queue_head, request, queue_elem);
+
+        slot = accel_req_get_slot(request);
+        timer = accel_req_get_timer(request);
+        slot_release_reserved(slot);
+
+        if (accel_req_notify_action(request, NOTIFY_ACTION_CANCELLED))
+            return -1;
+
+        return pull_req_partition_queue_(sched, slot, timer, partition);
+    }
+
+    return 0;
+}
+
 static
 void sched_fred_rand_free_(struct scheduler *self)
 {
@@ -447,6 +498,7 @@ int sched_fred_rand_init(struct scheduler **self, struct devcfg *devcfg)
     sched->scheduler.rcfg_complete = sched_fred_rand_rcfg_complete_;
     sched->scheduler.slot_complete = sched_fred_rand_slot_complete_;
     sched->scheduler.slot_timeout = sched_fred_rand_slot_timeout_;
+    sched->scheduler.cancel_accel_req = sched_fred_rand_cancel_accel_req_;
     sched->scheduler.free = sched_fred_rand_free_;
 
     // Initialize partition queues heads
@@ -11,6 +11,7 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -77,3 +78,39 @@ int fd_utils_set_fd_nonblock(int fd)
 
     return 0;
 }
+
+ssize_t fd_utils_sendv_fds(int sock, const struct iovec *iov, int iovcnt,
+                            const int *fds, int fds_count, int flags)
+{
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    size_t fds_size;
+
+    union {
+        char buf[CMSG_SPACE(sizeof(int) * FD_UTILS_MAX_FDS)];
+        struct cmsghdr align;
+    } ctrl;
+
+    if (fds_count < 0 || fds_count > FD_UTILS_MAX_FDS)
+        return -1;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec *)iov;
+    msg.msg_iovlen = iovcnt;
+
+    if (fds_count) {
+        fds_size = sizeof(int) * fds_count;
+
+        memset(&ctrl, 0, sizeof(ctrl));
+        msg.msg_control = ctrl.buf;
+        msg.msg_controllen = CMSG_SPACE(fds_size);
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(fds_size);
+        memcpy(CMSG_DATA(cmsg), fds, fds_size);
+    }
+
+    return sendmsg(sock, &msg, flags);
+}
@@ -13,6 +13,13 @@
 #ifndef FD_UTILS_H_
 #define FD_UTILS_H_
 
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// Max file descriptors sent within a single message
+#define FD_UTILS_MAX_FDS    8
+
 int fd_utils_create_socket_pair(int *fd_0, int *fd_1);
 
 int fd_utils_byte_write(int fd);
@@ -21,4 +28,9 @@ int fd_utils_byte_read(int fd);
 
 int fd_utils_set_fd_nonblock(int fd);
 
+// Gather send with optional fds (passed with the first byte).
+// Returns the bytes sent or -1, as sendmsg()
+ssize_t fd_utils_sendv_fds(int sock, const struct iovec *iov, int iovcnt,
+                            const int *fds, int fds_count, int flags);
+
 #endif /* FD_UTILS_H_ */
@@ -0,0 +1,45 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#include <stdlib.h>
+
+#include "spsc_queue.h"
+
+//---------------------------------------------------------------------------------------------
+
+int spsc_queue_init(struct spsc_queue *self, uint32_t size)
+{
+    assert(self);
+
+    // Size must be a power of two
+    if (size == 0 || (size & (size - 1)))
+        return -1;
+
+    self->entries = calloc(size, sizeof(*self->entries));
+    if (!self->entries)
+        return -1;
+
+    self->mask = size - 1;
+    self->head = 0;
+    self->tail = 0;
+
+    return 0;
+}
+
+void spsc_queue_free(struct spsc_queue *self)
+{
+    if (!self)
+        return;
+
+    free(self->entries);
+    self->entries = NULL;
+}
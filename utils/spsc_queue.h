@@ -0,0 +1,104 @@
+/*
+ * Fred for Linux. Experimental support.
+ *
+ * Copyright (C) 2018-2021, Marco Pagani, ReTiS Lab.
+ * <marco.pag(at)outlook.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+*/
+
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <stdint.h>
+#include <assert.h>
+
+//---------------------------------------------------------------------------------------------
+
+// Lock-free single producer single consumer queue of (type, pointer) messages.
+// Indexes are free running, the size must be a power of two.
+
+#define SPSC_QUEUE_CACHE_LINE       64
+
+//---------------------------------------------------------------------------------------------
+
+struct spsc_entry {
+    int type;
+    void *data;
+};
+
+struct spsc_queue {
+    // Written by the producer only
+    uint32_t tail __attribute__((aligned(SPSC_QUEUE_CACHE_LINE)));
+
+    // Written by the consumer only
+    uint32_t head __attribute__((aligned(SPSC_QUEUE_CACHE_LINE)));
+
+    uint32_t mask __attribute__((aligned(SPSC_QUEUE_CACHE_LINE)));
+    struct spsc_entry *entries;
+};
+
+//---------------------------------------------------------------------------------------------
+
+// Producer side, returns -1 if the queue is full
+static inline
+int spsc_queue_push(struct spsc_queue *self, int type, void *data)
+{
+    uint32_t tail;
+    uint32_t head;
+
+    assert(self);
+
+    tail = __atomic_load_n(&self->tail, __ATOMIC_RELAXED);
+    head = __atomic_load_n(&self->head, __ATOMIC_ACQUIRE);
+
+    if (tail - head > self->mask)
+        return -1;
+
+    self->entries[tail & self->mask].type = type;
+    self->entries[tail & self->mask].data = data;
+
+    // Publish the entry
+    __atomic_store_n(&self->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+// Consumer side, returns -1 if the queue is empty
+static inline
+int spsc_queue_pop(struct spsc_queue *self, int *type, void **data)
+{
+    uint32_t head;
+    uint32_t tail;
+
+    assert(self);
+    assert(type);
+    assert(data);
+
+    head = __atomic_load_n(&self->head, __ATOMIC_RELAXED);
+    tail = __atomic_load_n(&self->tail, __ATOMIC_ACQUIRE);
+
+    if (head == tail)
+        return -1;
+
+    *type = self->entries[head & self->mask].type;
+    *data = self->entries[head & self->mask].data;
+
+    // Release the entry to the producer
+    __atomic_store_n(&self->head, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+//---------------------------------------------------------------------------------------------
+
+int spsc_queue_init(struct spsc_queue *self, uint32_t size);
+
+void spsc_queue_free(struct spsc_queue *self);
+
+//---------------------------------------------------------------------------------------------
+
+#endif /* SPSC_QUEUE_H_ */